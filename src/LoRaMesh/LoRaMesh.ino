@@ -4,7 +4,10 @@
   Punto de arranque del prototipo LoRa Mesh basado en Heltec Wireless Stick V3.
   – Inicializa Serial, radio LoRa (SX1262), OLED y subsistemas auxiliares.
   – Atiende comandos por consola para enviar DATA, HELLO o mostrar vecinos.
-  – Mantiene la recepción continua y la ejecución del planificador de mensajes.
+  – Mantiene la recepción continua (o el muestreo de bajo consumo) y la
+    ejecución del planificador de mensajes.
+  – Entre pasadas la tarea se bloquea hasta una IRQ del radio, la consola o
+    el próximo plazo (event_manager.h).
 ==============================================================================*/
 #include "config.h"
 #include "LoRaWan_APP.h"
@@ -16,6 +19,12 @@
 #include "message_scheduler.h"
 #include "message_receiver.h"
 #include "routing_manager.h"  
+#include "opportunistic_manager.h"
+#include "rate_manager.h"
+#include "channel_manager.h"
+#include "power_manager.h"
+#include "lpl_manager.h"
+#include "event_manager.h"
 
 /*----------------------------------------------------------------------------*/
 /*  Variables de estado global                                                */
@@ -32,6 +41,7 @@ uint8_t receivedBuffer[MAX_PACKET_SIZE];
 uint16_t receivedSize = 0;
 int16_t receivedRssi = 0;
 int8_t receivedSnr = 0;
+uint8_t receivedSf = LORA_SPREADING_FACTOR; // SF al que llegó la trama
 
 /*----------------------------------------------------------------------------*/
 /*  Objetos de apoyo                                                          */
@@ -40,8 +50,8 @@ OLEDManager oledDisplay; // manejo de pantalla OLED
 static RadioEvents_t RadioEvents; // callbacks SX1262
 LoraManager loraAntena; // abstracción de funciones LoRa
 
-/*  Paquete deserializado global (se usa para imprimir en varias rutinas)     */
-DataPacket receivedPacket;   
+/*  Payload del último DATA recibido (vista sobre receivedBuffer)             */
+extern ByteSpan receivedPayload;
 
 
 /*----------------------------------------------------------------------------*/
@@ -51,6 +61,17 @@ bool dataMessageSent = false;
 int payloadCounter = 1;
 unsigned long oledDisplayTime = 0;
 
+/* Encola el contador en texto como registro de ejemplo hacia destID */
+void enqueueCounterRecord(uint16_t destID) {
+  char record[12];
+  int length = snprintf(record, sizeof(record), "%d", payloadCounter);
+  if (enqueueDataMessage((const uint8_t *)record, (uint8_t)length, destID) != ENQUEUE_OK) {
+    oledDisplay.oledClear();
+    oledDisplay.oledShow(String("No encolado: ") + String(payloadCounter));
+    oledDisplayTime = millis();
+  }
+}
+
 /*============================================================================*/
 /*  setup(): configuración inicial                                            */
 /*============================================================================*/
@@ -72,10 +93,26 @@ void setup() {
   Serial.println("  'nodeID' => Enviar Data con contador");
   Serial.println("  'h' => Enviar Hello");
   Serial.println("  'v' => Mostrar tabla de vecinos");
+  Serial.println("  'a' => Mostrar tiempo en el aire");
+  Serial.println("  'q' => Mostrar estado de la cola");
+  Serial.println("  'r' => Mostrar tabla de rutas");
+  Serial.println("  'g' => Mostrar estado de recolección");
+  Serial.println("  'm' => Alternar malla / recolección");
+  Serial.println("  's' => Alternar papel de sumidero");
+  Serial.println("  'c' => Enviar Data al sumidero");
+  Serial.println("  'o' => Alternar reenvío oportunista");
+  Serial.println("  'd' => Alternar SF por enlace");
+  Serial.println("  'f' => Alternar multicanal (saltos de frecuencia)");
+  Serial.println("  'p' => Alternar control de potencia");
+  Serial.println("  'l' => Alternar escucha de bajo consumo");
+  Serial.println("  'e' => Alternar bucle por eventos");
 
   /*-- Subsistemas --------------------------------------------------------*/
+  initAirtimeManager();
   initMessageScheduler();
   initMessageReceiver();
+  initLpl();
+  initEventLoop();
 }
 
 /*============================================================================*/
@@ -91,6 +128,55 @@ void loop() {
     else if (input == 'v') { // tabla de vecinos
       printNeighborTable();
     }
+    else if (input == 'a') { // tiempo en el aire / ciclo de trabajo
+      printAirtimeStats();
+    }
+    else if (input == 'q') { // ocupación y congestión de la cola
+      printQueueStats();
+    }
+    else if (input == 'r') { // tabla de rutas (vector de distancias) y caché
+      printRouteTable();
+      printRouteCacheStats();
+    }
+    else if (input == 'g') { // estado de recolección (padre / rango)
+      printCollectState();
+    }
+    else if (input == 'm') { // alterna malla / recolección
+      setRoutingStrategy(routingStrategy == ROUTING_STRATEGY_COLLECT ? ROUTING_STRATEGY_MESH : ROUTING_STRATEGY_COLLECT);
+      printCollectState();
+    }
+    else if (input == 's') { // alterna el papel de sumidero
+      setCollectSink(!collectIsSink);
+      printCollectState();
+    }
+    else if (input == 'c' && loraIdle) { // DATA a cualquier sumidero
+      enqueueCounterRecord(COLLECT_ANY_SINK);
+    }
+    else if (input == 'o') { // reenvío oportunista (cualquiera de N)
+      oppEnabled = !oppEnabled;
+      printOppStats();
+    }
+    else if (input == 'd') { // SF por enlace (velocidad de datos adaptativa)
+      rateEnabled = !rateEnabled;
+      printRateTable();
+    }
+    else if (input == 'f') { // multicanal: DATA unicast en canales de datos
+      channelHopping = !channelHopping;
+      printChannelStats();
+    }
+    else if (input == 'p') { // control de potencia por enlace
+      tpcEnabled = !tpcEnabled;
+      printPowerStats();
+    }
+    else if (input == 'l') { // escucha de bajo consumo (nodo de batería)
+      lplEnabled = !lplEnabled;
+      trickleReset("modo de bajo consumo"); // los vecinos lo sabrán en el próximo HELLO
+      printLplStats();
+    }
+    else if (input == 'e') { // bucle por eventos / sondeo continuo
+      eventLoopEnabled = !eventLoopEnabled;
+      printEventStats();
+    }
     else if (isdigit(input)) { // destino
       String numericStr;
       numericStr += input;
@@ -103,19 +189,23 @@ void loop() {
       }
       uint16_t nodeID = numericStr.toInt();
       if (loraIdle && nodeID > 0) {
-        enqueueDataMessage(payloadCounter, nodeID);
+        enqueueCounterRecord(nodeID);
       }
     }
 
   }
   /*------------------ Recepción pasiva y procesamiento -------------------*/
-  if (loraIdle) {
-    handleReception();  // escucha continua
+  if (!lplService() && loraIdle) {
+    handleReception();  // escucha continua (salvo nodo de batería dormido)
   }
    uint8_t receivedType = processReceivedMessage(oledDisplayTime); // Procesar mensajes recibidos
   if (receivedType == MESSAGE_TYPE_DATA) {
       oledDisplay.oledClear();
-      oledDisplay.oledShow(String("Recibido: ") + String(receivedPacket.payload));
+      char text[17];
+      uint16_t length = receivedPayload.length < sizeof(text) - 1 ? receivedPayload.length : sizeof(text) - 1;
+      memcpy(text, receivedPayload.data, length);
+      text[length] = '\0';
+      oledDisplay.oledShow(String("Recibido: ") + String(text));
   }
 
   /*---------------- Planificador, HELLO auto ------------------*/
@@ -147,5 +237,8 @@ void loop() {
 
   /*---------------- Limpieza de vecinos-----------------------------------*/
   cleanupNeighbors();
+
+  /*---------------- Espera del próximo evento ----------------------------*/
+  eventWait(oledDisplayTime); // IRQ del radio, consola o próximo plazo
 }
 
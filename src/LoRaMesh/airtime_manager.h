@@ -0,0 +1,156 @@
+/*==============================================================================
+  airtime_manager.h
+  ------------------------------------------------------------------------------
+  Tiempo en el aire (ToA) y presupuesto de ciclo de trabajo.
+  – Calcula el ToA de una trama LoRa con la fórmula de Semtech (AN1200.13)
+    para los parámetros de modem de config.h.
+  – Lleva el tiempo de aire consumido en una ventana deslizante por cubetas
+    y decide si una trama cabe en el presupuesto (DUTY_CYCLE_PERCENT).
+  – Acumula contadores de tiempo de aire por tipo de mensaje.
+==============================================================================*/
+#ifndef AIRTIME_MANAGER_H
+#define AIRTIME_MANAGER_H
+
+#include "config.h"
+#include "Arduino.h"
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/*  Tiempo en el aire                                                         */
+/*----------------------------------------------------------------------------*/
+/*  Tsym = 2^SF / BW                                                          */
+/*  Tpre = (Npre + 4.25) · Tsym                                               */
+/*  Npay = 8 + max(ceil((8·PL − 4·SF + 28 + 16·CRC − 20·IH) /                 */
+/*                      (4·(SF − 2·DE))) · (CR + 4), 0)                       */
+/*  Cabecera explícita (IH = 0), CRC activo, DE = 1 si Tsym ≥ 16 ms.          */
+/*----------------------------------------------------------------------------*/
+inline uint32_t loraBandwidthHz(uint8_t bandwidth) {
+    switch (bandwidth) {
+        case 1:  return 250000;
+        case 2:  return 500000;
+        default: return 125000;
+    }
+}
+inline uint32_t computeTimeOnAirUs(uint8_t spreadingFactor, uint8_t bandwidth, uint8_t codingRate,
+                                   uint16_t preambleLength, uint16_t payloadBytes) {
+    uint32_t symbolUs = ((uint32_t)1 << spreadingFactor) * 1000000UL / loraBandwidthHz(bandwidth);
+    int lowDataRate = (symbolUs >= 16000) ? 1 : 0;
+    int numerator = 8 * (int)payloadBytes - 4 * spreadingFactor + 28 + 16;
+    int denominator = 4 * (spreadingFactor - 2 * lowDataRate);
+    int payloadSymbols = 8;
+    if (numerator > 0) {
+        payloadSymbols += ((numerator + denominator - 1) / denominator) * (codingRate + 4);
+    }
+    /* (Npre + 4.25) · Tsym = (4·Npre + 17) · Tsym / 4 */
+    uint32_t preambleUs = ((4UL * preambleLength + 17) * symbolUs) / 4;
+    return preambleUs + (uint32_t)payloadSymbols * symbolUs;
+}
+inline uint32_t getTimeOnAirUsAt(uint8_t spreadingFactor, uint16_t payloadBytes) {
+    return computeTimeOnAirUs(spreadingFactor, LORA_BANDWIDTH, LORA_CODINGRATE,
+                              LORA_PREAMBLE_LENGTH, payloadBytes);
+}
+inline uint32_t getTimeOnAirUs(uint16_t payloadBytes) {
+    return getTimeOnAirUsAt(LORA_SPREADING_FACTOR, payloadBytes);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Presupuesto en ventana deslizante (cubetas circulares)                    */
+/*----------------------------------------------------------------------------*/
+#define AIRTIME_BUCKET_MS   (DUTY_CYCLE_WINDOW_MS / DUTY_CYCLE_BUCKETS)
+#define AIRTIME_BUDGET_US   ((uint64_t)DUTY_CYCLE_WINDOW_MS * 1000ULL * DUTY_CYCLE_PERCENT / 100ULL)
+/* El tráfico normal no usa la reserva; ACK y ALT pueden agotarla */
+#define AIRTIME_NORMAL_US   (AIRTIME_BUDGET_US * (100ULL - DUTY_CYCLE_CONTROL_RESERVE) / 100ULL)
+#define AIRTIME_NUM_TYPES   8
+
+static uint32_t airtimeBuckets[DUTY_CYCLE_BUCKETS];
+static uint64_t airtimeWindowUs = 0;   // suma de las cubetas
+static int airtimeHead = 0;            // cubeta actual
+static unsigned long airtimeHeadStart = 0;
+static uint64_t airtimeByType[AIRTIME_NUM_TYPES];
+static uint32_t framesByType[AIRTIME_NUM_TYPES];
+static uint32_t airtimeDeferrals = 0;
+
+/* Avanza la ventana: vacía las cubetas que han quedado fuera */
+inline void airtimeAdvance(unsigned long now) {
+    int steps = 0;
+    while ((now - airtimeHeadStart) >= AIRTIME_BUCKET_MS && steps < DUTY_CYCLE_BUCKETS) {
+        airtimeHead = (airtimeHead + 1) % DUTY_CYCLE_BUCKETS;
+        airtimeWindowUs -= airtimeBuckets[airtimeHead];
+        airtimeBuckets[airtimeHead] = 0;
+        airtimeHeadStart += AIRTIME_BUCKET_MS;
+        steps++;
+    }
+    if ((now - airtimeHeadStart) >= AIRTIME_BUCKET_MS) {
+        airtimeHeadStart = now; // inactividad mayor que la ventana
+    }
+}
+inline void initAirtimeManager() {
+    for (int i = 0; i < DUTY_CYCLE_BUCKETS; i++) {
+        airtimeBuckets[i] = 0;
+    }
+    for (int t = 0; t < AIRTIME_NUM_TYPES; t++) {
+        airtimeByType[t] = 0;
+        framesByType[t] = 0;
+    }
+    airtimeWindowUs = 0;
+    airtimeHead = 0;
+    airtimeHeadStart = millis();
+    airtimeDeferrals = 0;
+}
+inline void airtimeConsume(uint8_t messageType, uint32_t toaUs) {
+    airtimeAdvance(millis());
+    airtimeBuckets[airtimeHead] += toaUs;
+    airtimeWindowUs += toaUs;
+    if (messageType < AIRTIME_NUM_TYPES) {
+        airtimeByType[messageType] += toaUs;
+        framesByType[messageType]++;
+    }
+}
+/* ¿Cabe una trama de toaUs en el presupuesto? (useReserve ⇒ ACK / ALT) */
+inline bool airtimeAvailable(uint32_t toaUs, bool useReserve) {
+#if DUTY_CYCLE_ENABLED
+    airtimeAdvance(millis());
+    uint64_t limit = useReserve ? AIRTIME_BUDGET_US : AIRTIME_NORMAL_US;
+    return airtimeWindowUs + toaUs <= limit;
+#else
+    (void)toaUs;
+    (void)useReserve;
+    return true;
+#endif
+}
+/* Instante en que la ventana habrá liberado lo suficiente para toaUs */
+inline unsigned long airtimeNextAvailable(uint32_t toaUs, bool useReserve) {
+    unsigned long now = millis();
+    airtimeAdvance(now);
+    uint64_t limit = useReserve ? AIRTIME_BUDGET_US : AIRTIME_NORMAL_US;
+    uint64_t used = airtimeWindowUs;
+    unsigned long at = airtimeHeadStart;
+    for (int n = 1; n <= DUTY_CYCLE_BUCKETS && used + toaUs > limit; n++) {
+        /* la cubeta más antigua sale de la ventana al cerrarse la actual */
+        used -= airtimeBuckets[(airtimeHead + n) % DUTY_CYCLE_BUCKETS];
+        at += AIRTIME_BUCKET_MS;
+    }
+    return (long)(at - now) > 0 ? at : now;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Estadísticas                                                              */
+/*----------------------------------------------------------------------------*/
+inline void printAirtimeStats() {
+    static const char *names[AIRTIME_NUM_TYPES] = { "?", "DATA", "ACK", "HELLO", "ALT", "RDV", "?", "?" };
+    airtimeAdvance(millis());
+    Serial.println("=== Tiempo en el aire ===");
+    Serial.printf("  Ventana: %lu ms / %lu ms presupuesto (%u%%)\n",
+                  (unsigned long)(airtimeWindowUs / 1000), (unsigned long)(AIRTIME_BUDGET_US / 1000),
+                  (unsigned)DUTY_CYCLE_PERCENT);
+    for (int t = 1; t < AIRTIME_NUM_TYPES; t++) {
+        if (framesByType[t] != 0) {
+            Serial.printf("  %-5s tramas=%lu aire=%lu ms\n", names[t],
+                          (unsigned long)framesByType[t], (unsigned long)(airtimeByType[t] / 1000));
+        }
+    }
+    Serial.printf("  Envíos diferidos por presupuesto: %lu\n", (unsigned long)airtimeDeferrals);
+    Serial.println("=========================");
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*==============================================================================
+  channel_manager.h
+  ------------------------------------------------------------------------------
+  Operación multicanal en la banda US915.
+  – HELLO, ACK, ALT y RDV (difusión y control) van por el canal común
+    RF_FREQUENCY; así cualquier nodo oye a sus vecinos sin coordinarse.
+  – El DATA unicast salta a uno de CHANNEL_DATA_COUNT canales de datos
+    (rejilla de subida US915 de 125 kHz a partir de CHANNEL_BASE_HZ).
+  – El canal se deriva de forma determinista del par de nodos del enlace y
+    del messageID: cada enlace salta por su propia secuencia y dos envíos
+    simultáneos en la misma vecindad raramente coinciden.
+  – El receptor no necesita calcularlo: el RDV previo lleva el índice.
+==============================================================================*/
+#ifndef CHANNEL_MANAGER_H
+#define CHANNEL_MANAGER_H
+
+#include "config.h"
+#include "packet_manager.h"
+
+static_assert(CHANNEL_DATA_COUNT >= 1 && CHANNEL_DATA_COUNT <= 64, "CHANNEL_DATA_COUNT fuera de la rejilla US915");
+
+static bool channelHopping = CHANNEL_HOPPING_ENABLED;
+static uint32_t channelDataFrames[CHANNEL_DATA_COUNT];
+
+/*----------------------------------------------------------------------------*/
+/*  Canales                                                                   */
+/*----------------------------------------------------------------------------*/
+inline uint32_t channelFrequency(uint8_t channel) {
+    if (channel == CHANNEL_CONTROL) {
+        return RF_FREQUENCY;
+    }
+    return CHANNEL_BASE_HZ + (uint32_t)channel * CHANNEL_STEP_HZ;
+}
+/* Canal del enlace {a, b} para un messageID (simétrico en a y b) */
+inline uint8_t channelForLink(uint16_t a, uint16_t b, uint32_t messageID) {
+    uint32_t link = (a < b) ? ((uint32_t)a << 16 | b) : ((uint32_t)b << 16 | a);
+    uint32_t h = (link ^ (messageID * 2246822519u)) * 2654435761u;
+    return (uint8_t)((h >> 16) % CHANNEL_DATA_COUNT);
+}
+/* Canal al que saldrá el DATA (el de control si es anycast o está apagado) */
+inline uint8_t channelFor(const DataHeader &h) {
+    if (!channelHopping || h.candidateCount > 0 || h.nextHop == INVALID_NEXT_HOP) {
+        return CHANNEL_CONTROL;
+    }
+    return channelForLink(getNodeID(), h.nextHop, h.messageID);
+}
+inline void channelNoteData(uint8_t channel) {
+    if (channel < CHANNEL_DATA_COUNT) {
+        channelDataFrames[channel]++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printChannelStats() {
+    Serial.println("=== Multicanal ===");
+    Serial.printf("  Estado: %s, control: %lu Hz, datos: %u canales desde %lu Hz\n",
+                  channelHopping ? "activo" : "inactivo", (unsigned long)RF_FREQUENCY,
+                  (unsigned)CHANNEL_DATA_COUNT, (unsigned long)CHANNEL_BASE_HZ);
+    for (int c = 0; c < CHANNEL_DATA_COUNT; c++) {
+        if (channelDataFrames[c] != 0) {
+            Serial.printf("  Canal %d (%lu Hz): %lu DATA\n", c, (unsigned long)channelFrequency(c),
+                          (unsigned long)channelDataFrames[c]);
+        }
+    }
+    Serial.println("==================");
+}
+
+#endif
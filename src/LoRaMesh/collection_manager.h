@@ -0,0 +1,193 @@
+/*==============================================================================
+  collection_manager.h
+  ------------------------------------------------------------------------------
+  Modo de recolección hacia sumidero (gradiente, estilo CTP/RPL).
+  – Los sumideros anuncian rango 0 en su HELLO; cada nodo anuncia el rango
+    de su padre más el coste de ese enlace (ETX · ROUTE_HOP_COST).
+  – Cada nodo guarda un único padre; el DATA hacia COLLECT_ANY_SINK (o al
+    sumidero actual) sale por él sin consultar tablas.
+  – Cambiar de padre exige mejorar el rango en COLLECT_PARENT_HYSTERESIS,
+    para no oscilar entre candidatos parecidos.
+  – La estrategia (malla / recolección) se elige al compilar con
+    ROUTING_STRATEGY y puede cambiarse en marcha desde la consola.
+==============================================================================*/
+#ifndef COLLECTION_MANAGER_H
+#define COLLECTION_MANAGER_H
+
+#include "config.h"
+#include "packet_manager.h"
+#include "routing_manager.h"
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+struct CollectState {
+    uint16_t parent;        // INVALID_NEXT_HOP ⇒ sin padre
+    uint16_t rank;          // rango propio (0 en el sumidero)
+    uint16_t sink;          // sumidero alcanzado por el padre
+    uint32_t parentChanges; // cambios de padre desde el arranque
+};
+static uint8_t routingStrategy = ROUTING_STRATEGY;
+static bool collectIsSink = COLLECT_IS_SINK;
+static CollectState collectState = { INVALID_NEXT_HOP, COLLECT_RANK_INFINITY, 0, 0 };
+
+/* Rango que tendríamos eligiendo al vecino idx como padre */
+inline uint16_t collectRankVia(int idx) {
+    const NeighborInfo &n = neighborTable[idx];
+    if (!n.allowed || n.gradientRank == COLLECT_RANK_INFINITY || n.gradientParent == getNodeID()) {
+        return COLLECT_RANK_INFINITY; // sin camino, o es hijo nuestro
+    }
+    uint32_t rank = (uint32_t)n.gradientRank + ((uint32_t)n.etxQ8 * ROUTE_HOP_COST + 128) / 256;
+    return rank >= COLLECT_RANK_INFINITY ? COLLECT_RANK_INFINITY - 1 : (uint16_t)rank;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Selección de padre con histéresis                                         */
+/*----------------------------------------------------------------------------*/
+inline void collectSelectParent() {
+    if (collectIsSink) {
+        collectState.parent = getNodeID();
+        collectState.rank = 0;
+        collectState.sink = getNodeID();
+        return;
+    }
+    int best = -1;
+    uint16_t bestRank = COLLECT_RANK_INFINITY;
+    for (int p = 0; p < neighborRankCount; p++) {
+        uint16_t rank = collectRankVia(neighborRank[p]);
+        if (rank < bestRank) {
+            bestRank = rank;
+            best = neighborRank[p];
+        }
+    }
+    int current = findNeighbor(collectState.parent);
+    uint16_t currentRank = (current >= 0) ? collectRankVia(current) : COLLECT_RANK_INFINITY;
+    if (best < 0) {
+        if (collectState.parent != INVALID_NEXT_HOP) {
+            Serial.printf("Recolección => sin padre (antes %u)\n", collectState.parent);
+            collectState.parent = INVALID_NEXT_HOP;
+            collectState.rank = COLLECT_RANK_INFINITY;
+            trickleReset("sin padre");
+        }
+        return;
+    }
+    if (currentRank != COLLECT_RANK_INFINITY &&
+        (best == current || (uint32_t)bestRank + COLLECT_PARENT_HYSTERESIS > currentRank)) {
+        collectState.rank = currentRank; // se mantiene el padre
+        collectState.sink = neighborTable[current].gradientSink;
+        return;
+    }
+    Serial.printf("Recolección => padre %u -> %u (rango %u)\n", collectState.parent, neighborTable[best].neighborId, bestRank);
+    collectState.parent = neighborTable[best].neighborId;
+    collectState.rank = bestRank;
+    collectState.sink = neighborTable[best].gradientSink;
+    collectState.parentChanges++;
+    trickleReset("cambio de padre");
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Beacons (HELLO)                                                           */
+/*----------------------------------------------------------------------------*/
+inline void collectProcessHello(const HelloPacket &hello) {
+    int i = findNeighbor(hello.originNode);
+    if (i < 0) {
+        return;
+    }
+    NeighborInfo &n = neighborTable[i];
+    if (hello.hasGradient) {
+        n.gradientSink = hello.gradientSink;
+        n.gradientRank = hello.gradientRank;
+        n.gradientParent = hello.gradientParent;
+    } else {
+        n.gradientRank = COLLECT_RANK_INFINITY;
+    }
+    if (routingStrategy == ROUTING_STRATEGY_COLLECT) {
+        collectSelectParent();
+    }
+}
+inline void fillHelloGradient(HelloPacket &hello) {
+    if (routingStrategy != ROUTING_STRATEGY_COLLECT) {
+        return;
+    }
+    hello.hasGradient = true;
+    hello.gradientSink = collectState.sink;
+    hello.gradientRank = collectState.rank;
+    hello.gradientParent = collectState.parent;
+}
+inline void collectNeighborLost(uint16_t neighborId) {
+    if (routingStrategy == ROUTING_STRATEGY_COLLECT && neighborId == collectState.parent) {
+        collectSelectParent();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Reenvío                                                                   */
+/*----------------------------------------------------------------------------*/
+inline bool collectHandlesDestination(uint16_t destID) {
+    if (routingStrategy != ROUTING_STRATEGY_COLLECT || collectIsSink) {
+        return false;
+    }
+    return destID == COLLECT_ANY_SINK || destID == collectState.sink;
+}
+/* Padre; si es el vecino a excluir, el mejor candidato de menor rango */
+inline uint16_t collectNextHop(uint16_t excludeID) {
+    if (collectState.parent != INVALID_NEXT_HOP && collectState.parent != excludeID) {
+        return collectState.parent;
+    }
+    int best = -1;
+    uint16_t bestRank = collectState.rank;
+    for (int p = 0; p < neighborRankCount; p++) {
+        int idx = neighborRank[p];
+        uint16_t rank = collectRankVia(idx);
+        if (neighborTable[idx].neighborId != excludeID && rank < bestRank) {
+            bestRank = rank;
+            best = idx;
+        }
+    }
+    if (best < 0) {
+        Serial.println("Recolección => sin padre ni alternativa hacia el sumidero");
+        return INVALID_NEXT_HOP;
+    }
+    return neighborTable[best].neighborId;
+}
+/* ¿Es este nodo el destino final de un DATA? */
+inline bool isLocalDestination(uint16_t destID) {
+    return destID == getNodeID() || (collectIsSink && destID == COLLECT_ANY_SINK);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void setRoutingStrategy(uint8_t strategy) {
+    routingStrategy = strategy;
+    collectState.parent = INVALID_NEXT_HOP;
+    collectState.rank = COLLECT_RANK_INFINITY;
+    if (strategy == ROUTING_STRATEGY_COLLECT) {
+        collectSelectParent();
+    }
+    routeCacheInvalidate();
+    trickleReset("cambio de estrategia");
+}
+inline void setCollectSink(bool isSink) {
+    collectIsSink = isSink;
+    setRoutingStrategy(routingStrategy);
+}
+inline void printCollectState() {
+    Serial.println("=== Recolección ===");
+    Serial.printf("  Estrategia: %s, sumidero: %s\n",
+                  routingStrategy == ROUTING_STRATEGY_COLLECT ? "recolección" : "malla",
+                  collectIsSink ? "sí" : "no");
+    Serial.printf("  Padre: %u, rango: %u, sumidero: %u, cambios de padre: %lu\n",
+                  collectState.parent, collectState.rank, collectState.sink,
+                  (unsigned long)collectState.parentChanges);
+    for (int p = 0; p < neighborRankCount; p++) {
+        const NeighborInfo &n = neighborTable[neighborRank[p]];
+        if (n.gradientRank != COLLECT_RANK_INFINITY) {
+            Serial.printf("  Vecino %u: rango anunciado %u, rango vía él %u\n",
+                          n.neighborId, n.gradientRank, collectRankVia(neighborRank[p]));
+        }
+    }
+    Serial.println("===================");
+}
+
+#endif
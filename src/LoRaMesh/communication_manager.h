@@ -4,6 +4,7 @@
   Capa de enlace entre la lógica de alto nivel y el driver LoRa.
   – Registra los eventos de TX/RX con SX1262.
   – Proporciona funciones para enviar paquetes y filtrar recepción.
+  – La recepción pasiva sólo arma el RX cuando el radio no está ya en él.
   – Contiene utilidades de depuración (impresiones Serial).
 ==============================================================================*/
 #ifndef COMMUNICATION_MANAGER_H
@@ -13,20 +14,54 @@
 #include "lora_manager.h"
 #include "packet_manager.h"
 #include "routing_manager.h"
+#include "collection_manager.h"
+#include "airtime_manager.h"
 #include "Arduino.h"
 #include <string.h>  // memcpy()
 
+/*----------------------------------------------------------------------------*/
+/*  Resultado del encolado en el planificador                                 */
+/*----------------------------------------------------------------------------*/
+enum EnqueueStatus : uint8_t {
+    ENQUEUE_OK = 0,
+    ENQUEUE_FULL,        // sin ranuras de cola o tramas DATA libres
+    ENQUEUE_CONGESTED,   // por encima de la marca alta: no se admite tráfico nuevo
+    ENQUEUE_NO_ROUTE,    // sin siguiente salto válido
+    ENQUEUE_REJECTED     // paquete inválido o suprimido por límite
+};
+
+/*----------------------------------------------------------------------------*/
+/*  Resultado de la evaluación del canal (windowCollisionPrevention)          */
+/*----------------------------------------------------------------------------*/
+#define LBT_RESULT_PENDING 0 // evaluación en curso
+#define LBT_RESULT_CLEAR   1 // canal libre
+#define LBT_RESULT_BUSY    2 // actividad detectada
+
 /*----------------------------------------------------------------------------*/
 /*  Declaraciones adelantadas (evitan dependencia circular)                   */
 /*----------------------------------------------------------------------------*/
-void scheduleAckMessage(uint32_t messageID, uint16_t destinationNode); // message_scheduler.h
-void scheduleMessage(uint32_t payload); // message_scheduler.h
-void scheduleAltMessage(uint32_t messageID, uint16_t destinationNode); // message_scheduler.h
+EnqueueStatus scheduleAckMessage(uint32_t messageID, uint16_t destinationNode); // message_scheduler.h
+EnqueueStatus scheduleMessage(const DataView &packet); // message_scheduler.h
+EnqueueStatus scheduleAltMessage(uint32_t messageID, uint16_t destinationNode); // message_scheduler.h
+bool queueCongested(); // message_scheduler.h
 bool checkDuplicates(uint32_t messageID); // message_receiver.h
 bool isPendingAck(uint32_t messageID); // message_receiver.h
 void addMessageIDAfterAck(uint32_t messageID); // message_receiver.h
-void reEnqueueAlternateRoute(const DataPacket &originalPacket, uint16_t excludeNeighbor, bool removeNeighborFlag);
+void reEnqueueAlternateRoute(int pendingSlot, uint16_t excludeNeighbor, bool removeNeighborFlag); // message_scheduler.h
 bool recentlyAcked(uint32_t messageID);   // message_scheduler.h
+int findPendingAck(uint32_t messageID);   // message_scheduler.h
+void releasePendingAck(int slot);         // message_scheduler.h
+void fillForwardCandidates(DataHeader &h, uint16_t excludeID); // opportunistic_manager.h
+bool oppIsHeld(uint32_t messageID);       // opportunistic_manager.h
+EnqueueStatus oppHoldForward(const DataView &packet, uint16_t sender, int rank); // opportunistic_manager.h
+void oppOverheard(uint8_t messageType, uint32_t messageID, uint16_t sender, uint16_t ackDestination); // opportunistic_manager.h
+void rateNoteFrameReceived();             // rate_manager.h
+void rateProcessRdv(const RdvPacket &rdv); // rate_manager.h
+void tpcNoteTx(int8_t powerDbm);          // power_manager.h
+void tpcNoteDataReceived(uint16_t sender, int16_t rssi, int8_t snr, uint8_t spreadingFactor); // power_manager.h
+void tpcProcessReport(uint16_t neighborId, int8_t marginDb); // power_manager.h
+void lplNoteFrameReceived();              // lpl_manager.h
+void lplProcessHello(const HelloPacket &hello); // lpl_manager.h
 
 
 /*----------------------------------------------------------------------------*/
@@ -36,14 +71,17 @@ extern volatile bool loraIdle;
 extern volatile bool transmissionDone;   // Bandera para saber si la transmisión se completó
 extern volatile bool receptionDone;      // Bandera para saber si la recepción se completó
 extern volatile bool transmissionError;  // Bandera para saber si hubo un error en la transmisión
+volatile bool cadDone = false;            // CAD terminado (LBT)
+volatile bool cadActivity = false;        // CAD detectó preámbulo en el canal
 
-extern DataPacket receivedPacket;
-DataPacket scheduledDataPacket;
+/* Payload del último DATA recibido; apunta dentro de receivedBuffer */
+ByteSpan receivedPayload = { nullptr, 0 };
 
 extern uint8_t receivedBuffer[MAX_PACKET_SIZE];
 extern uint16_t receivedSize;
 extern int16_t receivedRssi;
 extern int8_t receivedSnr;
+extern uint8_t receivedSf;
 
 extern LoraManager loraAntena;
 extern PendingAck pendingAcks[MAX_PENDING_ACKS];
@@ -63,6 +101,7 @@ inline void OnTxTimeout() {
 
 inline void OnRxDone(uint8_t *rxBuffer, uint16_t size, int16_t rssi, int8_t snr) {
     /* Se descarta si el buffer excede el máximo permitido */
+    loraAntena.rxEnded();
     if (size > MAX_PACKET_SIZE) {
         receptionDone = false;
         loraIdle = true;
@@ -73,48 +112,53 @@ inline void OnRxDone(uint8_t *rxBuffer, uint16_t size, int16_t rssi, int8_t snr)
     receivedSize = size;
     receivedRssi = rssi;
     receivedSnr = snr;
+    receivedSf = loraAntena.getSpreadingFactor();
 
     receptionDone = true;
     loraIdle = true; 
 }
 
+/* Trama con error de CRC / cabecera o RX vencido: hay que rearmar el RX */
+inline void OnRxError() {
+    loraAntena.rxEnded();
+    loraIdle = true;
+}
+
+inline void OnCadDone(bool channelActivityDetected) {
+    cadActivity = channelActivityDetected;
+    cadDone = true;
+    loraIdle = true;
+}
+
 /*----------------------------------------------------------------------------*/
 /*  Registro de callbacks de Radio (driver)                                      */
 /*----------------------------------------------------------------------------*/
 inline void initTxRxEvents(RadioEvents_t &events) {
     events.TxDone = OnTxDone;
     events.RxDone = OnRxDone;
+    events.RxError = OnRxError;
+    events.RxTimeout = OnRxError;
     events.TxTimeout = OnTxTimeout;
+    events.CadDone = OnCadDone;
 }
 
 /*============================================================================*/
-/*  Funciones de transmisión (sobrecarga según tipo)                           */
+/*  Funciones de transmisión                                                  */
 /*============================================================================*/
-inline void handleTransmission(const DataPacket &packet) {
-    uint8_t txBuffer[sizeof(DataPacket)];
-    serializePacket(&packet, txBuffer);  
-    loraAntena.send(txBuffer, sizeof(DataPacket));  
-    loraIdle = false;                   
-}
+/*  Todas las tramas se codifican directamente en txFrame, que se entrega    */
+/*  tal cual al driver (Radio.Send copia al FIFO del SX1262 de inmediato).   */
+/*  Cada envío descuenta su tiempo en el aire del presupuesto de ciclo.      */
+static uint8_t txFrame[MAX_PACKET_SIZE];
 
-inline void handleTransmission(const AckPacket &packet) {
-    uint8_t txBuffer[sizeof(AckPacket)];
-    serializePacket(&packet, txBuffer);  
-    loraAntena.send(txBuffer, sizeof(AckPacket));  
-    loraIdle = false;                   
-}
-
-inline void handleTransmission(const HelloPacket &packet) {
-    uint8_t txBuffer[sizeof(HelloPacket)];
-    serializePacket(&packet, txBuffer);  
-    loraAntena.send(txBuffer, sizeof(HelloPacket));
-    loraIdle = false;  
-}
-inline void handleTransmission(const AltPacket &packet) {
-    uint8_t txBuffer[sizeof(AltPacket)];
-    serializePacket(&packet, txBuffer);
-    loraAntena.send(txBuffer, sizeof(AltPacket));
+inline void sendFrame(uint16_t size) {
+    if (size == 0) {
+        return;
+    }
+    loraAntena.send(txFrame, size);
     loraIdle = false;
+    airtimeConsume(getPacketType(txFrame), computeTimeOnAirUs(loraAntena.getSpreadingFactor(), LORA_BANDWIDTH,
+                                                              LORA_CODINGRATE, loraAntena.getPreambleLength(), size));
+    tpcNoteTx(loraAntena.getTxPower());
 }
 
 /*----------------------------------------------------------------------------*/
@@ -126,24 +170,31 @@ inline void handleReception() {
 /*----------------------------------------------------------------------------*/
 /*  Utilidad de depurado (impresión detallada)                                */
 /*----------------------------------------------------------------------------*/
-inline void printReceivedPacket() {
+inline void printPayload(const ByteSpan &payload) {
+    Serial.printf("Payload (%u bytes):", payload.length);
+    for (uint16_t i = 0; i < payload.length; i++) {
+        Serial.printf(" %02X", payload.data[i]);
+    }
+    Serial.println();
+}
+inline void printReceivedPacket(const DataView &packet) {
     Serial.println("Paquete recibido:");
-    Serial.printf("Tipo de mensaje: %d\n", receivedPacket.messageType);
-    Serial.printf("ID de malla: %d\n", receivedPacket.meshID);
-    Serial.printf("ID del mensaje: %u\n", receivedPacket.messageID);
-    Serial.printf("Nodo origen: %d\n", receivedPacket.originNode);
-    Serial.printf("Nodo destino: %d\n", receivedPacket.destinationNode);
-    Serial.printf("Siguiente salto: %d\n", receivedPacket.nextHop);
-    Serial.printf("Extra: %d\n", receivedPacket.extra);
-    Serial.printf("TTL: %d\n", receivedPacket.ttl);
-    Serial.printf("Payload (contador): %u\n", receivedPacket.payload);
+    Serial.printf("Tipo de mensaje: %d\n", packet.messageType);
+    Serial.printf("ID de malla: %d\n", packet.meshID);
+    Serial.printf("ID del mensaje: %u\n", packet.messageID);
+    Serial.printf("Nodo origen: %d\n", packet.originNode);
+    Serial.printf("Nodo destino: %d\n", packet.destinationNode);
+    Serial.printf("Siguiente salto: %d\n", packet.nextHop);
+    Serial.printf("Extra: %d\n", packet.extra);
+    Serial.printf("TTL: %d\n", packet.ttl);
+    printPayload(packet.payload);
     Serial.printf("RSSI: %d\n", receivedRssi);
 }
 
 /*============================================================================*/
 /*  Filtros: decide si un paquete debe descartarse en este nodo                */
 /*============================================================================*/
-inline bool dropPacket(const DataPacket &packet, uint16_t localMeshID, uint16_t localNodeID) {
+inline bool dropPacket(const DataHeader &packet, uint16_t localMeshID, uint16_t localNodeID) {
     if (packet.ttl==0){
       return true; 
     }
@@ -153,6 +204,9 @@ inline bool dropPacket(const DataPacket &packet, uint16_t localMeshID, uint16_t
     if (packet.nextHop == localNodeID || (packet.destinationNode == localNodeID && packet.nextHop == localNodeID)) {
         return false;
     }
+    if (dataCandidateRank(packet, localNodeID) > 0) {
+        return false; // reenviador oportunista de reserva
+    }
     if (packet.destinationNode == localNodeID && packet.nextHop != localNodeID) {
         return true; 
     }
@@ -194,7 +248,16 @@ inline bool dropAltPacket(const AltPacket &packet, uint16_t localMeshID, uint16_
 /*  Procesamiento de receivedBuffer según tipo de mensaje                      */
 /*============================================================================*/
 inline void processPayload() {
-  uint8_t messageType = receivedBuffer[0];
+  uint8_t messageType = getPacketType(receivedBuffer);
+  rateNoteFrameReceived(); // fin de una ventana RDV: vuelta al SF de control
+  lplNoteFrameReceived();  // nodo de batería: sigue despierto un momento
+  /* Calidad de enlace: cualquier trama de la malla cuenta, aunque no sea   */
+  /* para nosotros (el HELLO la registra en addOrUpdateNeighbor).           */
+  uint16_t senderMesh, senderNode;
+  if (messageType != MESSAGE_TYPE_HELLO &&
+      peekPacketSender(receivedBuffer, receivedSize, senderMesh, senderNode) && senderMesh == MESH_ID) {
+    noteNeighborFrame(senderNode, receivedRssi, receivedSnr);
+  }
 
   switch (messageType) {
     /*====================================================================
@@ -202,10 +265,19 @@ inline void processPayload() {
     ====================================================================*/
     case MESSAGE_TYPE_DATA:
       {
-        deserializePacket(&receivedPacket, receivedBuffer);
+        DataView receivedPacket{};
+        if (!deserializePacket(receivedPacket, receivedBuffer, receivedSize)) {
+          return;
+        }
+        /* Escucha: supresión de copias retenidas y ACK implícito */
+        if (receivedPacket.meshID == MESH_ID) {
+          oppOverheard(MESSAGE_TYPE_DATA, receivedPacket.messageID, receivedPacket.originNode, 0);
+        }
         if (dropPacket(receivedPacket, MESH_ID, getNodeID())) {
           return;
         }
+        tpcNoteDataReceived(receivedPacket.originNode, receivedRssi, receivedSnr, receivedSf);
+        int candidateRank = dataCandidateRank(receivedPacket, getNodeID());
         /*-- Duplicados --------------------------------------------------*/
         bool isDup = checkDuplicates(receivedPacket.messageID);
         if (isDup == true) {
@@ -218,28 +290,61 @@ inline void processPayload() {
                 Serial.println("DATA duplicado propio => ignorado (ACK pendiente).");
                 return;
             }
+            if (candidateRank > 0) {
+                Serial.println("DATA duplicado como candidato de reserva => ignorado.");
+                return;
+            }
             Serial.printf("DATA duplicado ID=%u => Enviar ALT.\n", receivedPacket.messageID);
             scheduleAltMessage(receivedPacket.messageID, receivedPacket.originNode);
             return;
         }
         /*-- Procesamiento normal ---------------------------------------*/
         Serial.println("Procesando el paquete de datos recibido...");
-        printReceivedPacket();
-        /* Programar ACK hop-by-hop */
-        scheduleAckMessage(receivedPacket.messageID, receivedPacket.originNode);
-        /* Reenvío si no soy destino final */
+        printReceivedPacket(receivedPacket);
+        receivedPayload = receivedPacket.payload;
         receivedPacket.ttl--;
-        if (receivedPacket.destinationNode == getNodeID()) {
-          Serial.println("Soy el destino final. No reenvío.");
+        bool mustForward = !isLocalDestination(receivedPacket.destinationNode) && receivedPacket.ttl > 0;
+        /* Candidato de reserva: copia retenida, sin ACK ni ALT (lo hace el 0) */
+        if (candidateRank > 0 && !isLocalDestination(receivedPacket.destinationNode)) {
+          if (!mustForward || queueCongested() || oppIsHeld(receivedPacket.messageID)) {
+            return; // ya retenida (retransmisión del emisor) o no reenviable
+          }
+          uint16_t previousHop = receivedPacket.originNode;
+          receivedPacket.originNode = getNodeID();
+          receivedPacket.nextHop = getNextHop(getNodeID(),receivedPacket.destinationNode,previousHop);
+          if (receivedPacket.nextHop != INVALID_NEXT_HOP) {
+            fillForwardCandidates(receivedPacket, previousHop);
+            oppHoldForward(receivedPacket, previousHop, candidateRank);
+          }
+          return;
+        }
+        /* Contrapresión: congestionado ⇒ sin ACK y ALT para que el emisor  */
+        /* busque otra ruta, en vez de aceptar la trama y perderla después.  */
+        if (mustForward && queueCongested()) {
+          Serial.printf("Cola congestionada => no se acepta msgID=%u, enviar ALT.\n", receivedPacket.messageID);
+          scheduleAltMessage(receivedPacket.messageID, receivedPacket.originNode);
           return;
         }
-        if (receivedPacket.ttl > 0) {
+        /* Reenvío: primero siguiente salto y ranura DATA; el ACK hop-by-hop */
+        /* sólo sale si la trama quedó en cola, si no ALT al emisor.         */
+        if (mustForward) {
           uint16_t previousHop = receivedPacket.originNode;
           receivedPacket.originNode = getNodeID();
           receivedPacket.nextHop = getNextHop(getNodeID(),receivedPacket.destinationNode,previousHop);
+          fillForwardCandidates(receivedPacket, previousHop);
           Serial.printf("Reenviar => new nextHop=%u ttl=%d\n", receivedPacket.nextHop, receivedPacket.ttl);
-          scheduledDataPacket = receivedPacket;
-          scheduleMessage(receivedPacket.payload);
+          if (scheduleMessage(receivedPacket) == ENQUEUE_OK) {
+            scheduleAckMessage(receivedPacket.messageID, previousHop);
+          } else {
+            Serial.printf("Reenvío no admitido msgID=%u => enviar ALT.\n", receivedPacket.messageID);
+            scheduleAltMessage(receivedPacket.messageID, previousHop);
+          }
+          return;
+        }
+        /* Destino final o TTL agotado: se confirma sin reenviar */
+        scheduleAckMessage(receivedPacket.messageID, receivedPacket.originNode);
+        if (isLocalDestination(receivedPacket.destinationNode)) {
+          Serial.println("Soy el destino final. No reenvío.");
         } else {
           Serial.println("TTL=0. No se reenvía.");
         }
@@ -251,22 +356,33 @@ inline void processPayload() {
     case MESSAGE_TYPE_ACK:
       {
         AckPacket ackPacket;
-        deserializePacket(&ackPacket, receivedBuffer);
+        if (!deserializePacket(ackPacket, receivedBuffer, receivedSize)) {
+          return;
+        }
+        if (ackPacket.meshID == MESH_ID) {
+          oppOverheard(MESSAGE_TYPE_ACK, ackPacket.messageID, ackPacket.originNode, ackPacket.destinationNode);
+        }
         if (dropAckPacket(ackPacket, MESH_ID, getNodeID())) {
           return;
         }
+        if (ackPacket.hasReport) {
+          tpcProcessReport(ackPacket.originNode, ackPacket.reportMarginDb);
+        }
         Serial.printf("ACK recibido para messageID: %u\n", ackPacket.messageID);
         Serial.printf("  → Origen del ACK: %u\n", ackPacket.originNode);
         Serial.printf("  → Destino del ACK: %u\n", ackPacket.destinationNode);
         Serial.printf("  → Nodo actual: %u\n", getNodeID());
 
         /* Marca como atendido en pendingAcks */
-        for (int i = 0; i < MAX_PENDING_ACKS; i++) {
-          if (pendingAcks[i].packet.messageID == ackPacket.messageID) {
-            pendingAcks[i].timestamp = 0;
-            Serial.printf("ACK procesado y eliminado de la lista de pendientes: %u\n",ackPacket.messageID);
-            break;
+        int slot = findPendingAck(ackPacket.messageID);
+        if (slot >= 0) {
+          linkNoteAck(ackPacket.originNode, true);
+          /* Muestra de RTT sólo si no hubo retransmisión (regla de Karn) */
+          if (pendingAcks[slot].retryCount == 0) {
+            updateNeighborRtt(ackPacket.originNode, millis() - pendingAcks[slot].timestamp);
           }
+          releasePendingAck(slot);
+          Serial.printf("ACK procesado y eliminado de la lista de pendientes: %u\n",ackPacket.messageID);
         }
         addMessageIDAfterAck(ackPacket.messageID);
         break;
@@ -277,13 +393,20 @@ inline void processPayload() {
     case MESSAGE_TYPE_HELLO:
       {
         HelloPacket helloPacket;
-        deserializePacket(&helloPacket, receivedBuffer);
+        if (!deserializePacket(helloPacket, receivedBuffer, receivedSize)) {
+          return;
+        }
         if (dropHelloPacket(helloPacket, MESH_ID)) {
           return;
         }
         Serial.println("HELLO recibido!");
         Serial.printf("  originNode: %u  RSSI: %d\n", helloPacket.originNode, receivedRssi);
-        addOrUpdateNeighbor(helloPacket.originNode, receivedRssi);
+        addOrUpdateNeighbor(helloPacket.originNode, receivedRssi, receivedSnr);
+        if (findNeighbor(helloPacket.originNode) >= 0) { // sólo por enlaces aceptados
+          routeProcessHello(helloPacket, getLinkCost(helloPacket.originNode));
+          collectProcessHello(helloPacket);
+          lplProcessHello(helloPacket);
+        }
         break;
       }
     /*====================================================================
@@ -292,21 +415,34 @@ inline void processPayload() {
     case MESSAGE_TYPE_ALT:
       {
         AltPacket altPacket;
-        deserializePacket(&altPacket, receivedBuffer);
+        if (!deserializePacket(altPacket, receivedBuffer, receivedSize)) {
+          return;
+        }
         if (dropAltPacket(altPacket, MESH_ID, getNodeID())) {
             return;
         }
         Serial.printf("ALT recibido => msgID=%u, originALT=%u, meEnvio=%u\n",altPacket.messageID,altPacket.originNode,altPacket.destinationNode);
+        routeCacheInvalidate(); // el vecino rechaza: se vuelve a elegir
         /* Se reubica el DATA original para nuevo intento */
-        for (int i = 0; i < MAX_PENDING_ACKS; i++) {
-            if (pendingAcks[i].timestamp != 0 && pendingAcks[i].packet.messageID == altPacket.messageID) {
-                DataPacket original = pendingAcks[i].packet;
-                pendingAcks[i].timestamp = 0;
-                pendingAcks[i].retryCount = 0;
-                reEnqueueAlternateRoute(original, altPacket.originNode, false);
-                break;
-            }
+        int slot = findPendingAck(altPacket.messageID);
+        if (slot >= 0) {
+            reEnqueueAlternateRoute(slot, altPacket.originNode, false);
+        }
+        break;
+      }
+    /*====================================================================
+          RDV (5) – el DATA siguiente llega a otro SF
+    ====================================================================*/
+    case MESSAGE_TYPE_RDV:
+      {
+        RdvPacket rdvPacket;
+        if (!deserializePacket(rdvPacket, receivedBuffer, receivedSize)) {
+          return;
+        }
+        if (rdvPacket.meshID != MESH_ID || rdvPacket.destinationNode != getNodeID()) {
+          return;
         }
+        rateProcessRdv(rdvPacket);
         break;
       }
     /* tipo desconocido */
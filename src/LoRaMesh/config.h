@@ -12,10 +12,10 @@
 /*----------------------------------------------------------------------------*/
 /*  Radio SX1262 – parámetros básicos                                         */
 /*----------------------------------------------------------------------------*/
-#define RF_FREQUENCY 915000000 // Hz
-#define TX_OUTPUT_POWER 22      // dBm
+#define RF_FREQUENCY 915000000 // Hz (canal de control)
+#define TX_OUTPUT_POWER 22      // dBm (máxima; HELLO y difusión siempre a esta potencia)
 #define LORA_BANDWIDTH 0       // 125 kHz
-#define LORA_SPREADING_FACTOR 7
+#define LORA_SPREADING_FACTOR 7 // SF de control (HELLO, ACK, ALT, RDV y DATA por defecto)
 #define LORA_CODINGRATE 1      // 4/5
 #define LORA_PREAMBLE_LENGTH 8
 #define LORA_SYMBOL_TIMEOUT 0
@@ -27,11 +27,15 @@
 /*----------------------------------------------------------------------------*/
 #define BUFFER_SIZE 30
 #define MAX_PACKET_SIZE 256 
+#define MAX_PAYLOAD_SIZE 200 // bytes de aplicación por trama DATA
 
 /*----------------------------------------------------------------------------*/
 /*  Identificación de malla                                                   */
 /*----------------------------------------------------------------------------*/
 #define MESH_ID 0x1234
+/* 1 ⇒ se omite meshID en el aire cuando coincide con MESH_ID (ahorra 2 B);  */
+/* usar sólo si no conviven varias mallas en el mismo canal.                 */
+#define WIRE_OMIT_MESH_ID 0
 
 /*----------------------------------------------------------------------------*/
 /*  OLED                                                                      */
@@ -43,8 +47,8 @@
 /*----------------------------------------------------------------------------*/
 #define INITIAL_WAIT_LOWER 3000  // 3 segundos
 #define INITIAL_WAIT_UPPER 7000  // 7 segundos
-#define BACKOFF_LOWER 500   // 500 milisegundos
-#define BACKOFF_UPPER 1000  // 1 segundo
+#define BACKOFF_CW_MIN 500    // ventana de contienda inicial (ms)
+#define BACKOFF_CW_MAX 8000   // tope de la ventana tras duplicaciones (ms)
 
 /*----------------------------------------------------------------------------*/
 /*  Tipos de paquete                                                          */
@@ -53,32 +57,166 @@
 #define MESSAGE_TYPE_ACK 2
 #define MESSAGE_TYPE_HELLO  3
 #define MESSAGE_TYPE_ALT 4 
+#define MESSAGE_TYPE_RDV 5 // cita: el DATA siguiente va a otro SF / canal
 
 /*----------------------------------------------------------------------------*/
 /*  ACK y reintentos                                                          */
 /*----------------------------------------------------------------------------*/
-#define MAX_PENDING_ACKS 10
-#define ACK_TIMEOUT 15000  // 15 segundos
-#define ACK_REPLAY_WINDOW   10       
+#define MAX_PENDING_ACKS 16 // ≥ MAX_DATA_FRAMES: toda trama DATA enviada tiene hueco
+#define ACK_TIMEOUT 15000  // 15 segundos (RTO inicial sin muestras de RTT)
+#define ACK_TIMEOUT_MIN 2000   // límites del RTO adaptativo
+#define ACK_TIMEOUT_MAX 60000
+#define RTT_GRANULARITY_MS 100 // margen mínimo sobre SRTT
+#define RTO_MAX_BACKOFF 4      // duplicaciones máximas por pérdidas seguidas
 #define ACK_REPLAY_TTL_MS   15000   
 #define MAX_RETRIES 3
+#define RETX_JITTER_MIN_MS 200   // espera corta de una retransmisión en cola
+#define RETX_JITTER_MAX_MS 1000
+#define ACK_JITTER_MIN_MS 50     // espera del ACK en el receptor: corta para que
+#define ACK_JITTER_MAX_MS 300    // no infle la muestra de RTT del emisor
 
 /*----------------------------------------------------------------------------*/
 /*  Cola y LBT                                                                */
 /*----------------------------------------------------------------------------*/
-#define MAX_QUEUE_SIZE 10
+#ifndef MAX_QUEUE_SIZE     // se puede fijar al compilar (p.ej. pruebas de host)
+#define MAX_QUEUE_SIZE 64  // entradas compactas (20 B c/u en ESP32)
+#endif
+#define MAX_DATA_FRAMES 16 // tramas DATA en cola o esperando ACK a la vez
+#define QUEUE_HIGH_WATERMARK 12   // tramas DATA ⇒ congestión (no se admite DATA nuevo)
+#define QUEUE_LOW_WATERMARK 8     // tramas DATA ⇒ fin de la congestión
+#define QUEUE_RESERVED_CONTROL 8  // ranuras de cola sólo para ACK / HELLO / ALT
 #define LISTEN_WINDOW_MS 500 //ms
-#define MAX_WINDOW_RETRIES 5
+#define MAX_WINDOW_RETRIES 5  // etapas de back-off antes de enviar de todas formas
+#define LBT_USE_CAD 1              // 1 ⇒ CAD del SX1262, 0 ⇒ ventana de escucha en RX
+#define LBT_CAD_TIMEOUT_MS 50      // sin CadDone en este tiempo ⇒ canal libre
+
+/*----------------------------------------------------------------------------*/
+/*  Clases de tráfico (QoS) – deficit round robin                             */
+/*----------------------------------------------------------------------------*/
+#define QOS_QUANTUM_BYTES 256     // bytes por turno y unidad de peso (≥ MAX_PACKET_SIZE)
+#define QOS_WEIGHT_CONTROL 2      // HELLO / ALT
+#define QOS_WEIGHT_ACK 4
+#define QOS_WEIGHT_RETX 4         // retransmisiones y rutas alternas
+#define QOS_WEIGHT_FORWARD 3      // DATA reenviado (equitativo por origen)
+#define QOS_WEIGHT_LOCAL 2        // DATA propio
+#define QOS_WEIGHT_BULK 1         // DATA propio con payload grande
+#define QOS_BULK_MIN_PAYLOAD 64   // bytes a partir de los cuales DATA propio es BULK
+#define QOS_MAX_ORIGINS 16        // orígenes con etiqueta SFQ a la vez
+
+/*----------------------------------------------------------------------------*/
+/*  Ciclo de trabajo (tiempo en el aire)                                      */
+/*----------------------------------------------------------------------------*/
+#define DUTY_CYCLE_ENABLED 1
+#define DUTY_CYCLE_PERCENT 10           // % de la ventana (1 ⇒ sub-bandas EU868 de 1 %)
+#define DUTY_CYCLE_WINDOW_MS 3600000UL  // ventana deslizante: 1 hora
+#define DUTY_CYCLE_BUCKETS 60           // cubetas de la ventana (1 min c/u)
+#define DUTY_CYCLE_CONTROL_RESERVE 10   // % del presupuesto reservado a ACK / ALT
 
 /*----------------------------------------------------------------------------*/
 /*  Vecinos y enrutamiento                                                    */
 /*----------------------------------------------------------------------------*/
-#define MAX_NEIGHBORS 10
-#define HELLO_INTERVAL_MILLIS 60000
+#define MAX_NEIGHBORS 64          // capacidad del almacén (admite cientos)
+#define NEIGHBOR_HASH_SIZE 128    // índice por ID (potencia de 2, ≥ 2 × MAX_NEIGHBORS)
+#define NEIGHBOR_SWEEP_STEP 4     // vecinos revisados por cleanupNeighbors()
+#define TRICKLE_IMIN_MS 4000     // intervalo HELLO mínimo (tras cambios)
+#define TRICKLE_IMAX_MS 60000    // intervalo HELLO máximo (malla estable)
+#define TRICKLE_K 2              // HELLO coherentes oídos que suprimen el propio
+#define HELLO_TX_JITTER_MS 1000  // espera aleatoria del HELLO en la cola
 #define NEIGHBOR_EXPIRATION_TIME 120000
 #define ROUTING_MAX_CANDIDATES 3
 #define INVALID_NEXT_HOP 0xFFFF
 
+/*----------------------------------------------------------------------------*/
+/*  Estimador de enlace (ETX)                                                 */
+/*----------------------------------------------------------------------------*/
+#define LINK_SIGNAL_EWMA_SHIFT 3      // RSSI/SNR: peso 1/8 por trama oída
+#define LINK_PRR_EWMA_SHIFT 2         // entrega: peso 1/4 por resultado de ACK
+#define LINK_PRR_PRIOR_SAMPLES 4      // resultados de ACK hasta ignorar la estimación por SNR
+#define LINK_SNR_MARGIN_FULL_DB 10    // margen sobre el límite del SF ⇒ entrega ~100%
+#define LINK_ETX_MAX 16               // tope del ETX (entrega mínima 1/16)
+#define LINK_ETX_SPREAD_PCT 150       // candidatos con ETX ≤ 1,5 × el mejor
+
+/*----------------------------------------------------------------------------*/
+/*  Tabla de rutas por vector de distancias (DSDV)                            */
+/*----------------------------------------------------------------------------*/
+#define ROUTE_TABLE_CAPACITY 64        // destinos (potencia de 2)
+#define ROUTE_ADVERT_MAX 16            // rutas por HELLO (se rotan si hay más)
+#define ROUTE_HOP_COST 10              // coste de un salto
+#define ROUTE_COST_INFINITY 255        // ruta rota / inalcanzable
+#define ROUTE_EXPIRATION_TIME 180000   // ruta sin refrescar ⇒ se borra
+#define ROUTE_SWEEP_STEP 2             // entradas revisadas por cleanupNeighbors()
+#define ROUTE_CACHE_SIZE 32            // destinos en la caché de nextHop (potencia de 2)
+#define ROUTE_CACHE_ETX_DELTA_PCT 25   // cambio de ETX que invalida la caché
+
+/*----------------------------------------------------------------------------*/
+/*  Recolección hacia sumidero (gradiente, estilo CTP/RPL)                    */
+/*----------------------------------------------------------------------------*/
+#define ROUTING_STRATEGY_MESH 0        // malla: DSDV + ETX por destino
+#define ROUTING_STRATEGY_COLLECT 1     // recolección: DATA al sumidero por el padre
+#define ROUTING_STRATEGY ROUTING_STRATEGY_MESH // estrategia al arrancar (consola 'm')
+#define COLLECT_IS_SINK 0              // 1 ⇒ sumidero al arrancar (consola 's')
+#define COLLECT_ANY_SINK 0xFFFE        // destino DATA "cualquier sumidero"
+#define COLLECT_RANK_INFINITY 0xFFFF   // sin camino al sumidero
+#define COLLECT_PARENT_HYSTERESIS 15   // mejora de rango para cambiar de padre (1,5 saltos)
+
+/*----------------------------------------------------------------------------*/
+/*  Reenvío oportunista (cualquiera de N)                                     */
+/*----------------------------------------------------------------------------*/
+#define OPP_ENABLED 0                  // 1 ⇒ activo al arrancar (consola 'o')
+#define OPP_MAX_CANDIDATES 3           // reenviadores listados en la cabecera DATA
+#define OPP_RANK_DELAY_MS 2000         // espera extra por cada puesto tras el primero
+#define OPP_MAX_HELD 8                 // copias retenidas a la espera de supresión
+
+/*----------------------------------------------------------------------------*/
+/*  Velocidad de datos por enlace (SF adaptativo)                             */
+/*----------------------------------------------------------------------------*/
+#define RATE_ADAPT_ENABLED 1           // 1 ⇒ DATA unicast al SF de cada enlace (consola 'd')
+#define RATE_SF_MIN 7                  // SF más rápido permitido para DATA
+#define RATE_SF_MAX 10                 // SF más robusto permitido para DATA
+#define RATE_SWITCH_GAIN_PCT 20        // mejora de coste esperado para cambiar de SF
+#define RATE_FAIL_STREAK 2             // ACK perdidos seguidos que suben un SF
+#define RATE_HOLD_MS 60000             // tras subir por pérdidas, no se baja en este tiempo
+#define RATE_TURNAROUND_MS 30          // pausa entre RDV y DATA (el receptor cambia de SF)
+#define RATE_RX_GUARD_MS 200           // margen de la ventana de escucha tras un RDV
+
+/*----------------------------------------------------------------------------*/
+/*  Multicanal US915 (DATA unicast en canales de datos)                       */
+/*----------------------------------------------------------------------------*/
+#define CHANNEL_HOPPING_ENABLED 0      // 1 ⇒ DATA unicast en canal de datos por enlace (consola 'f')
+#define CHANNEL_BASE_HZ 902300000      // canal 0 de subida US915 (125 kHz)
+#define CHANNEL_STEP_HZ 200000         // separación entre canales
+#define CHANNEL_DATA_COUNT 8           // canales de datos usados (≤ 64)
+#define CHANNEL_CONTROL 0xFF           // índice que designa el canal de control (RF_FREQUENCY)
+
+/*----------------------------------------------------------------------------*/
+/*  Control de potencia por enlace                                            */
+/*----------------------------------------------------------------------------*/
+#define TPC_ENABLED 1                  // 1 ⇒ potencia mínima por enlace (consola 'p')
+#define TPC_MIN_DBM -9                 // potencia mínima del SX1262
+#define TPC_TARGET_MARGIN_DB 8         // margen sobre el límite del SF que se quiere mantener
+#define TPC_HYSTERESIS_DB 4            // banda muerta sobre el objetivo (no se baja dentro)
+#define TPC_STEP_DOWN_DB 2             // bajada máxima por informe (se sube de golpe)
+#define TPC_STEP_UP_LOSS_DB 3          // subida por ACK perdido
+#define TPC_SNR_SATURATION_DB 8        // SNR a partir de la cual el margen se mide por RSSI
+
+/*----------------------------------------------------------------------------*/
+/*  Escucha de bajo consumo (nodos de batería)                                */
+/*----------------------------------------------------------------------------*/
+#define LPL_ENABLED 0                  // 1 ⇒ nodo de batería: muestreo CAD y sueño ligero (consola 'l')
+#define LPL_CHECK_INTERVAL_MS 1000     // periodo de muestreo del canal (se anuncia en el HELLO)
+#define LPL_PREAMBLE_GUARD_SYMBOLS 16  // símbolos de preámbulo largo por encima del periodo
+#define LPL_RX_GUARD_MS 100            // margen de la escucha tras detectar un preámbulo
+#define LPL_AWAKE_AFTER_RX_MS 300      // RX continuo tras recibir una trama (ráfagas)
+#define LPL_LIGHT_SLEEP 1              // 1 ⇒ el ESP32 entra en sueño ligero entre muestreos
+#define LPL_MIN_SLEEP_MS 5             // esperas más cortas no compensan dormir
+
+/*----------------------------------------------------------------------------*/
+/*  Bucle por eventos (FreeRTOS)                                              */
+/*----------------------------------------------------------------------------*/
+#define EVENT_LOOP_ENABLED 1           // 1 ⇒ loop() se bloquea hasta IRQ, consola o plazo (consola 'e')
+#define EVENT_MAX_IDLE_MS 250          // espera máxima (barridos incrementales, eventos sin IRQ)
+#define LORA_DIO1_PIN 14               // DIO1 del SX1262 en Wireless Stick V3
+
 /* Lista de vecinos permitidos (0 ⇒ sin filtro) */
 //#define ALLOWED_NEIGHBORS {10412, 0 } //Para (A-liga-extremo)
 #define ALLOWED_NEIGHBORS {33364,2289,61039, 0 } //Para (B-normal)
@@ -90,9 +228,23 @@
 /*  Control de re-enqueue y ALT                                               */
 /*----------------------------------------------------------------------------*/
 #define ROUTE_MAX_ALTERNATES   5     
-#define ROUTE_HISTORY_SIZE     10    
-#define MAX_DUPLICATE_HISTORY 30
 #define ALT_MAX_PER_MESSAGE   1      
-#define ALT_HISTORY_SIZE     30      
+
+/*----------------------------------------------------------------------------*/
+/*  Detección de duplicados (ventana deslizante por origen)                   */
+/*----------------------------------------------------------------------------*/
+#define DEDUP_MAX_ORIGINS   32    // orígenes seguidos a la vez (potencia de 2)
+#define DEDUP_WINDOW_BITS   1024  // secuencias recordadas por origen (múltiplo de 32)
+#define DEDUP_ORIGIN_STALE_MS 300000 // origen callado más tiempo: ya sin retransmisiones en vuelo
+#define MSG_SEQ_RESERVE_BLOCK 256    // secuencias propias reservadas en flash de una vez
+#define MSG_SEQ_NVS_NAMESPACE "loramesh"
+
+/*----------------------------------------------------------------------------*/
+/*  Tabla de estado por messageID (replay ACK, ALT, re-enqueue, pendientes)   */
+/*----------------------------------------------------------------------------*/
+#define MSG_STATE_CAPACITY    512    // ranuras (potencia de 2)
+#define MSG_STATE_TTL_MS      120000 // expiración de entradas sin ACK pendiente
+#define MSG_STATE_SWEEP_STEP  4      // ranuras revisadas por llamada al planificador
+#define MSG_STATE_EVICT_SCAN  8      // ranuras por ventana al expulsar con la tabla en su límite
 
 #endif
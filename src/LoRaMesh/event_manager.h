@@ -0,0 +1,139 @@
+/*==============================================================================
+  event_manager.h
+  ------------------------------------------------------------------------------
+  Bucle por eventos sobre FreeRTOS.
+  – loop() corre en la tarea loopTask de Arduino; al final de cada pasada se
+    bloquea en ulTaskNotifyTake() hasta el próximo plazo conocido (cola,
+    timeout de ACK, HELLO, LBT, cita RDV, muestreo de bajo consumo, OLED)
+    y como mucho EVENT_MAX_IDLE_MS.
+  – La despiertan antes, con una notificación de tarea:
+      · la IRQ DIO1 del SX1262 (TxDone, RxDone, CadDone…): la ISR propia
+        llama al manejador del driver y notifica;
+      · la llegada de caracteres por consola (Serial.onReceive).
+  – Las notificaciones cuentan: un evento que llega mientras se calcula el
+    plazo no se pierde, la espera siguiente vuelve de inmediato.
+==============================================================================*/
+#ifndef EVENT_MANAGER_H
+#define EVENT_MANAGER_H
+
+#include "config.h"
+#include "Arduino.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "routing_manager.h"
+#include "communication_manager.h"
+#include "message_scheduler.h"
+#include "message_receiver.h"
+#include "rate_manager.h"
+#include "lpl_manager.h"
+
+/*----------------------------------------------------------------------------*/
+/*  Manejador de DIO1 del driver Heltec (radio.c): marca la IRQ para          */
+/*  Radio.IrqProcess(). Se llama desde la ISR propia, que lo sustituye.       */
+/*----------------------------------------------------------------------------*/
+extern "C" void RadioOnDioIrq(void);
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+static bool eventLoopEnabled = EVENT_LOOP_ENABLED;
+static TaskHandle_t eventLoopTask = nullptr;
+static uint32_t eventWaits = 0;
+static uint32_t eventNotified = 0;  // esperas cortadas por IRQ o consola
+static uint32_t eventIdleMs = 0;
+
+/*----------------------------------------------------------------------------*/
+/*  Fuentes de eventos                                                        */
+/*----------------------------------------------------------------------------*/
+static void IRAM_ATTR eventOnDio1() {
+    RadioOnDioIrq();
+    BaseType_t woken = pdFALSE;
+    if (eventLoopTask != nullptr) {
+        vTaskNotifyGiveFromISR(eventLoopTask, &woken);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+/* Tarea de eventos UART (fuera de ISR) */
+static void eventOnSerial() {
+    if (eventLoopTask != nullptr) {
+        xTaskNotifyGive(eventLoopTask);
+    }
+}
+/* Tras initLoRa(): la ISR de DIO1 sustituye a la del driver y la encadena */
+inline void initEventLoop() {
+    eventLoopTask = xTaskGetCurrentTaskHandle();
+    attachInterrupt(LORA_DIO1_PIN, eventOnDio1, RISING);
+    Serial.onReceive(eventOnSerial);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Próximo plazo                                                             */
+/*----------------------------------------------------------------------------*/
+inline void eventLimit(unsigned long &waitMs, long dueMs) {
+    if (dueMs >= 0 && (unsigned long)dueMs < waitMs) {
+        waitMs = (unsigned long)dueMs;
+    }
+}
+/* ms que loop() puede bloquearse sin dejar nada sin atender */
+inline unsigned long eventNextDeadlineMs(unsigned long oledDisplayTime) {
+    unsigned long now = millis();
+    if (receptionDone || transmissionDone || transmissionError || Serial.available() > 0) {
+        return 0;
+    }
+    unsigned long waitMs = EVENT_MAX_IDLE_MS;
+    /* con el radio ocupado la cola espera a su IRQ (TxDone / CadDone) */
+    if (loraIdle) {
+        long rateDue = rateNextDueMs(now);
+        if (rateDue >= 0) {
+            eventLimit(waitMs, rateDue); // radio reservado para la cita
+        } else if (!lbtInProgress()) {
+            eventLimit(waitMs, schedulerNextDueMs(now));
+        }
+    }
+    if (lbt.phase == LBT_CAD) {
+        eventLimit(waitMs, cadDone ? 0 : (long)(lbt.phaseStart + LBT_CAD_TIMEOUT_MS - now));
+    } else if (lbt.phase == LBT_LISTENING) {
+        eventLimit(waitMs, (long)(lbt.phaseStart + LISTEN_WINDOW_MS - now));
+    }
+    eventLimit(waitMs, pendingAckNextDueMs(now));
+    eventLimit(waitMs, (long)trickleNextDueMs(now));
+    eventLimit(waitMs, lplNextDueMs(now));
+    if (oledDisplayTime != 0) {
+        long oledDue = (long)(oledDisplayTime + OLED_DISPLAY_DURATION - now);
+        eventLimit(waitMs, oledDue > 0 ? oledDue : 0);
+    }
+    return waitMs;
+}
+/* Final de loop(): bloquea la tarea hasta un evento o el próximo plazo */
+inline void eventWait(unsigned long oledDisplayTime) {
+    if (!eventLoopEnabled || eventLoopTask == nullptr) {
+        return;
+    }
+    unsigned long waitMs = eventNextDeadlineMs(oledDisplayTime);
+    if (waitMs == 0) {
+        return;
+    }
+    unsigned long start = millis();
+    eventWaits++;
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs)) > 0) {
+        eventNotified++;
+    }
+    eventIdleMs += millis() - start;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printEventStats() {
+    Serial.println("=== Bucle por eventos ===");
+    Serial.printf("  Estado: %s, espera máx.: %u ms\n", eventLoopEnabled ? "activo" : "inactivo",
+                  (unsigned)EVENT_MAX_IDLE_MS);
+    Serial.printf("  Esperas: %lu, por evento: %lu, por plazo: %lu\n", (unsigned long)eventWaits,
+                  (unsigned long)eventNotified, (unsigned long)(eventWaits - eventNotified));
+    Serial.printf("  Tiempo bloqueado: %lu ms de %lu ms\n", (unsigned long)eventIdleMs, (unsigned long)millis());
+    Serial.println("=========================");
+}
+
+#endif
@@ -5,7 +5,11 @@
   – Inicializa el módulo LoRa y asocia la tabla de callbacks RadioEvents_t.
   – Expone utilidades de configuración para recepción (RX) y transmisión (TX).
   – Proporciona accesos directos a las funciones esenciales del driver
-    (receive, send, processIrq y sleep).
+    (receive, send, processIrq, sleep y CAD).
+  – Cambia el spreading factor y el canal entre tramas (SF y canal por enlace).
+  – Cambia la potencia y el preámbulo de TX trama a trama (control de
+    potencia y preámbulo largo hacia vecinos de bajo consumo).
+  – Recuerda si el radio ya está en RX para no rearmarlo en cada pasada.
 ==============================================================================*/
 #ifndef LORA_MANAGER_H
 #define LORA_MANAGER_H
@@ -29,6 +33,7 @@ public:
         Mcu.begin(HELTEC_BOARD, SLOW_CLK_TPYE);
         Radio.Init(radioEvents);
         Radio.SetChannel(frequency);
+        currentFrequency = frequency;
     }
     /*----------------------------------------------------------------------------*/
     /*  setRxConfig()                                                             */
@@ -45,6 +50,14 @@ public:
     void setRxConfig(uint32_t bandwidth, uint32_t spreadingFactor, uint8_t codingRate,
                      uint16_t preambleLength, uint16_t symbolTimeout,
                      bool fixLengthPayload, bool iqInversion) {
+        rxBandwidth = bandwidth;
+        rxCodingRate = codingRate;
+        rxPreambleLength = preambleLength;
+        rxSymbolTimeout = symbolTimeout;
+        rxFixLength = fixLengthPayload;
+        rxIqInversion = iqInversion;
+        currentSpreadingFactor = (uint8_t)spreadingFactor;
+        rxArmed = false;
         Radio.SetRxConfig(MODEM_LORA, bandwidth, spreadingFactor, codingRate, 0, preambleLength,
                           symbolTimeout, fixLengthPayload, 0, true, 0, 0, iqInversion, true);
     }
@@ -56,10 +69,17 @@ public:
     /*  - bandwidth ........ Ancho de banda (0 = 125 kHz, 1 = 250 kHz, etc.).     */
     /*  - sf ............... Spreading Factor.                                    */
     /*  - cr ............... Coding Rate.                                         */
-    /*  Resto de argumentos permanecen con valores por defecto del driver.        */
+    /*  El preámbulo es el fijado por setPreambleLength() (8 por defecto); el    */
+    /*  resto de argumentos permanecen con valores por defecto del driver.        */
     /*----------------------------------------------------------------------------*/
     void setTxConfig(int8_t power, uint32_t bandwidth, uint8_t spreadingFactor, uint8_t codingRate) {
-        Radio.SetTxConfig(MODEM_LORA, power, 0, bandwidth, spreadingFactor, codingRate, 8, false, true, 0, 0, false, 3000);
+        txPower = power;
+        txBandwidth = bandwidth;
+        txCodingRate = codingRate;
+        currentSpreadingFactor = spreadingFactor;
+        rxArmed = false;
+        Radio.SetTxConfig(MODEM_LORA, power, 0, bandwidth, spreadingFactor, codingRate, txPreambleLength, false, true,
+                          0, 0, false, 3000);
     }
 
     /*----------------------------------------------------------------------------*/
@@ -68,18 +88,126 @@ public:
     void processIrq() {
         Radio.IrqProcess();
     }
+    /* RX continuo sin timeout (rxContinuous en setRxConfig): el radio sigue
+       escuchando tras RxDone / RxError. Aun así esos callbacks borran rxArmed
+       (rxEnded) para que la siguiente pasada repita Radio.Rx(0): es barato y
+       rearma el RX si el driver lo dejó en standby tras un error o timeout.
+       Send, CAD, sleep y los cambios de configuración también lo borran. */
     void receive() {
+        if (rxArmed) {
+            return;
+        }
         Radio.Rx(0);
+        rxArmed = true;
+    }
+    void rxEnded() {
+        rxArmed = false;
     }
     void send(uint8_t *buffer, uint16_t size) {
+        rxArmed = false;
         Radio.Send(buffer, size);
     }
     void sleep() {
+        rxArmed = false;
         Radio.Sleep();
     }
+    void standby() {
+        rxArmed = false;
+        Radio.Standby();
+    }
+    /*----------------------------------------------------------------------------*/
+    /*  startCad()                                                                */
+    /*----------------------------------------------------------------------------*/
+    /*  Lanza una detección de actividad de canal (CAD) del SX1262. Dura unos     */
+    /*  pocos símbolos y termina con el callback RadioEvents_t::CadDone(bool).    */
+    /*----------------------------------------------------------------------------*/
+    void startCad() {
+        rxArmed = false;
+        Radio.StartCad();
+    }
 
+    /*----------------------------------------------------------------------------*/
+    /*  setSpreadingFactor()                                                      */
+    /*----------------------------------------------------------------------------*/
+    /*  En el SX1262 los parámetros de modulación son comunes a TX y RX: se      */
+    /*  reprograman ambos con el nuevo SF y el resto de valores ya fijados por   */
+    /*  setTxConfig()/setRxConfig(). El radio queda en standby; la siguiente     */
+    /*  receive() o send() usa ya el SF nuevo. Los parámetros de paquete son     */
+    /*  comunes en el driver: TX se programa el último para que la siguiente     */
+    /*  send() salga con su preámbulo (el RX acepta preámbulos más largos).      */
+    /*----------------------------------------------------------------------------*/
+    void setSpreadingFactor(uint8_t spreadingFactor) {
+        if (spreadingFactor == currentSpreadingFactor) {
+            return;
+        }
+        standby();
+        setRxConfig(rxBandwidth, spreadingFactor, rxCodingRate, rxPreambleLength, rxSymbolTimeout,
+                    rxFixLength, rxIqInversion);
+        setTxConfig(txPower, txBandwidth, spreadingFactor, txCodingRate);
+    }
+    uint8_t getSpreadingFactor() const {
+        return currentSpreadingFactor;
+    }
+    /*----------------------------------------------------------------------------*/
+    /*  setChannel()                                                              */
+    /*----------------------------------------------------------------------------*/
+    /*  Cambia la frecuencia de TX/RX (Radio.SetChannel) desde standby.          */
+    /*----------------------------------------------------------------------------*/
+    void setChannel(uint32_t frequency) {
+        if (frequency == currentFrequency) {
+            return;
+        }
+        standby();
+        Radio.SetChannel(frequency);
+        currentFrequency = frequency;
+    }
+    uint32_t getChannel() const {
+        return currentFrequency;
+    }
+    /*----------------------------------------------------------------------------*/
+    /*  setTxPower()                                                              */
+    /*----------------------------------------------------------------------------*/
+    /*  Potencia de la siguiente trama (dBm); conserva el SF actual.              */
+    /*----------------------------------------------------------------------------*/
+    void setTxPower(int8_t power) {
+        if (power == txPower) {
+            return;
+        }
+        setTxConfig(power, txBandwidth, currentSpreadingFactor, txCodingRate);
+    }
+    int8_t getTxPower() const {
+        return txPower;
+    }
+    /*----------------------------------------------------------------------------*/
+    /*  setPreambleLength()                                                       */
+    /*----------------------------------------------------------------------------*/
+    /*  Preámbulo de la siguiente trama (símbolos); conserva potencia y SF.       */
+    /*----------------------------------------------------------------------------*/
+    void setPreambleLength(uint16_t preambleLength) {
+        if (preambleLength == txPreambleLength) {
+            return;
+        }
+        txPreambleLength = preambleLength;
+        setTxConfig(txPower, txBandwidth, currentSpreadingFactor, txCodingRate);
+    }
+    uint16_t getPreambleLength() const {
+        return txPreambleLength;
+    }
 
-    
+private:
+    int8_t   txPower = 0;
+    uint32_t txBandwidth = 0;
+    uint8_t  txCodingRate = 1;
+    uint16_t txPreambleLength = 8;
+    uint32_t rxBandwidth = 0;
+    uint8_t  rxCodingRate = 1;
+    uint16_t rxPreambleLength = 8;
+    uint16_t rxSymbolTimeout = 0;
+    bool     rxFixLength = false;
+    bool     rxIqInversion = false;
+    uint8_t  currentSpreadingFactor = 7;
+    uint32_t currentFrequency = 0;
+    bool     rxArmed = false;  // Radio.Rx() en curso
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,316 @@
+/*==============================================================================
+  lpl_manager.h
+  ------------------------------------------------------------------------------
+  Escucha de bajo consumo para nodos de batería (muestreo de preámbulo, estilo
+  B-MAC).
+  – Sin trabajo pendiente, el nodo duerme el radio y el ESP32 (sueño ligero)
+    y cada LPL_CHECK_INTERVAL_MS lanza un CAD; si detecta preámbulo pasa a RX
+    continuo hasta recibir la trama (o vencer la ventana).
+  – Se mantiene despierto mientras tenga algo en cola, espere un ACK, haya
+    una cita RDV en curso o acabe de recibir una trama.
+  – El periodo de muestreo se anuncia en el HELLO (WIRE_FLAG_LPL). Los
+    vecinos envían el DATA hacia él, y sus HELLO, con un preámbulo que cubre
+    todo el periodo; ACK y ALT van con preámbulo normal porque su destino
+    está despierto esperando el ACK.
+  – Un nodo de batería no se ofrece como tránsito: su HELLO no lleva vector
+    de distancias y anuncia rango infinito hacia el sumidero. Los sumideros
+    y los nodos con hijos siguen siempre a la escucha.
+==============================================================================*/
+#ifndef LPL_MANAGER_H
+#define LPL_MANAGER_H
+
+#include "config.h"
+#include "lora_manager.h"
+#include "packet_manager.h"
+#include "routing_manager.h"
+#include "collection_manager.h"
+#include "airtime_manager.h"
+#include "communication_manager.h"
+#include "message_scheduler.h"
+#include "message_receiver.h"
+#include "rate_manager.h"
+#include "esp_sleep.h"
+#include "driver/uart.h"
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+#define LPL_AWAKE 0 // RX continuo
+#define LPL_SLEEP 1 // radio dormido hasta el próximo muestreo
+#define LPL_CAD   2 // CAD de muestreo en curso
+
+struct LplState {
+    uint8_t phase;
+    unsigned long phaseStart;
+    unsigned long nextCheck;   // próximo muestreo del canal
+    unsigned long awakeUntil;  // RX continuo hasta entonces
+    bool woken;                // despertado por CAD y aún sin trama
+};
+static bool lplEnabled = LPL_ENABLED;
+static LplState lplState = { LPL_AWAKE, 0, 0, 0, false };
+static uint32_t lplChecks = 0;
+static uint32_t lplWakeups = 0;
+static uint32_t lplFalseWakeups = 0;
+static uint32_t lplLongPreambles = 0;
+static uint32_t lplRadioSleepMs = 0;
+static uint32_t lplMcuSleepMs = 0;
+
+/* Sumidero o padre de algún vecino: siempre a la escucha */
+inline bool lplIsRouter() {
+    if (collectIsSink) {
+        return true;
+    }
+    if (routingStrategy != ROUTING_STRATEGY_COLLECT) {
+        return false;
+    }
+    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+        const NeighborInfo &n = neighborTable[i];
+        if (n.neighborId != 0 && n.gradientParent == getNodeID() && n.gradientRank != COLLECT_RANK_INFINITY) {
+            return true;
+        }
+    }
+    return false;
+}
+inline bool lplActive() {
+    return lplEnabled && !lplIsRouter();
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Emisor: preámbulo largo hacia vecinos que muestrean                       */
+/*----------------------------------------------------------------------------*/
+inline uint32_t lplSymbolUs() {
+    return ((uint32_t)1 << loraAntena.getSpreadingFactor()) * 1000000UL / loraBandwidthHz(LORA_BANDWIDTH);
+}
+/* Periodo a cubrir (0 ⇒ preámbulo normal); destination 0 ⇒ difusión */
+inline uint16_t lplWakeIntervalMs(bool wakeNeeded, uint16_t destination) {
+    if (!wakeNeeded) {
+        return 0;
+    }
+    if (destination != 0) {
+        int i = findNeighbor(destination);
+        return i < 0 ? 0 : neighborTable[i].lplIntervalMs;
+    }
+    uint16_t longest = 0;
+    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+        if (neighborTable[i].neighborId != 0 && neighborTable[i].lplIntervalMs > longest) {
+            longest = neighborTable[i].lplIntervalMs;
+        }
+    }
+    return longest;
+}
+inline uint16_t lplPreambleFor(uint16_t intervalMs) {
+    if (intervalMs == 0) {
+        return LORA_PREAMBLE_LENGTH;
+    }
+    uint32_t symbolUs = lplSymbolUs();
+    uint32_t symbols = ((uint32_t)intervalMs * 1000 + symbolUs - 1) / symbolUs + LPL_PREAMBLE_GUARD_SYMBOLS;
+    return symbols > 0xFFFF ? 0xFFFF : (uint16_t)symbols;
+}
+/* Tiempo en el aire extra del preámbulo largo (presupuesto de ciclo) */
+inline uint32_t lplExtraToaUs(bool wakeNeeded, uint16_t destination) {
+    uint16_t preamble = lplPreambleFor(lplWakeIntervalMs(wakeNeeded, destination));
+    return (uint32_t)(preamble - LORA_PREAMBLE_LENGTH) * lplSymbolUs();
+}
+inline void lplApply(bool wakeNeeded, uint16_t destination) {
+    uint16_t preamble = lplPreambleFor(lplWakeIntervalMs(wakeNeeded, destination));
+    if (preamble != LORA_PREAMBLE_LENGTH) {
+        lplLongPreambles++;
+    }
+    loraAntena.setPreambleLength(preamble);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  HELLO                                                                     */
+/*----------------------------------------------------------------------------*/
+inline void fillHelloLpl(HelloPacket &hello) {
+    if (!lplActive()) {
+        return;
+    }
+    hello.lplIntervalMs = LPL_CHECK_INTERVAL_MS;
+    hello.routeCount = 0; // sólo su propia ruta (seq): no es tránsito
+    if (hello.hasGradient) {
+        hello.gradientRank = COLLECT_RANK_INFINITY;
+    }
+}
+inline void lplProcessHello(const HelloPacket &hello) {
+    int i = findNeighbor(hello.originNode);
+    if (i < 0 || neighborTable[i].lplIntervalMs == hello.lplIntervalMs) {
+        return;
+    }
+    neighborTable[i].lplIntervalMs = hello.lplIntervalMs;
+    if (hello.lplIntervalMs != 0) {
+        Serial.printf("Bajo consumo => vecino %u muestrea cada %u ms\n", hello.originNode, hello.lplIntervalMs);
+    } else {
+        Serial.printf("Bajo consumo => vecino %u siempre a la escucha\n", hello.originNode);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Receptor: muestreo del canal                                              */
+/*----------------------------------------------------------------------------*/
+/* Trama recibida: se sigue en RX por si llega una ráfaga */
+inline void lplNoteFrameReceived() {
+    lplState.awakeUntil = millis() + LPL_AWAKE_AFTER_RX_MS;
+    lplState.woken = false;
+}
+/* Algo en curso o a punto de salir: no se puede dormir */
+inline bool lplBusy(unsigned long now) {
+    if (!loraIdle || receptionDone || lbtInProgress()) {
+        return true;
+    }
+    if (rateRxActive || rateDeferred.size > 0 || rateRestorePending) {
+        return true;
+    }
+    for (int i = 0; i < MAX_PENDING_ACKS; i++) {
+        if (pendingAcks[i].timestamp != 0 || pendingAcks[i].inQueue) {
+            return true; // se espera un ACK con preámbulo normal
+        }
+    }
+    if ((long)(now - lplState.awakeUntil) < 0) {
+        return true;
+    }
+    return schedulerNextDueMs(now) == 0;
+}
+inline void lplEnterSleep(unsigned long now) {
+    loraAntena.sleep();
+    lplState.phase = LPL_SLEEP;
+    lplState.phaseStart = now;
+}
+/* Espera hasta el próximo evento; el ESP32 duerme si compensa */
+inline void lplIdle(unsigned long waitMs) {
+#if LPL_LIGHT_SLEEP
+    if (waitMs < LPL_MIN_SLEEP_MS) {
+        return;
+    }
+    unsigned long start = millis();
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup((uint64_t)waitMs * 1000ULL);
+    esp_light_sleep_start();
+    lplMcuSleepMs += millis() - start;
+#else
+    (void)waitMs;
+#endif
+}
+/* Radio dormido: espera (en sueño ligero) al muestreo o a la cola */
+inline bool lplSleepUntilCheck(unsigned long now) {
+    long waitMs = (long)(lplState.nextCheck - now);
+    long dueMs = schedulerNextDueMs(now);
+    if (dueMs >= 0 && dueMs < waitMs) {
+        waitMs = dueMs;
+    }
+    if (waitMs > 0) {
+        lplIdle((unsigned long)waitMs);
+    }
+    return true;
+}
+/* Se llama en cada pasada de loop(). Devuelve true mientras el radio esté  */
+/* dormido o muestreando; false ⇒ loop() mantiene la recepción continua.    */
+inline bool lplService() {
+    unsigned long now = millis();
+    if (lplState.phase == LPL_CAD) {
+        if (!cadDone) {
+            if ((now - lplState.phaseStart) < LBT_CAD_TIMEOUT_MS) {
+                return true;
+            }
+            loraAntena.standby(); // sin CadDone ⇒ canal libre
+            loraIdle = true;
+            cadActivity = false;
+        }
+        lplState.nextCheck = now + LPL_CHECK_INTERVAL_MS;
+        if (cadActivity) {
+            /* resto del preámbulo más la trama más larga */
+            lplState.awakeUntil = now + LPL_CHECK_INTERVAL_MS + getTimeOnAirUs(WIRE_DATA_MAX_SIZE) / 1000 + LPL_RX_GUARD_MS;
+            lplState.woken = true;
+            lplState.phase = LPL_AWAKE;
+            lplWakeups++;
+            return false;
+        }
+        lplEnterSleep(now);
+        return lplSleepUntilCheck(now);
+    }
+    if (!lplActive() || lplBusy(now)) {
+        if (lplState.phase == LPL_SLEEP) {
+            lplRadioSleepMs += now - lplState.phaseStart;
+        }
+        lplState.phase = LPL_AWAKE;
+        return false;
+    }
+    if (lplState.woken) {
+        lplFalseWakeups++; // preámbulo ajeno o trama perdida
+        lplState.woken = false;
+    }
+    if (lplState.phase == LPL_AWAKE) {
+        lplState.nextCheck = now + LPL_CHECK_INTERVAL_MS;
+        lplEnterSleep(now);
+        return lplSleepUntilCheck(now);
+    }
+    if ((long)(lplState.nextCheck - now) > 0) {
+        return lplSleepUntilCheck(now);
+    }
+    lplRadioSleepMs += now - lplState.phaseStart;
+    cadDone = false;
+    cadActivity = false;
+    loraIdle = false; // evita que loop() reactive RX durante el CAD
+    loraAntena.startCad();
+    lplState.phase = LPL_CAD;
+    lplState.phaseStart = now;
+    lplChecks++;
+    return true;
+}
+/* ms hasta que lplService() tenga algo que hacer (-1 ⇒ nada) */
+inline long lplNextDueMs(unsigned long now) {
+    unsigned long due;
+    switch (lplState.phase) {
+        case LPL_CAD:
+            if (cadDone) {
+                return 0;
+            }
+            due = lplState.phaseStart + LBT_CAD_TIMEOUT_MS;
+            break;
+        case LPL_SLEEP:
+            due = lplState.nextCheck;
+            break;
+        default:
+            if ((long)(now - lplState.awakeUntil) < 0) {
+                due = lplState.awakeUntil;
+            } else if (lplActive() && !lplBusy(now)) {
+                return 0; // puede dormir ya
+            } else {
+                return -1;
+            }
+            break;
+    }
+    return (long)(due - now) > 0 ? (long)(due - now) : 0;
+}
+/* La consola despierta al ESP32 (se pierden los primeros caracteres) */
+inline void initLpl() {
+#if LPL_LIGHT_SLEEP
+    uart_set_wakeup_threshold(UART_NUM_0, 3);
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printLplStats() {
+    Serial.println("=== Bajo consumo ===");
+    Serial.printf("  Estado: %s%s, muestreo cada %u ms\n", lplEnabled ? "activo" : "inactivo",
+                  lplEnabled && lplIsRouter() ? " (encaminador: siempre a la escucha)" : "",
+                  (unsigned)LPL_CHECK_INTERVAL_MS);
+    Serial.printf("  Muestreos: %lu, despertares: %lu, falsos: %lu\n", (unsigned long)lplChecks,
+                  (unsigned long)lplWakeups, (unsigned long)lplFalseWakeups);
+    Serial.printf("  Radio dormido: %lu ms, ESP32 en sueño ligero: %lu ms\n", (unsigned long)lplRadioSleepMs,
+                  (unsigned long)lplMcuSleepMs);
+    Serial.printf("  Tramas con preámbulo largo: %lu\n", (unsigned long)lplLongPreambles);
+    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+        const NeighborInfo &n = neighborTable[i];
+        if (n.neighborId != 0 && n.lplIntervalMs != 0) {
+            Serial.printf("  Vecino %u: muestrea cada %u ms (preámbulo %u símbolos)\n", n.neighborId,
+                          n.lplIntervalMs, lplPreambleFor(n.lplIntervalMs));
+        }
+    }
+    Serial.println("====================");
+}
+
+#endif
@@ -13,41 +13,186 @@
 #include "communication_manager.h"
 
 /*----------------------------------------------------------------------------*/
-/*  Declaración adelantada (planificador)                                     */
+/*  Estado del listen-before-talk (no bloqueante)                             */
 /*----------------------------------------------------------------------------*/
-void increaseWaitTime(); //message_schedualer.h
+#define LBT_IDLE       0 // sin evaluación en curso
+#define LBT_LISTENING  1 // ventana de escucha en RX
+#define LBT_CAD        2 // CAD lanzado, esperando CadDone
 
+struct LbtState {
+    uint8_t phase;
+    unsigned long phaseStart;
+    bool rxInWindow; // se recibió una trama durante la ventana actual
+};
+static LbtState lbt = { LBT_IDLE, 0, false };
+
+/*----------------------------------------------------------------------------*/
+/*  Ventana deslizante de duplicados por origen (estilo anti-replay IPsec)    */
 /*----------------------------------------------------------------------------*/
-/*  Historial de messageID (detección de duplicados)                          */
+/*  – Cada origen (16 bits altos del messageID) tiene la secuencia más alta   */
+/*    vista y un bitmap circular de DEDUP_WINDOW_BITS bits (bit = seq % W).   */
+/*  – Los orígenes se guardan en una tabla hash con sondeo lineal; con la     */
+/*    tabla llena se expulsa el origen que lleva más tiempo sin oírse.        */
+/*  – Una secuencia más antigua que la ventana se rechaza como repetida       */
+/*    (anti-replay). Tras reiniciar, el origen sigue por delante de lo ya     */
+/*    enviado (secuencia reservada en flash, packet_manager.h): salto hacia   */
+/*    delante. Si además lleva DEDUP_ORIGIN_STALE_MS sin oírse, ya no puede   */
+/*    haber retransmisiones suyas en vuelo y su ventana se reinicia con la    */
+/*    siguiente trama (cubre la flash borrada).                               */
 /*----------------------------------------------------------------------------*/
-static uint32_t messageIDHistory[MAX_DUPLICATE_HISTORY];
-static int idHistoryIndex = 0;
+#define DEDUP_WINDOW_WORDS (DEDUP_WINDOW_BITS / 32)
+#define DEDUP_TABLE_MASK   (DEDUP_MAX_ORIGINS - 1)
+
+static_assert((DEDUP_MAX_ORIGINS & DEDUP_TABLE_MASK) == 0, "DEDUP_MAX_ORIGINS debe ser potencia de 2");
+static_assert(DEDUP_WINDOW_BITS % 32 == 0 && DEDUP_WINDOW_BITS <= 32768, "DEDUP_WINDOW_BITS inválido");
+
+struct DedupWindow {
+    bool inUse;
+    uint16_t origin;
+    uint16_t highestSeq;
+    unsigned long lastSeen;
+    uint32_t bitmap[DEDUP_WINDOW_WORDS];
+};
+static DedupWindow dedupTable[DEDUP_MAX_ORIGINS];
+static int dedupCount = 0;
+
+inline int dedupHash(uint16_t origin) {
+    return (int)(((uint32_t)origin * 2654435761u) >> 16) & DEDUP_TABLE_MASK;
+}
+inline bool dedupTestBit(const DedupWindow &w, uint16_t seq) {
+    uint16_t bit = seq % DEDUP_WINDOW_BITS;
+    return (w.bitmap[bit / 32] >> (bit % 32)) & 1u;
+}
+inline void dedupSetBit(DedupWindow &w, uint16_t seq) {
+    uint16_t bit = seq % DEDUP_WINDOW_BITS;
+    w.bitmap[bit / 32] |= (1u << (bit % 32));
+}
+inline void dedupClearBit(DedupWindow &w, uint16_t seq) {
+    uint16_t bit = seq % DEDUP_WINDOW_BITS;
+    w.bitmap[bit / 32] &= ~(1u << (bit % 32));
+}
+/* Callado más de DEDUP_ORIGIN_STALE_MS desde su última secuencia aceptada */
+inline bool dedupStale(const DedupWindow &w) {
+    return (millis() - w.lastSeen) > DEDUP_ORIGIN_STALE_MS;
+}
+inline void dedupReset(DedupWindow &w, uint16_t seq) {
+    memset(w.bitmap, 0, sizeof(w.bitmap));
+    w.highestSeq = seq;
+    dedupSetBit(w, seq);
+}
+
+inline int dedupFind(uint16_t origin) {
+    int idx = dedupHash(origin);
+    for (int n = 0; n < DEDUP_MAX_ORIGINS; n++) {
+        if (!dedupTable[idx].inUse) {
+            return -1;
+        }
+        if (dedupTable[idx].origin == origin) {
+            return idx;
+        }
+        idx = (idx + 1) & DEDUP_TABLE_MASK;
+    }
+    return -1;
+}
+/* Borrado con desplazamiento hacia atrás (mantiene las cadenas de sondeo) */
+inline void dedupRemoveAt(int idx) {
+    dedupTable[idx].inUse = false;
+    dedupCount--;
+    int next = (idx + 1) & DEDUP_TABLE_MASK;
+    while (dedupTable[next].inUse) {
+        int home = dedupHash(dedupTable[next].origin);
+        /* ¿la posición libre idx queda entre home y next (circularmente)? */
+        if (((next - home) & DEDUP_TABLE_MASK) >= ((next - idx) & DEDUP_TABLE_MASK)) {
+            dedupTable[idx] = dedupTable[next];
+            dedupTable[next].inUse = false;
+            idx = next;
+        }
+        next = (next + 1) & DEDUP_TABLE_MASK;
+    }
+}
+inline int dedupInsert(uint16_t origin, uint16_t seq) {
+    if (dedupCount >= DEDUP_MAX_ORIGINS) {
+        /* edad relativa a millis(): válida aunque el contador dé la vuelta */
+        unsigned long now = millis();
+        int oldest = -1;
+        for (int i = 0; i < DEDUP_MAX_ORIGINS; i++) {
+            if (dedupTable[i].inUse &&
+                (oldest < 0 || (now - dedupTable[i].lastSeen) > (now - dedupTable[oldest].lastSeen))) {
+                oldest = i;
+            }
+        }
+        dedupRemoveAt(oldest);
+    }
+    int idx = dedupHash(origin);
+    while (dedupTable[idx].inUse) {
+        idx = (idx + 1) & DEDUP_TABLE_MASK;
+    }
+    dedupTable[idx].inUse = true;
+    dedupTable[idx].origin = origin;
+    dedupTable[idx].lastSeen = millis();
+    dedupReset(dedupTable[idx], seq);
+    dedupCount++;
+    return idx;
+}
 
 /*----------------------------------------------------------------------------*/
 /*  Gestión del historial                                                     */
 /*----------------------------------------------------------------------------*/
 inline void addMessageID(uint32_t messageID) {
-    messageIDHistory[idHistoryIndex] = messageID;
-    idHistoryIndex++;
-    if(idHistoryIndex >= MAX_DUPLICATE_HISTORY) {
-        idHistoryIndex = 0;
+    uint16_t origin = getMessageOrigin(messageID);
+    uint16_t seq = getMessageSequence(messageID);
+    int idx = dedupFind(origin);
+    if (idx < 0) {
+        dedupInsert(origin, seq);
+        return;
+    }
+    DedupWindow &w = dedupTable[idx];
+    if (dedupStale(w)) {
+        dedupReset(w, seq);
+        w.lastSeen = millis();
+        return;
+    }
+    int16_t diff = (int16_t)(seq - w.highestSeq);
+    if (-diff >= DEDUP_WINDOW_BITS) {
+        return; // demasiado antigua: rechazada, no renueva lastSeen
     }
+    w.lastSeen = millis();
+    if (diff > 0) {
+        if (diff >= DEDUP_WINDOW_BITS) {
+            memset(w.bitmap, 0, sizeof(w.bitmap));
+        } else {
+            for (uint16_t s = w.highestSeq + 1; s != seq; s++) {
+                dedupClearBit(w, s);
+            }
+        }
+        w.highestSeq = seq;
+    }
+    dedupSetBit(w, seq);
 }
 
 inline bool checkDuplicates(uint32_t messageID) {
-    for(int i=0; i<MAX_DUPLICATE_HISTORY; i++) {
-        if(messageIDHistory[i] == messageID) {
-            return true; 
-        }
+    int idx = dedupFind(getMessageOrigin(messageID));
+    if (idx < 0) {
+        return false;
     }
-    return false;
+    const DedupWindow &w = dedupTable[idx];
+    if (dedupStale(w)) {
+        return false;
+    }
+    uint16_t seq = getMessageSequence(messageID);
+    int16_t diff = (int16_t)(seq - w.highestSeq);
+    if (diff > 0) {
+        return false;
+    }
+    if (-diff >= DEDUP_WINDOW_BITS) {
+        return true; // más antigua que la ventana: se trata como repetida
+    }
+    return dedupTestBit(w, seq);
 }
 
 inline void addMessageIDAfterAck(uint32_t messageID) {
-    for(int i = 0; i < MAX_DUPLICATE_HISTORY; i++){
-        if(messageIDHistory[i] == messageID){
-            return;
-        }
+    if (checkDuplicates(messageID)) {
+        return;
     }
     addMessageID(messageID);
     Serial.printf("[addMessageIDAfterAck] Se añade messageID=%u al historial de duplicados.\n", messageID);
@@ -57,13 +202,7 @@ inline void addMessageIDAfterAck(uint32_t messageID) {
 /*  Consulta de ACK pendientes                                                */
 /*----------------------------------------------------------------------------*/
 inline bool isPendingAck(uint32_t messageID) {
-    for (int i = 0; i < MAX_PENDING_ACKS; i++) {
-        if (pendingAcks[i].timestamp != 0 &&
-            pendingAcks[i].packet.messageID == messageID) {
-            return true;    
-        }
-    }
-    return false;
+    return findPendingAck(messageID) >= 0;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -77,10 +216,10 @@ inline void initMessageReceiver() {
 /*============================================================================*/
 inline uint8_t processReceivedMessage(unsigned long &oledDisplayTime) {
     if (receptionDone) {
-        uint8_t receivedType = receivedBuffer[0]; 
+        uint8_t receivedType = getPacketType(receivedBuffer);
         processPayload();
         receptionDone = false;
-        increaseWaitTime(); // aleatoriza back-off
+        lbt.rxInWindow = true; // canal ocupado para la ventana LBT en curso
         oledDisplayTime = millis();
         return receivedType;
     }
@@ -88,31 +227,76 @@ inline uint8_t processReceivedMessage(unsigned long &oledDisplayTime) {
 }
 
 /*============================================================================*/
-/*  Ventana de escucha (LBT)                                                  */
+/*  Ventana de escucha (LBT) – máquina de estados no bloqueante               */
 /*============================================================================*/
-inline void windowCollisionPrevention() {
-  for (int attempt = 1; attempt <= MAX_WINDOW_RETRIES; attempt++) {
-    receptionDone = false;
+/*  Se llama en cada pasada de updateMessageScheduler() mientras haya algo    */
+/*  listo para enviar. Devuelve LBT_RESULT_PENDING mientras la evaluación     */
+/*  sigue y LBT_RESULT_CLEAR / LBT_RESULT_BUSY al terminar; el back-off ante  */
+/*  canal ocupado lo aplica el planificador a cada elemento por separado.     */
+/*----------------------------------------------------------------------------*/
+inline bool lbtInProgress() {
+    return lbt.phase != LBT_IDLE;
+}
+inline void lbtReset() {
+    if (lbt.phase == LBT_CAD && !cadDone) {
+        loraAntena.standby();
+        loraIdle = true;
+    }
+    lbt.phase = LBT_IDLE;
+}
+inline void lbtStartWindow() {
+    lbt.phaseStart = millis();
+    lbt.rxInWindow = false;
+#if LBT_USE_CAD
+    cadDone = false;
+    cadActivity = false;
+    loraIdle = false; // evita que loop() reactive RX durante el CAD
+    loraAntena.startCad();
+    lbt.phase = LBT_CAD;
+#else
     Serial.printf("windowCollisionPrevention => Escuchando %u ms...\n", (unsigned)LISTEN_WINDOW_MS);
-    unsigned long startTime = millis();
-    bool gotPacketInWindow = false;
-    while ((millis() - startTime) < LISTEN_WINDOW_MS) {
-      delay(5);  
-      if (receptionDone) {
-        unsigned long packetInWindowTime = 0;
-        processReceivedMessage(packetInWindowTime);
-        gotPacketInWindow = true;
-        break;
-      }
-    }
-    if (gotPacketInWindow) {
-      Serial.printf("Canal ocupado en la ventana %d => reintento...\n", attempt);
-    } else {
-      Serial.printf("No se recibió nada en la ventana %d => canal libre!\n", attempt);
-      return;
-    }
-  }
-  Serial.printf("Se alcanzó MAX_WINDOW_RETRIES=%d => enviamos de todas formas.\n",MAX_WINDOW_RETRIES);
+    lbt.phase = LBT_LISTENING;
+#endif
+}
+inline uint8_t windowCollisionPrevention() {
+    unsigned long now = millis();
+    switch (lbt.phase) {
+        case LBT_IDLE:
+            lbtStartWindow();
+            return LBT_RESULT_PENDING;
+
+        case LBT_LISTENING:
+            if (lbt.rxInWindow) {
+                lbt.phase = LBT_IDLE;
+                return LBT_RESULT_BUSY;
+            }
+            if ((now - lbt.phaseStart) < LISTEN_WINDOW_MS) {
+                return LBT_RESULT_PENDING;
+            }
+            Serial.println("No se recibió nada en la ventana => canal libre!");
+            lbt.phase = LBT_IDLE;
+            return LBT_RESULT_CLEAR;
+
+        case LBT_CAD:
+            if (!cadDone) {
+                if ((now - lbt.phaseStart) < LBT_CAD_TIMEOUT_MS) {
+                    return LBT_RESULT_PENDING;
+                }
+                Serial.println("CAD sin respuesta => se asume canal libre.");
+                loraAntena.standby();
+                loraIdle = true;
+                lbt.phase = LBT_IDLE;
+                return LBT_RESULT_CLEAR;
+            }
+            /* tras CadDone loraIdle = true: el radio vuelve a RX y recibe */
+            /* la trama en curso si la hay                                 */
+            lbt.phase = LBT_IDLE;
+            return cadActivity ? LBT_RESULT_BUSY : LBT_RESULT_CLEAR;
+
+        default:
+            lbt.phase = LBT_IDLE;
+            return LBT_RESULT_PENDING;
+    }
 }
 
 #endif
@@ -5,6 +5,7 @@
   – Maneja DATA, ACK, HELLO y ALT con espera aleatoria.
   – Supervisa ACK pendientes y reintentos.
   – Implementa reenvío por ruta alterna y HELLO automático.
+  – Respeta el presupuesto de tiempo en el aire (airtime_manager.h).
 ==============================================================================*/
 #ifndef MESSAGE_SCHEDULER_H
 #define MESSAGE_SCHEDULER_H
@@ -13,249 +14,665 @@
 #include "packet_manager.h"
 #include "communication_manager.h"
 #include "routing_manager.h"
+#include "message_state.h"
+#include "airtime_manager.h"
 
 /*----------------------------------------------------------------------------*/
 /*  Declaración adelantada                                                    */
 /*----------------------------------------------------------------------------*/
-void windowCollisionPrevention(); //Esta en message_receiver.h
+uint8_t windowCollisionPrevention(); //Esta en message_receiver.h
+bool lbtInProgress();              //Esta en message_receiver.h
+void lbtReset();                   //Esta en message_receiver.h
+void fillForwardCandidates(DataHeader &h, uint16_t excludeID); //Esta en opportunistic_manager.h
+void oppNoteSent(uint32_t messageID); //Esta en opportunistic_manager.h
+bool rateService();                //Esta en rate_manager.h
+void rateSendData(const DataHeader &h, uint16_t frameSize); //Esta en rate_manager.h
+uint32_t rateDataToaUs(const DataHeader &h, uint16_t frameSize); //Esta en rate_manager.h
+void tpcApply(uint16_t destination); //Esta en power_manager.h
+void tpcFillAckReport(AckPacket &ack); //Esta en power_manager.h
+void fillHelloLpl(HelloPacket &hello); //Esta en lpl_manager.h
+void lplApply(bool wakeNeeded, uint16_t destination); //Esta en lpl_manager.h
+uint32_t lplExtraToaUs(bool wakeNeeded, uint16_t destination); //Esta en lpl_manager.h
 
 /*============================================================================*/
-/*  1) Historial para limitar re-enqueue por rutas alternas                    */
+/*  1) Límite de re-enqueue por rutas alternas (tabla de estado)              */
 /*============================================================================*/
-static uint32_t routeHistory[ROUTE_HISTORY_SIZE] = {0};
-static uint8_t  routeCount  [ROUTE_HISTORY_SIZE] = {0};
-static int      routeIdx = 0;
-
 inline bool canReenqueue(uint32_t messageID)
 {
-    for (int i = 0; i < ROUTE_HISTORY_SIZE; i++) {
-        if (routeHistory[i] == messageID) {               
-            if (routeCount[i] >= ROUTE_MAX_ALTERNATES)    
-                return false;
-            routeCount[i]++;                              
-            return true;
-        }
+    MessageState *state = msgStateGet(messageID);
+    if (state == nullptr || state->routeCount >= ROUTE_MAX_ALTERNATES) {
+        return false; // sin estado no hay forma de acotar los reintentos
     }
-    routeHistory[routeIdx] = messageID;
-    routeCount [routeIdx]  = 1;
-    routeIdx++;
-    if (routeIdx >= ROUTE_HISTORY_SIZE) routeIdx = 0;
+    state->routeCount++;
     return true;
 }
 /*============================================================================*/
 /*  2) Ventana para evitar reenvío múltiple de ACK (ACK replay)               */
 /*============================================================================*/
-struct AckReplayEntry {
-    uint32_t messageID;
-    unsigned long ts; // “timestamp” (marca de tiempo)
-};
-static AckReplayEntry ackReplay[ACK_REPLAY_WINDOW] = {0};
-static int ackReplayPos = 0;
-
 inline void rememberAckSent(uint32_t messageID) {
-    ackReplay[ackReplayPos].messageID = messageID;
-    ackReplay[ackReplayPos].ts    = millis();
-    ackReplayPos++;
-    if (ackReplayPos >= ACK_REPLAY_WINDOW) ackReplayPos = 0;
+    MessageState *state = msgStateGet(messageID);
+    if (state == nullptr) {
+        return;
+    }
+    state->flags |= MSG_STATE_ACK_SENT;
+    state->ackSentAt = millis();
 }
 inline bool recentlyAcked(uint32_t messageID) {
-    unsigned long now = millis();
-    for (int i = 0; i < ACK_REPLAY_WINDOW; i++) {
-        if (ackReplay[i].messageID == messageID &&
-            (now - ackReplay[i].ts) <= ACK_REPLAY_TTL_MS) {
-            return true;
-        }
-    }
-    return false;
+    const MessageState *state = msgStateFind(messageID);
+    return state != nullptr && (state->flags & MSG_STATE_ACK_SENT) &&
+           (millis() - state->ackSentAt) <= ACK_REPLAY_TTL_MS;
 }
 
 /*============================================================================*/
 /*  3) Estructura de la cola de transmisión                                   */
 /*============================================================================*/
+/*  – scheduledQueue es un pool de ranuras con pila de libres (alta O(1)).    */
+/*  – Los elementos esperan su scheduleTime en un min-heap de temporización;  */
+/*    al vencer pasan al heap "listo" de su clase de tráfico.                 */
+/*  – Entre clases se reparte el canal con deficit round robin (DRR) según    */
+/*    los pesos QOS_WEIGHT_*; dentro de FORWARD se ordena por etiqueta de     */
+/*    inicio SFQ por origen, de modo que ningún origen acapara el reenvío.    */
+/*  – heapPos permite reprogramar o retirar cualquier elemento en O(log n).   */
+/*----------------------------------------------------------------------------*/
+#define SCHED_CLASS_CONTROL 0 // HELLO / ALT
+#define SCHED_CLASS_ACK     1
+#define SCHED_CLASS_RETX    2 // retransmisiones y rutas alternas de DATA
+#define SCHED_CLASS_FORWARD 3 // DATA de otros orígenes
+#define SCHED_CLASS_LOCAL   4 // DATA propio
+#define SCHED_CLASS_BULK    5 // DATA propio de payload grande
+#define SCHED_NUM_CLASSES   6
+#define SCHED_NOT_IN_HEAP   -1
+
+static_assert(MAX_QUEUE_SIZE <= 0x7FFF, "heapPos es int16_t");
+static_assert(QOS_QUANTUM_BYTES >= MAX_PACKET_SIZE, "QOS_QUANTUM_BYTES debe cubrir una trama completa");
+static_assert(QUEUE_LOW_WATERMARK < QUEUE_HIGH_WATERMARK && QUEUE_HIGH_WATERMARK <= MAX_DATA_FRAMES,
+              "marcas de agua de la cola inválidas");
+/* cada ACK pendiente retiene una trama DATA: nunca falta hueco al enviar */
+static_assert(MAX_PENDING_ACKS >= MAX_DATA_FRAMES, "MAX_PENDING_ACKS < MAX_DATA_FRAMES");
+
+/*  Entrada compacta con etiqueta de tipo. ACK/HELLO/ALT se reconstruyen al  */
+/*  enviar a partir de messageID y nodo; DATA referencia una ranura del pool */
+/*  dataFrames, de modo que sólo las tramas DATA ocupan espacio de payload.  */
+#define ITEM_DATA   0
+#define ITEM_ACK    1
+#define ITEM_HELLO  2
+#define ITEM_ALT    3
+
 struct ScheduledItem {
-    bool isAck;               
-    bool isHello;
-    bool isAlt;              
-    DataPacket data;           
-    AckPacket ack;             
-    HelloPacket hello;
-    AltPacket alt; 
     unsigned long scheduleTime; 
+    uint32_t readyTag;       // orden dentro de su clase (llegada o SFQ)
+    uint32_t messageID;      // ACK / HELLO / ALT
+    uint16_t node;           // destino (ACK / ALT) o ranura de dataFrames (DATA)
+    int16_t heapPos;
+    uint8_t kind;            // ITEM_*
+    uint8_t priorityClass;   // SCHED_CLASS_*
+    uint8_t backoffStage;    // duplicaciones de la ventana de contienda
+    bool ready;              // en el heap de su clase (no en el temporizador)
     bool inUse;               
 };
 
+struct SchedulerHeap {
+    uint16_t slots[MAX_QUEUE_SIZE];
+    uint16_t size;
+    bool byTag;              // ordena por readyTag en vez de scheduleTime
+};
+
 static ScheduledItem scheduledQueue[MAX_QUEUE_SIZE];
-static int queueWriteIndex = 0; 
+static SchedulerHeap timerHeap;
+static SchedulerHeap schedulerHeaps[SCHED_NUM_CLASSES];
+static uint16_t freeSlots[MAX_QUEUE_SIZE];
+static uint16_t freeSlotCount = 0;
+
+static DataPacket dataFrames[MAX_DATA_FRAMES];
+static uint16_t freeDataFrames[MAX_DATA_FRAMES];
+static uint16_t freeDataFrameCount = 0;
 
 /*----------------------------------------------------------------------------*/
-/*  Variables globales de apoyo                                               */
+/*  Min-heap indexado                                                         */
 /*----------------------------------------------------------------------------*/
-extern bool dataMessageSent;
-PendingAck pendingAcks[MAX_PENDING_ACKS];
-extern DataPacket scheduledDataPacket;
+inline bool timeBefore(unsigned long a, unsigned long b) {
+    return (long)(a - b) < 0;
+}
+inline bool heapLess(const SchedulerHeap &h, uint16_t a, uint16_t b) {
+    if (h.byTag) {
+        return (int32_t)(scheduledQueue[a].readyTag - scheduledQueue[b].readyTag) < 0;
+    }
+    return timeBefore(scheduledQueue[a].scheduleTime, scheduledQueue[b].scheduleTime);
+}
+inline void heapPlace(SchedulerHeap &h, int pos, uint16_t slot) {
+    h.slots[pos] = slot;
+    scheduledQueue[slot].heapPos = pos;
+}
+inline void heapSiftUp(SchedulerHeap &h, int pos) {
+    uint16_t slot = h.slots[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!heapLess(h, slot, h.slots[parent])) {
+            break;
+        }
+        heapPlace(h, pos, h.slots[parent]);
+        pos = parent;
+    }
+    heapPlace(h, pos, slot);
+}
+inline void heapSiftDown(SchedulerHeap &h, int pos) {
+    uint16_t slot = h.slots[pos];
+    while (true) {
+        int child = 2 * pos + 1;
+        if (child >= h.size) {
+            break;
+        }
+        if (child + 1 < h.size && heapLess(h, h.slots[child + 1], h.slots[child])) {
+            child++;
+        }
+        if (!heapLess(h, h.slots[child], slot)) {
+            break;
+        }
+        heapPlace(h, pos, h.slots[child]);
+        pos = child;
+    }
+    heapPlace(h, pos, slot);
+}
+inline void heapPush(SchedulerHeap &h, uint16_t slot) {
+    h.size++;
+    heapPlace(h, h.size - 1, slot);
+    heapSiftUp(h, h.size - 1);
+}
+inline void heapRemove(SchedulerHeap &h, int pos) {
+    uint16_t removed = h.slots[pos];
+    h.size--;
+    if (pos < h.size) {
+        uint16_t moved = h.slots[h.size];
+        heapPlace(h, pos, moved);
+        heapSiftUp(h, pos);
+        heapSiftDown(h, scheduledQueue[moved].heapPos);
+    }
+    scheduledQueue[removed].heapPos = SCHED_NOT_IN_HEAP;
+}
+/* Heap en el que está el elemento (temporizador o clase) */
+inline SchedulerHeap &itemHeap(const ScheduledItem &item) {
+    return item.ready ? schedulerHeaps[item.priorityClass] : timerHeap;
+}
 
 /*----------------------------------------------------------------------------*/
-/*  HELLO periódico                                                           */
+/*  Operaciones sobre la cola                                                 */
 /*----------------------------------------------------------------------------*/
-static unsigned long nextHelloTimeAuto = 0;
-
+inline int allocQueueSlot(uint8_t kind) {
+    if (freeSlotCount == 0) {
+        return -1;
+    }
+    int slot = freeSlots[--freeSlotCount];
+    scheduledQueue[slot].inUse = true;
+    scheduledQueue[slot].kind = kind;
+    scheduledQueue[slot].ready = false;
+    scheduledQueue[slot].backoffStage = 0;
+    scheduledQueue[slot].heapPos = SCHED_NOT_IN_HEAP;
+    return slot;
+}
 /*----------------------------------------------------------------------------*/
-/*  Historial de ALT enviados (límite por messageID)                          */
+/*  Ocupación y marcas de agua (con histéresis)                               */
 /*----------------------------------------------------------------------------*/
-static uint32_t altHistory[ALT_HISTORY_SIZE]   = {0};
-static uint8_t  altCount  [ALT_HISTORY_SIZE]   = {0};
-static int      altIdx = 0; //posicion actual
-
+/*  La congestión se mide en tramas DATA del pool: se activa al alcanzar     */
+/*  QUEUE_HIGH_WATERMARK y sólo se desactiva al bajar a QUEUE_LOW_WATERMARK. */
+static bool congestionActive = false;
+static uint32_t congestionEpisodes = 0;
+static uint32_t enqueueRejects[ENQUEUE_REJECTED + 1];
+
+inline uint16_t queueOccupancy() {
+    return MAX_QUEUE_SIZE - freeSlotCount;
+}
+inline uint16_t dataFrameOccupancy() {
+    return MAX_DATA_FRAMES - freeDataFrameCount;
+}
+inline void updateCongestion() {
+    uint16_t used = dataFrameOccupancy();
+    if (!congestionActive && used >= QUEUE_HIGH_WATERMARK) {
+        congestionActive = true;
+        congestionEpisodes++;
+    } else if (congestionActive && used <= QUEUE_LOW_WATERMARK) {
+        congestionActive = false;
+    }
+}
+inline bool queueCongested() {
+    return congestionActive;
+}
 
-inline bool canSendAlt(uint32_t messageID) {
-    for (int i = 0; i < ALT_HISTORY_SIZE; i++) {
-        if (altHistory[i] == messageID) {            
-            if (altCount[i] >= ALT_MAX_PER_MESSAGE) return false;
-            altCount[i]++;                       
-            return true;
+/* Reserva ranura de cola + trama DATA del pool; devuelve la ranura o -1.   */
+/* DATA no puede ocupar las QUEUE_RESERVED_CONTROL ranuras de ACK/control. */
+inline int allocDataSlot() {
+    if (freeDataFrameCount == 0 || freeSlotCount <= QUEUE_RESERVED_CONTROL) {
+        return -1;
+    }
+    int slot = allocQueueSlot(ITEM_DATA);
+    if (slot < 0) {
+        return -1;
+    }
+    scheduledQueue[slot].node = freeDataFrames[--freeDataFrameCount];
+    updateCongestion();
+    return slot;
+}
+inline DataPacket &itemData(int slot) {
+    return dataFrames[scheduledQueue[slot].node];
+}
+/* Clase de tráfico según tipo y, para DATA, origen y tamaño */
+inline uint8_t trafficClassOf(int slot) {
+    switch (scheduledQueue[slot].kind) {
+        case ITEM_ACK:
+            return SCHED_CLASS_ACK;
+        case ITEM_DATA: {
+            /* originNode es el salto previo; el origen real va en messageID */
+            const DataPacket &data = itemData(slot);
+            if (getMessageOrigin(data.messageID) != getNodeID()) {
+                return SCHED_CLASS_FORWARD;
+            }
+            return data.payloadLength >= QOS_BULK_MIN_PAYLOAD ? SCHED_CLASS_BULK : SCHED_CLASS_LOCAL;
         }
+        default:
+            return SCHED_CLASS_CONTROL;
     }
-    altHistory[altIdx] = messageID;
-    altCount [altIdx]  = 1;
-    altIdx++; 
-    if (altIdx >= ALT_HISTORY_SIZE) {
-        altIdx = 0;
-    } 
-    return true;
 }
-
-
-/*============================================================================*/
-/*  4) Encolado de mensajes (DATA / ACK / HELLO / ALT)                        */
-/*============================================================================*/
-inline void enqueueDataMessage(uint32_t payload) {
-    if (scheduledDataPacket.destinationNode == 0) {
-        Serial.println("No se pudo encolar DATA: scheduledDataPacket.destinationNode = 0");
-        return;
+/* Bytes en el aire que DRR descuenta del déficit de la clase */
+inline uint16_t itemCost(int slot) {
+    switch (scheduledQueue[slot].kind) {
+        case ITEM_DATA:  return WIRE_DATA_HEADER_MAX + itemData(slot).payloadLength;
+        case ITEM_ACK:   return WIRE_ACK_MAX_SIZE;
+        case ITEM_ALT:   return WIRE_ALT_MAX_SIZE;
+        default:         return WIRE_HELLO_MAX_SIZE;
     }
-    unsigned long randomWait = millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER);
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (!scheduledQueue[i].inUse) {
-            scheduledQueue[i].isAck = false;
-            scheduledQueue[i].isHello= false;
-            scheduledQueue[i].isAlt  = false;
-            
-            scheduledQueue[i].data = scheduledDataPacket;
-            
-
-            scheduledQueue[i].scheduleTime = randomWait;
-            scheduledQueue[i].inUse = true;
-
-            scheduledDataPacket.destinationNode = 0;
-            scheduledDataPacket.messageID = 0;
-            return; 
+}
+/* Vecino al que va la trama (0 ⇒ difusión o anycast oportunista) */
+inline uint16_t itemUnicastDestination(int slot) {
+    switch (scheduledQueue[slot].kind) {
+        case ITEM_DATA: {
+            const DataPacket &data = itemData(slot);
+            return data.candidateCount > 0 ? 0 : data.nextHop;
         }
+        case ITEM_ACK:
+        case ITEM_ALT:
+            return scheduledQueue[slot].node;
+        default:
+            return 0;
     }
-    Serial.println("COLA LLENA: no se pudo encolar dataMessage");
+}
+/* DATA y HELLO deben despertar a un vecino de bajo consumo; ACK y ALT van */
+/* a quien espera su ACK (despierto)                                       */
+inline bool itemWakesNeighbor(int slot) {
+    uint8_t kind = scheduledQueue[slot].kind;
+    return kind == ITEM_DATA || kind == ITEM_HELLO;
+}
+inline void pushScheduledItem(int slot, unsigned long scheduleTime) {
+    ScheduledItem &item = scheduledQueue[slot];
+    item.scheduleTime = scheduleTime;
+    item.priorityClass = trafficClassOf(slot);
+    item.ready = false;
+    heapPush(timerHeap, slot);
+}
+inline void releaseQueueSlot(int slot) {
+    ScheduledItem &item = scheduledQueue[slot];
+    if (item.heapPos != SCHED_NOT_IN_HEAP) {
+        heapRemove(itemHeap(item), item.heapPos);
+    }
+    if (item.kind == ITEM_DATA) {
+        freeDataFrames[freeDataFrameCount++] = item.node;
+        updateCongestion();
+    } else if (item.kind == ITEM_ACK) {
+        MessageState *state = msgStateFind(item.messageID);
+        if (state != nullptr) {
+            state->flags &= ~MSG_STATE_ACK_QUEUED;
+        }
+    }
+    item.inUse = false;
+    freeSlots[freeSlotCount++] = slot;
+}
+/* Reprograma un elemento concreto sin tocar el resto de la cola */
+inline void rescheduleItem(int slot, unsigned long scheduleTime) {
+    ScheduledItem &item = scheduledQueue[slot];
+    if (item.heapPos == SCHED_NOT_IN_HEAP) {
+        return;
+    }
+    if (item.ready) {
+        /* vuelve a esperar en el temporizador */
+        heapRemove(schedulerHeaps[item.priorityClass], item.heapPos);
+        item.scheduleTime = scheduleTime;
+        item.ready = false;
+        heapPush(timerHeap, slot);
+        return;
+    }
+    item.scheduleTime = scheduleTime;
+    heapSiftUp(timerHeap, item.heapPos);
+    heapSiftDown(timerHeap, scheduledQueue[slot].heapPos);
 }
 
-inline void enqueueDataMessage(uint32_t payload, uint16_t customDestID) {
-    unsigned long randomWait = millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER);
-
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (!scheduledQueue[i].inUse) {
-            scheduledQueue[i].isAck   = false;
-            scheduledQueue[i].isHello= false;
-            scheduledQueue[i].isAlt  = false;
-
-            uint16_t localID = getNodeID();
-            uint16_t nextHop = getNextHop(localID, customDestID, 0);
+/*----------------------------------------------------------------------------*/
+/*  Back-off exponencial binario por elemento                                 */
+/*----------------------------------------------------------------------------*/
+/*  Cada elemento lleva su propia etapa: la ventana de contienda se duplica  */
+/*  con cada canal ocupado (o fallo de entrega) hasta BACKOFF_CW_MAX, y el   */
+/*  elemento espera un tiempo uniforme dentro de ella. El resto de la cola   */
+/*  no se ve afectado. Un elemento nuevo parte siempre de la etapa 0.        */
+inline unsigned long contentionDelay(uint8_t stage) {
+    unsigned long window = BACKOFF_CW_MIN;
+    for (uint8_t i = 0; i < stage && window < BACKOFF_CW_MAX; i++) {
+        window <<= 1;
+    }
+    if (window > BACKOFF_CW_MAX) {
+        window = BACKOFF_CW_MAX;
+    }
+    return random(0, window);
+}
+/* Canal ocupado: true si el elemento se aplazó, false si ya agotó las     */
+/* MAX_WINDOW_RETRIES etapas y debe enviarse igualmente (latencia acotada). */
+inline bool contentionBusy(int slot) {
+    ScheduledItem &item = scheduledQueue[slot];
+    if (item.backoffStage >= MAX_WINDOW_RETRIES) {
+        Serial.printf("Se alcanzó MAX_WINDOW_RETRIES=%d => enviamos de todas formas.\n", MAX_WINDOW_RETRIES);
+        return false;
+    }
+    item.backoffStage++;
+    unsigned long delayMs = contentionDelay(item.backoffStage);
+    Serial.printf("Canal ocupado (etapa %u) => back-off %lu ms\n", item.backoffStage, delayMs);
+    rescheduleItem(slot, millis() + delayMs);
+    return true;
+}
 
-            if (nextHop == INVALID_NEXT_HOP) {
-                Serial.printf("enqueueDataMessage => SIN vecinos válidos para destino ");
-                return;               
-            }
+/*----------------------------------------------------------------------------*/
+/*  Equidad por origen en FORWARD (start-time fair queuing)                   */
+/*----------------------------------------------------------------------------*/
+/*  S = max(V, F_origen), F_origen = S + coste; V es la etiqueta del último  */
+/*  reenvío servido. Orígenes sin tráfico reciente no acumulan crédito.      */
+struct OriginTag {
+    uint16_t origin;
+    uint32_t finishTag;
+    unsigned long lastUse;
+};
+static OriginTag originTags[QOS_MAX_ORIGINS];
+static uint8_t originTagCount = 0;
+static uint32_t forwardVirtualTime = 0;
+static uint32_t arrivalCounter = 0;
+
+inline OriginTag &originTagFor(uint16_t origin) {
+    int oldest = 0;
+    for (int i = 0; i < originTagCount; i++) {
+        if (originTags[i].origin == origin) {
+            return originTags[i];
+        }
+        if (timeBefore(originTags[i].lastUse, originTags[oldest].lastUse)) {
+            oldest = i;
+        }
+    }
+    int idx = (originTagCount < QOS_MAX_ORIGINS) ? originTagCount++ : oldest;
+    originTags[idx].origin = origin;
+    originTags[idx].finishTag = forwardVirtualTime;
+    return originTags[idx];
+}
+inline uint32_t forwardStartTag(int slot) {
+    OriginTag &tag = originTagFor(getMessageOrigin(itemData(slot).messageID));
+    uint32_t start = forwardVirtualTime;
+    if ((int32_t)(tag.finishTag - start) > 0) {
+        start = tag.finishTag;
+    }
+    tag.finishTag = start + itemCost(slot);
+    tag.lastUse = millis();
+    return start;
+}
 
-            fillDataPacket(scheduledQueue[i].data,customDestID, nextHop,1, 6, payload);
+/*----------------------------------------------------------------------------*/
+/*  Deficit round robin entre clases                                          */
+/*----------------------------------------------------------------------------*/
+static const uint8_t classWeights[SCHED_NUM_CLASSES] = {
+    QOS_WEIGHT_CONTROL, QOS_WEIGHT_ACK, QOS_WEIGHT_RETX, QOS_WEIGHT_FORWARD, QOS_WEIGHT_LOCAL, QOS_WEIGHT_BULK
+};
+static int32_t classDeficit[SCHED_NUM_CLASSES];
+static uint8_t drrCurrent = 0;
+static bool drrTurnStarted = false;
 
-            scheduledQueue[i].scheduleTime = randomWait;
-            scheduledQueue[i].inUse = true;
-            return;
+inline void drrAdvance() {
+    drrCurrent = (drrCurrent + 1) % SCHED_NUM_CLASSES;
+    drrTurnStarted = false;
+}
+/* Pasa a su clase los elementos cuyo scheduleTime ya venció */
+inline void promoteReadyItems(unsigned long now) {
+    while (timerHeap.size > 0 && !timeBefore(now, scheduledQueue[timerHeap.slots[0]].scheduleTime)) {
+        uint16_t slot = timerHeap.slots[0];
+        heapRemove(timerHeap, 0);
+        ScheduledItem &item = scheduledQueue[slot];
+        item.readyTag = (item.priorityClass == SCHED_CLASS_FORWARD) ? forwardStartTag(slot) : arrivalCounter++;
+        item.ready = true;
+        heapPush(schedulerHeaps[item.priorityClass], slot);
+    }
+}
+/* ms hasta el próximo envío de la cola (0 ⇒ hay alguno listo, -1 ⇒ vacía) */
+inline long schedulerNextDueMs(unsigned long now) {
+    for (int c = 0; c < SCHED_NUM_CLASSES; c++) {
+        if (schedulerHeaps[c].size > 0) {
+            return 0;
         }
     }
-    Serial.println("COLA LLENA: no se pudo encolar dataMessage (destino personalizado)");
+    if (timerHeap.size == 0) {
+        return -1;
+    }
+    long wait = (long)(scheduledQueue[timerHeap.slots[0]].scheduleTime - now);
+    return wait > 0 ? wait : 0;
 }
-
-inline void enqueueAckMessage(uint32_t messageID, uint16_t destinationNode) {
-    unsigned long randomWait = millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER);
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (!scheduledQueue[i].inUse) {
-            scheduledQueue[i].isAck = true;
-            scheduledQueue[i].isHello= false;
-            scheduledQueue[i].isAlt  = false;
-            fillAckPacket(scheduledQueue[i].ack, messageID, destinationNode);
-            scheduledQueue[i].scheduleTime = randomWait;
-            scheduledQueue[i].inUse = true;
-            return;
+/* ms hasta el primer timeout de ACK pendiente (-1 ⇒ ninguno) */
+inline long pendingAckNextDueMs(unsigned long now) {
+    long next = -1;
+    for (int i = 0; i < MAX_PENDING_ACKS; i++) {
+        const PendingAck &pending = pendingAcks[i];
+        if (pending.timestamp == 0 || pending.inQueue) {
+            continue;
+        }
+        long wait = (long)(pending.timestamp + pending.timeout - now);
+        if (wait < 0) {
+            wait = 0;
+        }
+        if (next < 0 || wait < next) {
+            next = wait;
         }
     }
-    Serial.println("COLA LLENA: no se pudo encolar ACK");
+    return next;
+}
+/* Siguiente elemento según DRR (-1 si no hay ninguno listo) */
+inline int peekReadyItem(unsigned long now) {
+    promoteReadyItems(now);
+    /* con quantum ≥ trama máxima basta una vuelta con turno nuevo */
+    for (int n = 0; n <= 2 * SCHED_NUM_CLASSES; n++) {
+        const SchedulerHeap &h = schedulerHeaps[drrCurrent];
+        if (h.size == 0) {
+            classDeficit[drrCurrent] = 0;
+            drrAdvance();
+            continue;
+        }
+        if (!drrTurnStarted) {
+            classDeficit[drrCurrent] += (int32_t)classWeights[drrCurrent] * QOS_QUANTUM_BYTES;
+            drrTurnStarted = true;
+        }
+        if (itemCost(h.slots[0]) <= classDeficit[drrCurrent]) {
+            return h.slots[0];
+        }
+        drrAdvance();
+    }
+    return -1;
+}
+/* Descuenta el envío del déficit de su clase */
+inline void drrCharge(int slot) {
+    const ScheduledItem &item = scheduledQueue[slot];
+    classDeficit[item.priorityClass] -= itemCost(slot);
+    if (item.priorityClass == SCHED_CLASS_FORWARD) {
+        forwardVirtualTime = item.readyTag;
+    }
 }
 
-inline void enqueueHelloMessage() {
-    unsigned long randomWait = millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER);
+/*----------------------------------------------------------------------------*/
+/*  Variables globales de apoyo                                               */
+/*----------------------------------------------------------------------------*/
+extern bool dataMessageSent;
+PendingAck pendingAcks[MAX_PENDING_ACKS];
 
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (!scheduledQueue[i].inUse) {
-            scheduledQueue[i].isAck   = false;
-            scheduledQueue[i].isHello= true;
-            scheduledQueue[i].isAlt  = false;
-            fillHelloPacket(scheduledQueue[i].hello);
-            scheduledQueue[i].scheduleTime = randomWait;
-            scheduledQueue[i].inUse = true;
-            return;
-        }
+/*----------------------------------------------------------------------------*/
+/*  Límite de ALT enviados por messageID (tabla de estado)                    */
+/*----------------------------------------------------------------------------*/
+inline bool canSendAlt(uint32_t messageID) {
+    MessageState *state = msgStateGet(messageID);
+    if (state == nullptr || state->altCount >= ALT_MAX_PER_MESSAGE) {
+        return false;
     }
-    Serial.println("COLA LLENA => No se pudo encolar HELLO");
+    state->altCount++;
+    return true;
 }
-inline void enqueueAltMessage(uint32_t messageID, uint16_t destinationNode) {
-    unsigned long randomWait = millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER);
 
-    for(int i=0; i<MAX_QUEUE_SIZE; i++) {
-        if(scheduledQueue[i].inUse == false) {
-            scheduledQueue[i].isAck   = false;
-            scheduledQueue[i].isHello= false;
-            scheduledQueue[i].isAlt  = true;
 
-            fillAltPacket(scheduledQueue[i].alt, messageID, destinationNode);
+/*============================================================================*/
+/*  4) Encolado de mensajes (DATA / ACK / HELLO / ALT)                        */
+/*============================================================================*/
+/*  Todas las altas devuelven EnqueueStatus. Los DATA nuevos (propios o a    */
+/*  reenviar) se rechazan con ENQUEUE_CONGESTED por encima de la marca alta; */
+/*  ACK y ALT disponen de ranuras reservadas y nunca compiten con DATA.      */
+/*----------------------------------------------------------------------------*/
+inline EnqueueStatus noteEnqueueStatus(EnqueueStatus status) {
+    if (status != ENQUEUE_OK) {
+        enqueueRejects[status]++;
+    }
+    return status;
+}
+/* DATA recibido que este nodo reenvía (ya admitido en processPayload) */
+inline EnqueueStatus enqueueForwardMessage(const DataView &packet) {
+    if (packet.destinationNode == 0) {
+        Serial.println("No se pudo encolar DATA: destinationNode = 0");
+        return noteEnqueueStatus(ENQUEUE_REJECTED);
+    }
+    if (packet.nextHop == INVALID_NEXT_HOP) {
+        Serial.printf("No se pudo encolar DATA: sin siguiente salto hacia %u\n", packet.destinationNode);
+        return noteEnqueueStatus(ENQUEUE_NO_ROUTE);
+    }
+    int slot = allocDataSlot();
+    if (slot < 0) {
+        Serial.println("COLA LLENA: no se pudo encolar dataMessage");
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    copyDataView(itemData(slot), packet);
+    pushScheduledItem(slot, millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER));
+    return ENQUEUE_OK;
+}
 
-            scheduledQueue[i].scheduleTime = randomWait;
-            scheduledQueue[i].inUse = true;
+inline EnqueueStatus enqueueDataMessage(const uint8_t *payload, uint8_t payloadLength, uint16_t customDestID) {
+    if (queueCongested()) {
+        Serial.println("COLA CONGESTIONADA: DATA propio no admitido, reintentar más tarde");
+        return noteEnqueueStatus(ENQUEUE_CONGESTED);
+    }
+    uint16_t localID = getNodeID();
+    uint16_t nextHop = getNextHop(localID, customDestID, 0);
+    if (nextHop == INVALID_NEXT_HOP) {
+        Serial.printf("enqueueDataMessage => SIN vecinos válidos para destino %u\n", customDestID);
+        return noteEnqueueStatus(ENQUEUE_NO_ROUTE);
+    }
+    int slot = allocDataSlot();
+    if (slot < 0) {
+        Serial.println("COLA LLENA: no se pudo encolar dataMessage (destino personalizado)");
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    fillDataPacket(itemData(slot),customDestID, nextHop,1, 6, payload, payloadLength);
+    fillForwardCandidates(itemData(slot), 0);
+    pushScheduledItem(slot, millis() + random(INITIAL_WAIT_LOWER, INITIAL_WAIT_UPPER));
+    return ENQUEUE_OK;
+}
 
-            Serial.println("ALT encolado en la cola.");
-            return;
-        }
+inline EnqueueStatus enqueueAckMessage(uint32_t messageID, uint16_t destinationNode) {
+    /* un ACK ya en cola para este messageID cubre también el replay */
+    MessageState *state = msgStateGet(messageID);
+    if (state != nullptr && (state->flags & MSG_STATE_ACK_QUEUED)) {
+        return ENQUEUE_OK;
     }
-    Serial.println("COLA LLENA => no se pudo encolar ALT");
+    int slot = allocQueueSlot(ITEM_ACK);
+    if (slot < 0) {
+        Serial.println("COLA LLENA: no se pudo encolar ACK");
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    if (state != nullptr) {
+        state->flags |= MSG_STATE_ACK_QUEUED;
+    }
+    scheduledQueue[slot].messageID = messageID;
+    scheduledQueue[slot].node = destinationNode;
+    /* jitter corto y acotado: el emisor mide RTT hasta este ACK */
+    pushScheduledItem(slot, millis() + random(ACK_JITTER_MIN_MS, ACK_JITTER_MAX_MS));
+    return ENQUEUE_OK;
+}
+
+inline EnqueueStatus enqueueHelloMessage() {
+    int slot = allocQueueSlot(ITEM_HELLO);
+    if (slot < 0) {
+        Serial.println("COLA LLENA => No se pudo encolar HELLO");
+        trickleNoteBlocked();
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    scheduledQueue[slot].messageID = getMessageID();
+    scheduledQueue[slot].node = 0;
+    /* Trickle ya aleatoriza el instante: basta un jitter corto */
+    pushScheduledItem(slot, millis() + random(0, HELLO_TX_JITTER_MS));
+    trickleNoteSent();
+    return ENQUEUE_OK;
+}
+inline EnqueueStatus enqueueAltMessage(uint32_t messageID, uint16_t destinationNode) {
+    int slot = allocQueueSlot(ITEM_ALT);
+    if (slot < 0) {
+        Serial.println("COLA LLENA => no se pudo encolar ALT");
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    scheduledQueue[slot].messageID = messageID;
+    scheduledQueue[slot].node = destinationNode;
+    /* responde en lugar del ACK: debe llegar antes del ACK_TIMEOUT del emisor */
+    pushScheduledItem(slot, millis() + random(ACK_JITTER_MIN_MS, ACK_JITTER_MAX_MS));
+    Serial.println("ALT encolado en la cola.");
+    return ENQUEUE_OK;
 }
 
 /*----------------------------------------------------------------------------*/
 /*  Envoltorios de “schedule” (interfaz pública)                              */
 /*----------------------------------------------------------------------------*/
-inline void scheduleAltMessage(uint32_t messageID, uint16_t destinationNode) {
+inline EnqueueStatus scheduleAltMessage(uint32_t messageID, uint16_t destinationNode) {
     if (!canSendAlt(messageID)) {
         Serial.printf("ALT SUPRIMIDO para messageID %u (límite %u alcanzado).\n", messageID, ALT_MAX_PER_MESSAGE);
-        return;                    
+        return ENQUEUE_REJECTED;
     }
-    enqueueAltMessage(messageID, destinationNode);
-    Serial.println("ALT programado en cola.");
+    EnqueueStatus status = enqueueAltMessage(messageID, destinationNode);
+    if (status == ENQUEUE_OK) {
+        Serial.println("ALT programado en cola.");
+    }
+    return status;
 }
 
-inline void scheduleHelloMessage() {
-    enqueueHelloMessage();
+inline EnqueueStatus scheduleHelloMessage() {
+    return enqueueHelloMessage();
+}
+inline EnqueueStatus scheduleMessage(const DataView &packet) {
+    EnqueueStatus status = enqueueForwardMessage(packet);
+    if (status == ENQUEUE_OK) {
+        Serial.println("Mensaje DATA programado. Esperando tiempo aleatorio en la cola.");
+    }
+    return status;
 }
-inline void scheduleMessage(uint32_t payload) {
-    enqueueDataMessage(payload);
-    Serial.println("Mensaje DATA programado. Esperando tiempo aleatorio en la cola.");
+inline EnqueueStatus scheduleAckMessage(uint32_t messageID, uint16_t destinationNode) {
+    EnqueueStatus status = enqueueAckMessage(messageID, destinationNode);
+    if (status == ENQUEUE_OK) {
+        Serial.println("ACK programado. Esperando tiempo aleatorio en la cola.");
+    }
+    return status;
 }
-inline void scheduleAckMessage(uint32_t messageID, uint16_t destinationNode) {
-    enqueueAckMessage(messageID, destinationNode);
-    Serial.println("ACK programado. Esperando tiempo aleatorio en la cola.");
+
+/*----------------------------------------------------------------------------*/
+/*  Estado de la cola (consola)                                               */
+/*----------------------------------------------------------------------------*/
+inline void printQueueStats() {
+    Serial.println("=== Cola de transmisión ===");
+    Serial.printf("  Ranuras: %u/%u  Tramas DATA: %u/%u (marcas %u/%u)\n",
+                  queueOccupancy(), MAX_QUEUE_SIZE, dataFrameOccupancy(), MAX_DATA_FRAMES,
+                  QUEUE_LOW_WATERMARK, QUEUE_HIGH_WATERMARK);
+    Serial.printf("  Congestión: %s (episodios=%lu)\n", queueCongested() ? "SI" : "NO",
+                  (unsigned long)congestionEpisodes);
+    Serial.printf("  Rechazos: llena=%lu congestión=%lu sin ruta=%lu otros=%lu\n",
+                  (unsigned long)enqueueRejects[ENQUEUE_FULL], (unsigned long)enqueueRejects[ENQUEUE_CONGESTED],
+                  (unsigned long)enqueueRejects[ENQUEUE_NO_ROUTE], (unsigned long)enqueueRejects[ENQUEUE_REJECTED]);
+    Serial.println("===========================");
 }
 
 /*============================================================================*/
@@ -263,163 +680,331 @@ inline void scheduleAckMessage(uint32_t messageID, uint16_t destinationNode) {
 /*============================================================================*/
 inline void initMessageScheduler() {
     dataMessageSent = false;
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
+    freeSlotCount = 0;
+    for (int i = MAX_QUEUE_SIZE - 1; i >= 0; i--) {
         scheduledQueue[i].inUse = false;
+        scheduledQueue[i].heapPos = SCHED_NOT_IN_HEAP;
+        freeSlots[freeSlotCount++] = i;
     }
+    freeDataFrameCount = 0;
+    for (int i = MAX_DATA_FRAMES - 1; i >= 0; i--) {
+        freeDataFrames[freeDataFrameCount++] = i;
+    }
+    timerHeap.size = 0;
+    timerHeap.byTag = false;
+    for (int c = 0; c < SCHED_NUM_CLASSES; c++) {
+        schedulerHeaps[c].size = 0;
+        schedulerHeaps[c].byTag = true;
+        classDeficit[c] = 0;
+    }
+    drrCurrent = 0;
+    drrTurnStarted = false;
+    congestionActive = false;
+    congestionEpisodes = 0;
+    for (int i = 0; i <= ENQUEUE_REJECTED; i++) {
+        enqueueRejects[i] = 0;
+    }
+    originTagCount = 0;
+    forwardVirtualTime = 0;
     for (int i = 0; i < MAX_PENDING_ACKS; i++) {
         pendingAcks[i].timestamp = 0;
         pendingAcks[i].retryCount = 0;
+        pendingAcks[i].inQueue = false;
     }
-    scheduledDataPacket.destinationNode = 0;
-    scheduledDataPacket.messageID = 0;
+    initMessageState();
+    initTrickle();
+    initRouteTable();
+    setRoutingStrategy(routingStrategy);
     scheduleHelloMessage();
-    nextHelloTimeAuto = millis() + HELLO_INTERVAL_MILLIS;
 }
 
 /*============================================================================*/
 /*  6) Gestion ACKs Pendientes                                                */
 /*============================================================================*/
-inline void addPendingAck(const DataPacket &packet) {
-    for (int i = 0; i < MAX_PENDING_ACKS; i++) {
-        if (pendingAcks[i].timestamp != 0 && pendingAcks[i].packet.messageID == packet.messageID)
-        {
-            Serial.printf("[addPendingAck] Ya existe pendiente para messageID=%u, se actualiza.\n",packet.messageID);
-            pendingAcks[i].timestamp  = millis();
-            return;
+inline int findPendingAck(uint32_t messageID) {
+    const MessageState *state = msgStateFind(messageID);
+    if (state == nullptr || (state->flags & MSG_STATE_PENDING) == 0) {
+        return -1;
+    }
+    return state->pendingSlot;
+}
+inline DataPacket &pendingData(int slot) {
+    return itemData(pendingAcks[slot].queueSlot);
+}
+/* Libera la entrada pendiente junto con su trama (ACK recibido o descarte) */
+inline void releasePendingAck(int slot) {
+    MessageState *state = msgStateFind(pendingData(slot).messageID);
+    if (state != nullptr) {
+        state->flags &= ~MSG_STATE_PENDING;
+        state->pendingSlot = MSG_STATE_NO_SLOT;
+    }
+    /* si había una retransmisión en cola, se cancela aquí */
+    releaseQueueSlot(pendingAcks[slot].queueSlot);
+    pendingAcks[slot].timestamp = 0;
+    pendingAcks[slot].retryCount = 0;
+    pendingAcks[slot].inQueue = false;
+}
+/* Tras enviar un DATA: arranca (o rearma) la espera de ACK. Devuelve false */
+/* si no se pudo registrar; en ese caso la trama se libera sin seguimiento. */
+inline bool addPendingAck(int queueSlot) {
+    const DataPacket &packet = itemData(queueSlot);
+    int existing = findPendingAck(packet.messageID);
+    if (existing >= 0) {
+        PendingAck &pending = pendingAcks[existing];
+        if (pending.queueSlot != queueSlot) {
+            /* otra copia del mismo messageID: se conserva la recién enviada */
+            releaseQueueSlot(pending.queueSlot);
+            pending.queueSlot = queueSlot;
         }
+        pending.timestamp = millis();
+        pending.timeout = getAckTimeout(packet.nextHop);
+        pending.inQueue = false;
+        return true;
     }
     for (int i = 0; i < MAX_PENDING_ACKS; i++) {
         if (pendingAcks[i].timestamp == 0) {
-            pendingAcks[i].packet = packet;
+            MessageState *state = msgStateGet(packet.messageID);
+            if (state == nullptr) {
+                break;
+            }
+            state->flags |= MSG_STATE_PENDING;
+            state->pendingSlot = (uint8_t)i;
+            pendingAcks[i].queueSlot = queueSlot;
             pendingAcks[i].timestamp = millis();
+            pendingAcks[i].timeout = getAckTimeout(packet.nextHop);
             pendingAcks[i].retryCount = 0;
-            return;
+            pendingAcks[i].inQueue = false;
+            return true;
         }
     }
     Serial.println("No hay espacio en pendingAcks!");
+    return false;
+}
+/*----------------------------------------------------------------------------*/
+/*  Retransmisión rápida (en el sitio)                                        */
+/*----------------------------------------------------------------------------*/
+/*  La misma ranura vuelve a la cola con un jitter corto y acotado en vez de  */
+/*  la espera inicial de 3–7 s, en la clase RETX (por encima del tráfico      */
+/*  nuevo). La etapa de back-off crece con cada fallo.                        */
+inline void pushRetransmission(int pendingSlot, uint8_t backoffStage) {
+    PendingAck &pending = pendingAcks[pendingSlot];
+    int slot = pending.queueSlot;
+    ScheduledItem &item = scheduledQueue[slot];
+    if (item.heapPos != SCHED_NOT_IN_HEAP) {
+        heapRemove(itemHeap(item), item.heapPos); // ya estaba en cola
+    }
+    item.backoffStage = backoffStage;
+    pushScheduledItem(slot, millis() + random(RETX_JITTER_MIN_MS, RETX_JITTER_MAX_MS) +
+                            (backoffStage > 0 ? contentionDelay(backoffStage) : 0));
+    item.priorityClass = SCHED_CLASS_RETX;
+    pending.inQueue = true;
 }
 
 /*============================================================================*/
-/*  7) HELLO automático                                                       */
+/*  7) HELLO automático (temporizador Trickle, routing_manager.h)             */
 /*============================================================================*/
 inline void checkAutoHello() {
-    if (millis() >= nextHelloTimeAuto) {
+    if (trickleShouldSend()) {
         scheduleHelloMessage();
-        nextHelloTimeAuto = millis() + HELLO_INTERVAL_MILLIS;
     }
 }
 
+/*----------------------------------------------------------------------------*/
+/*  Codificación de un elemento de la cola en txFrame (devuelve su tamaño)    */
+/*----------------------------------------------------------------------------*/
+inline uint16_t encodeScheduledItem(int slot) {
+    const ScheduledItem &item = scheduledQueue[slot];
+    switch (item.kind) {
+        case ITEM_ALT: {
+            AltPacket alt;
+            fillAltPacket(alt, item.messageID, item.node);
+            return serializePacket(alt, txFrame, sizeof(txFrame));
+        }
+        case ITEM_ACK: {
+            AckPacket ack;
+            fillAckPacket(ack, item.messageID, item.node);
+            tpcFillAckReport(ack);
+            return serializePacket(ack, txFrame, sizeof(txFrame));
+        }
+        case ITEM_HELLO: {
+            HelloPacket hello;
+            fillHelloPacket(hello, item.messageID);
+            fillHelloRoutes(hello);
+            fillHelloGradient(hello);
+            fillHelloLpl(hello);
+            return serializePacket(hello, txFrame, sizeof(txFrame));
+        }
+        case ITEM_DATA:
+            return serializePacket(itemData(slot), txFrame, sizeof(txFrame));
+        default:
+            return 0;
+    }
+}
+/* Sin presupuesto de aire: el elemento se aplaza hasta que la ventana      */
+/* libere lo necesario. ACK y ALT pueden usar la reserva de control.       */
+inline bool deferForAirtime(int slot, uint16_t frameSize) {
+    const ScheduledItem &item = scheduledQueue[slot];
+    bool control = (item.kind == ITEM_ACK || item.kind == ITEM_ALT);
+    uint32_t toaUs = (item.kind == ITEM_DATA) ? rateDataToaUs(itemData(slot), frameSize) : getTimeOnAirUs(frameSize);
+    toaUs += lplExtraToaUs(itemWakesNeighbor(slot), itemUnicastDestination(slot));
+    if (airtimeAvailable(toaUs, control)) {
+        return false;
+    }
+    unsigned long resumeAt = airtimeNextAvailable(toaUs, control);
+    Serial.printf("Ciclo de trabajo agotado: elemento aplazado %lu ms\n", resumeAt - millis());
+    rescheduleItem(slot, resumeAt);
+    airtimeDeferrals++;
+    lbtReset();
+    return true;
+}
+
+/* Un DATA sólo sale si su ACK podrá seguirse: sin entrada en la tabla de
+   estado (llena) se queda en cola y se reintenta tras un jitter corto */
+inline bool deferUntracked(int slot) {
+    if (scheduledQueue[slot].kind != ITEM_DATA || msgStateGet(itemData(slot).messageID) != nullptr) {
+        return false;
+    }
+    rescheduleItem(slot, millis() + random(RETX_JITTER_MIN_MS, RETX_JITTER_MAX_MS));
+    lbtReset();
+    return true;
+}
+
 /*============================================================================*/
 /*  8) Función principal de mantenimiento                                     */
 /*============================================================================*/
 inline void updateMessageScheduler() {
     /*------ 8.1 Reintentos de ACK -----------------------------------------*/
     for (int i = 0; i < MAX_PENDING_ACKS; i++) {
-        if (pendingAcks[i].timestamp != 0 && (millis() - pendingAcks[i].timestamp >= ACK_TIMEOUT)) {
-            
-            if (pendingAcks[i].retryCount < MAX_RETRIES) {
-                Serial.printf("Reintentando envío de messageID: %u\n", pendingAcks[i].packet.messageID);
-                scheduledDataPacket = pendingAcks[i].packet; 
-                enqueueDataMessage(pendingAcks[i].packet.payload);
-                pendingAcks[i].timestamp = millis();
-                pendingAcks[i].retryCount++;
-            } else {
-                Serial.printf("No se recibió ACK tras %u reintentos para messageID: %u. Descarta.\n",MAX_RETRIES, pendingAcks[i].packet.messageID);
-                DataPacket original = pendingAcks[i].packet;
-                pendingAcks[i].timestamp = 0;
-                pendingAcks[i].retryCount = 0;
-                reEnqueueAlternateRoute(original, 0, true); 
-            }
+        PendingAck &pending = pendingAcks[i];
+        if (pending.timestamp == 0 || pending.inQueue || (millis() - pending.timestamp) < pending.timeout) {
+            continue;
+        }
+        const DataPacket &data = pendingData(i);
+        noteNeighborAckTimeout(data.nextHop);
+        if (pending.retryCount < MAX_RETRIES) {
+            Serial.printf("Reintentando envío de messageID: %u\n", data.messageID);
+            pending.retryCount++;
+            /* el temporizador de ACK se rearma al salir la retransmisión */
+            pushRetransmission(i, pending.retryCount);
+        } else {
+            Serial.printf("No se recibió ACK tras %u reintentos para messageID: %u. Descarta.\n",MAX_RETRIES, data.messageID);
+            reEnqueueAlternateRoute(i, 0, true); 
         }
     }
+    msgStateSweep(MSG_STATE_SWEEP_STEP); // expiración incremental
 
-    /*------ 8.2 Nada que hacer si radio ocupado ---------------------------*/
-    if (!loraIdle) {
+    /*------ 8.2 Nada que hacer si radio ocupado (salvo CAD propio) --------*/
+    if (!loraIdle && !lbtInProgress()) {
         return;
     }
-    /*------ 8.3 Selección de siguiente elemento listo ---------------------*/
-    unsigned long now = millis();
-    int indexToSend = -1;
-    /* ACK prioritario */
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (scheduledQueue[i].inUse && scheduledQueue[i].scheduleTime <= now && scheduledQueue[i].isAck) {
-            indexToSend = i;
-            break;
-        }
+    /* cita a otro SF en curso (RDV enviado o recibido) */
+    if (!lbtInProgress() && rateService()) {
+        return;
     }
-    /* cualquier otro si no hubo ACK listo */
+    /*------ 8.3 Selección de siguiente elemento listo ---------------------*/
+    /* reparto DRR entre clases; FIFO dentro de cada una (SFQ en FORWARD)   */
+    int indexToSend = peekReadyItem(millis());
     if (indexToSend == -1) {
-        for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-            if (scheduledQueue[i].inUse && scheduledQueue[i].scheduleTime <= now) {
-                indexToSend = i;
-                break;
-            }
-        }
+        lbtReset();
+        return;
     }
+    /*------ 8.4 Presupuesto de tiempo en el aire --------------------------*/
+    /* se comprueba antes de ocupar el canal con la evaluación LBT          */
+    if (!lbtInProgress() && (deferUntracked(indexToSend) ||
+                             deferForAirtime(indexToSend, encodeScheduledItem(indexToSend)))) {
+        return;
+    }
+    /*------ 8.5 Listen-before-talk (no bloqueante) ------------------------*/
+    uint8_t channel = windowCollisionPrevention();
+    if (channel == LBT_RESULT_PENDING) {
+        return; // evaluación del canal en curso
+    }
+    /* durante la evaluación pudo quedar listo un elemento más prioritario */
+    indexToSend = peekReadyItem(millis());
     if (indexToSend == -1) {
         return;
     }
-    /*------ 8.4 Listen-before-talk ----------------------------------------*/
-    windowCollisionPrevention();
-    /*------ 8.5 Envío ------------------------------------------------------*/
-    if(scheduledQueue[indexToSend].isAlt == true) {
-        handleTransmission(scheduledQueue[indexToSend].alt);
-        Serial.printf("ALT enviado => messageID=%u\n", scheduledQueue[indexToSend].alt.messageID);
+    if (channel == LBT_RESULT_BUSY && contentionBusy(indexToSend)) {
+        return; // sólo este elemento retrocede
+    }
+    if (deferUntracked(indexToSend)) {
+        return;
     }
-    else if (scheduledQueue[indexToSend].isAck) {
-        handleTransmission(scheduledQueue[indexToSend].ack);
-        Serial.printf("ACK enviado para messageID: %u\n", scheduledQueue[indexToSend].ack.messageID);
-        rememberAckSent(scheduledQueue[indexToSend].ack.messageID);
-    } 
-    else if (scheduledQueue[indexToSend].isHello) {
-        handleTransmission(scheduledQueue[indexToSend].hello);
+    uint16_t frameSize = encodeScheduledItem(indexToSend);
+    if (deferForAirtime(indexToSend, frameSize)) {
+        return;
     }
-    else {
-        handleTransmission(scheduledQueue[indexToSend].data);
-        Serial.printf("Mensaje DATA enviado con payload=%u, nextHop=%u\n",scheduledQueue[indexToSend].data.payload,scheduledQueue[indexToSend].data.nextHop);
-        addPendingAck(scheduledQueue[indexToSend].data);
-        dataMessageSent = true;
+    /*------ 8.6 Envío ------------------------------------------------------*/
+    const ScheduledItem &item = scheduledQueue[indexToSend];
+    tpcApply(itemUnicastDestination(indexToSend)); // potencia del enlace
+    lplApply(itemWakesNeighbor(indexToSend), itemUnicastDestination(indexToSend)); // preámbulo largo si duerme
+    if (item.kind == ITEM_DATA) {
+        rateSendData(itemData(indexToSend), frameSize); // SF del enlace (con RDV si difiere)
+    } else {
+        sendFrame(frameSize);
     }
-    scheduledQueue[indexToSend].inUse = false;
+    switch (item.kind) {
+        case ITEM_ALT:
+            Serial.printf("ALT enviado => messageID=%u\n", item.messageID);
+            break;
+        case ITEM_ACK:
+            Serial.printf("ACK enviado para messageID: %u\n", item.messageID);
+            rememberAckSent(item.messageID);
+            break;
+        case ITEM_HELLO:
+            routeNoteHelloSent(); // el vector enviado fija secuencia y cursor
+            break;
+        case ITEM_DATA: {
+            const DataPacket &data = itemData(indexToSend);
+            Serial.printf("Mensaje DATA enviado con payload=%u bytes, nextHop=%u\n",data.payloadLength,data.nextHop);
+            dataMessageSent = true;
+            oppNoteSent(data.messageID);
+            break;
+        }
+        default:
+            break;
+    }
+    drrCharge(indexToSend);
+    if (item.kind == ITEM_DATA) {
+        /* la trama queda fuera de los heaps, retenida hasta su ACK */
+        heapRemove(itemHeap(item), item.heapPos);
+        if (addPendingAck(indexToSend)) {
+            return;
+        }
+    }
+    releaseQueueSlot(indexToSend);
 }
 
 /*============================================================================*/
 /*  9) Re-enqueue por ruta alterna                                            */
 /*============================================================================*/
-inline void reEnqueueAlternateRoute(const DataPacket &originalPacket,uint16_t excludeNeighbor,bool removeNeighborFlag) {
+inline void reEnqueueAlternateRoute(int pendingSlot,uint16_t excludeNeighbor,bool removeNeighborFlag) {
+    DataPacket &packet = pendingData(pendingSlot);
 
-    if (!canReenqueue(originalPacket.messageID)) {
-        Serial.printf("reEnqueueAlternateRoute => ""Límite de %u rutas agotado para msgID=%u. Se descarta.\n",ROUTE_MAX_ALTERNATES, originalPacket.messageID);
+    if (!canReenqueue(packet.messageID)) {
+        Serial.printf("reEnqueueAlternateRoute => ""Límite de %u rutas agotado para msgID=%u. Se descarta.\n",ROUTE_MAX_ALTERNATES, packet.messageID);
+        releasePendingAck(pendingSlot);
         return;      
     }
-    DataPacket copyPacket = originalPacket;
+    trickleReset("fallo de ruta");
 
     if (removeNeighborFlag == true) {
-        removeNeighbor(copyPacket.nextHop);
+        removeNeighbor(packet.nextHop);
     }
 
-    uint16_t newHop = getNextHop(getNodeID(),copyPacket.destinationNode,excludeNeighbor);
+    uint16_t newHop = getNextHop(getNodeID(),packet.destinationNode,excludeNeighbor);
 
     if (newHop == INVALID_NEXT_HOP) {
         Serial.println("reEnqueueAlternateRoute => No se encontró nextHop, mensaje descartado.");
+        releasePendingAck(pendingSlot);
     } else {
-        copyPacket.nextHop = newHop;
-        scheduledDataPacket = copyPacket;
-        enqueueDataMessage(copyPacket.payload);
-        Serial.printf("reEnqueueAlternateRoute => msgID=%u reencolado con nextHop=%u\n",copyPacket.messageID,newHop);
+        /* misma trama, nuevo salto: se retransmite por la vía rápida */
+        packet.nextHop = newHop;
+        fillForwardCandidates(packet, excludeNeighbor);
+        pendingAcks[pendingSlot].retryCount = 0;
+        pushRetransmission(pendingSlot, 0);
+        Serial.printf("reEnqueueAlternateRoute => msgID=%u reencolado con nextHop=%u\n",packet.messageID,newHop);
     }
 }
 
-/*============================================================================*/
-/*  10) Incremento de espera tras recepción                                    */
-/*============================================================================*/
-inline void increaseWaitTime() {
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++) {
-        if (scheduledQueue[i].inUse) {
-            scheduledQueue[i].scheduleTime += random(BACKOFF_LOWER, BACKOFF_UPPER);
-        }
-    }
-}
-
-
 #endif
@@ -0,0 +1,206 @@
+/*==============================================================================
+  message_state.h
+  ------------------------------------------------------------------------------
+  Tabla única de estado por messageID (hash de direccionamiento abierto).
+  – Sustituye los historiales de re-enqueue, ALT, ACK replay y la búsqueda
+    lineal de pendingAcks por una sola consulta O(1).
+  – Cada entrada guarda bits de estado, marcas de tiempo y contadores.
+  – Las entradas caducan por tiempo (MSG_STATE_TTL_MS) y se barren de forma
+    incremental desde el planificador.
+  – Con la tabla en su límite de carga, un alta expulsa la entrada más
+    antigua de dos ventanas cortas (coste acotado, no recorre la tabla).
+==============================================================================*/
+#ifndef MESSAGE_STATE_H
+#define MESSAGE_STATE_H
+
+#include "config.h"
+#include "Arduino.h"
+#include <stdint.h>
+
+#define MSG_STATE_MASK (MSG_STATE_CAPACITY - 1)
+#define MSG_STATE_LOAD_LIMIT ((MSG_STATE_CAPACITY * 3) / 4)
+
+static_assert((MSG_STATE_CAPACITY & MSG_STATE_MASK) == 0, "MSG_STATE_CAPACITY debe ser potencia de 2");
+static_assert(MAX_PENDING_ACKS < 0xFF, "pendingSlot usa 0xFF como vacío");
+
+/*----------------------------------------------------------------------------*/
+/*  Bits de estado                                                            */
+/*----------------------------------------------------------------------------*/
+#define MSG_STATE_USED      0x01 // ranura ocupada
+#define MSG_STATE_ACK_SENT  0x02 // ACK enviado (ventana de replay)
+#define MSG_STATE_PENDING   0x04 // esperando ACK (pendingSlot válido)
+#define MSG_STATE_ACK_QUEUED 0x08 // ACK en la cola de transmisión
+
+#define MSG_STATE_NO_SLOT   0xFF
+
+/*----------------------------------------------------------------------------*/
+/*  Entrada de la tabla                                                       */
+/*----------------------------------------------------------------------------*/
+struct MessageState {
+    uint32_t messageID;
+    uint8_t  flags;
+    uint8_t  routeCount;     // re-enqueues por ruta alterna
+    uint8_t  altCount;       // ALT enviados para este messageID
+    uint8_t  pendingSlot;    // índice en pendingAcks
+    unsigned long ackSentAt; // último ACK enviado
+    unsigned long lastTouch; // último acceso (expiración)
+};
+
+static MessageState messageStates[MSG_STATE_CAPACITY];
+static int msgStateCount = 0;
+static int msgStateSweepPos = 0;
+static int msgStateEvictPos = 0;
+
+inline int msgStateHash(uint32_t messageID) {
+    return (int)((messageID * 2654435761u) >> 16) & MSG_STATE_MASK;
+}
+inline bool msgStateExpired(const MessageState &e, unsigned long now) {
+    return (e.flags & MSG_STATE_PENDING) == 0 && (now - e.lastTouch) > MSG_STATE_TTL_MS;
+}
+inline void msgStateClear(MessageState &e, uint32_t messageID, unsigned long now) {
+    e.messageID = messageID;
+    e.flags = MSG_STATE_USED;
+    e.routeCount = 0;
+    e.altCount = 0;
+    e.pendingSlot = MSG_STATE_NO_SLOT;
+    e.ackSentAt = 0;
+    e.lastTouch = now;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Borrado con desplazamiento hacia atrás (sin lápidas)                      */
+/*----------------------------------------------------------------------------*/
+inline void msgStateRemoveAt(int idx) {
+    messageStates[idx].flags = 0;
+    msgStateCount--;
+    int next = (idx + 1) & MSG_STATE_MASK;
+    while (messageStates[next].flags & MSG_STATE_USED) {
+        int home = msgStateHash(messageStates[next].messageID);
+        if (((next - home) & MSG_STATE_MASK) >= ((next - idx) & MSG_STATE_MASK)) {
+            messageStates[idx] = messageStates[next];
+            messageStates[next].flags = 0;
+            idx = next;
+        }
+        next = (next + 1) & MSG_STATE_MASK;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Barrido incremental: revisa 'steps' ranuras y libera las caducadas        */
+/*----------------------------------------------------------------------------*/
+inline void msgStateSweep(int steps) {
+    unsigned long now = millis();
+    int n = 0;
+    while (n < steps) {
+        MessageState &e = messageStates[msgStateSweepPos];
+        if ((e.flags & MSG_STATE_USED) && msgStateExpired(e, now)) {
+            /* el desplazamiento puede traer otra entrada a esta ranura */
+            msgStateRemoveAt(msgStateSweepPos);
+            continue;
+        }
+        msgStateSweepPos = (msgStateSweepPos + 1) & MSG_STATE_MASK;
+        n++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Expulsión acotada (tabla en MSG_STATE_LOAD_LIMIT)                         */
+/*----------------------------------------------------------------------------*/
+/*  Se examinan a lo sumo 2 × MSG_STATE_EVICT_SCAN ranuras: el cúmulo de      */
+/*  sondeo donde caerá la entrada nueva (así además se acorta) y una ventana  */
+/*  rotatoria estilo reloj que recorre toda la tabla con el tiempo. Gana la   */
+/*  de acceso más antiguo sin ACK pendiente; las caducadas son las primeras.  */
+/*----------------------------------------------------------------------------*/
+inline void msgStateConsiderVictim(int idx, int &victim, unsigned long now) {
+    const MessageState &e = messageStates[idx];
+    if ((e.flags & MSG_STATE_USED) && (e.flags & MSG_STATE_PENDING) == 0 &&
+        (victim < 0 || (now - e.lastTouch) > (now - messageStates[victim].lastTouch))) {
+        victim = idx;
+    }
+}
+/* Ranura a liberar para dar de alta messageID (-1 ⇒ ninguna) */
+inline int msgStateEvictionVictim(uint32_t messageID, unsigned long now) {
+    int victim = -1;
+    int idx = msgStateHash(messageID);
+    for (int n = 0; n < MSG_STATE_EVICT_SCAN && (messageStates[idx].flags & MSG_STATE_USED); n++) {
+        msgStateConsiderVictim(idx, victim, now);
+        idx = (idx + 1) & MSG_STATE_MASK;
+    }
+    for (int n = 0; n < MSG_STATE_EVICT_SCAN; n++) {
+        msgStateConsiderVictim(msgStateEvictPos, victim, now);
+        msgStateEvictPos = (msgStateEvictPos + 1) & MSG_STATE_MASK;
+    }
+    return victim;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consulta (nullptr si no existe o ya caducó)                               */
+/*----------------------------------------------------------------------------*/
+inline MessageState *msgStateFind(uint32_t messageID) {
+    int idx = msgStateHash(messageID);
+    for (int n = 0; n < MSG_STATE_CAPACITY; n++) {
+        MessageState &e = messageStates[idx];
+        if ((e.flags & MSG_STATE_USED) == 0) {
+            return nullptr;
+        }
+        if (e.messageID == messageID) {
+            return msgStateExpired(e, millis()) ? nullptr : &e;
+        }
+        idx = (idx + 1) & MSG_STATE_MASK;
+    }
+    return nullptr;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consulta o alta (nullptr sólo si no hay ranura libre ni expulsable)       */
+/*----------------------------------------------------------------------------*/
+inline MessageState *msgStateGet(uint32_t messageID) {
+    unsigned long now = millis();
+    int idx = msgStateHash(messageID);
+    for (int n = 0; n < MSG_STATE_CAPACITY; n++) {
+        MessageState &e = messageStates[idx];
+        if ((e.flags & MSG_STATE_USED) == 0) {
+            break;
+        }
+        if (e.messageID == messageID) {
+            if (msgStateExpired(e, now)) {
+                msgStateClear(e, messageID, now);
+            }
+            e.lastTouch = now;
+            return &e;
+        }
+        idx = (idx + 1) & MSG_STATE_MASK;
+    }
+    /* Alta: en el factor de carga se expulsa una entrada antes de insertar */
+    if (msgStateCount >= MSG_STATE_LOAD_LIMIT) {
+        int victim = msgStateEvictionVictim(messageID, now);
+        if (victim >= 0) {
+            msgStateRemoveAt(victim);
+        } else if (msgStateCount >= MSG_STATE_CAPACITY - 1) {
+            Serial.println("Tabla de estado de mensajes llena.");
+            return nullptr;
+        }
+        /* sin víctima en las ventanas se admite por encima del límite */
+    }
+    idx = msgStateHash(messageID);
+    while (messageStates[idx].flags & MSG_STATE_USED) {
+        idx = (idx + 1) & MSG_STATE_MASK;
+    }
+    msgStateClear(messageStates[idx], messageID, now);
+    msgStateCount++;
+    return &messageStates[idx];
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Inicialización                                                            */
+/*----------------------------------------------------------------------------*/
+inline void initMessageState() {
+    for (int i = 0; i < MSG_STATE_CAPACITY; i++) {
+        messageStates[i].flags = 0;
+    }
+    msgStateCount = 0;
+    msgStateSweepPos = 0;
+    msgStateEvictPos = 0;
+}
+
+#endif
@@ -0,0 +1,193 @@
+/*==============================================================================
+  opportunistic_manager.h
+  ------------------------------------------------------------------------------
+  Reenvío oportunista "cualquiera de N" (estilo ExOR).
+  – El emisor lista en la cabecera DATA hasta OPP_MAX_CANDIDATES
+    reenviadores por prioridad; el primero es el nextHop de siempre.
+  – El candidato 0 actúa como hoy (ACK + reenvío). Los demás retienen una
+    copia que sale tras una espera proporcional a su puesto, salvo que antes
+    oigan reenviar o confirmar el mismo messageID a otro nodo.
+  – El emisor da por entregada su trama al oír que un candidato la reenvía
+    (ACK implícito), sin esperar al ACK ni al timeout.
+  – Los candidatos extra deben acercar la trama al destino: la alternativa
+    viable de la tabla DSDV (malla) o vecinos de menor rango (recolección).
+==============================================================================*/
+#ifndef OPPORTUNISTIC_MANAGER_H
+#define OPPORTUNISTIC_MANAGER_H
+
+#include "config.h"
+#include "packet_manager.h"
+#include "routing_manager.h"
+#include "collection_manager.h"
+#include "message_scheduler.h"
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+struct OppHeld {
+    uint32_t messageID;
+    uint16_t queueSlot;  // copia en la cola (clase FORWARD)
+    uint16_t sender;     // salto previo, al que se confirmará si sale
+    bool     used;
+};
+static bool oppEnabled = OPP_ENABLED;
+static OppHeld oppHeld[OPP_MAX_HELD];
+static uint32_t oppHeldTotal = 0;
+static uint32_t oppSuppressed = 0;
+static uint32_t oppReleased = 0;
+static uint32_t oppImplicitAcks = 0;
+
+/*----------------------------------------------------------------------------*/
+/*  Emisor: lista de candidatos                                               */
+/*----------------------------------------------------------------------------*/
+inline bool oppListed(const DataHeader &h, uint8_t count, uint16_t nodeID) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (h.candidates[i] == nodeID) {
+            return true;
+        }
+    }
+    return false;
+}
+/* Completa candidates a partir de h.nextHop (ya elegido); excludeID = salto previo */
+inline void fillForwardCandidates(DataHeader &h, uint16_t excludeID) {
+    h.candidateCount = 0;
+    if (!oppEnabled || h.nextHop == INVALID_NEXT_HOP || h.nextHop == h.destinationNode) {
+        return;
+    }
+    uint8_t count = 0;
+    h.candidates[count++] = h.nextHop;
+    if (collectHandlesDestination(h.destinationNode)) {
+        /* vecinos más cerca del sumidero que nosotros, por rango vía ellos */
+        while (count < OPP_MAX_CANDIDATES) {
+            int best = -1;
+            uint16_t bestRank = COLLECT_RANK_INFINITY;
+            for (int p = 0; p < neighborRankCount; p++) {
+                int idx = neighborRank[p];
+                uint16_t id = neighborTable[idx].neighborId;
+                uint16_t rank = collectRankVia(idx);
+                if (id != excludeID && rank < bestRank && neighborTable[idx].gradientRank < collectState.rank &&
+                    !oppListed(h, count, id)) {
+                    bestRank = rank;
+                    best = idx;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            h.candidates[count++] = neighborTable[best].neighborId;
+        }
+    } else {
+        uint16_t alt = getRouteAlternate(h.destinationNode, excludeID, h.nextHop);
+        if (alt != INVALID_NEXT_HOP && count < OPP_MAX_CANDIDATES) {
+            h.candidates[count++] = alt;
+        }
+    }
+    h.candidateCount = (count > 1) ? count : 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Candidatos de reserva: copias retenidas                                   */
+/*----------------------------------------------------------------------------*/
+inline int oppFindHeld(uint32_t messageID) {
+    for (int i = 0; i < OPP_MAX_HELD; i++) {
+        if (oppHeld[i].used && oppHeld[i].messageID == messageID) {
+            return i;
+        }
+    }
+    return -1;
+}
+inline bool oppIsHeld(uint32_t messageID) {
+    return oppFindHeld(messageID) >= 0;
+}
+/* Encola la copia (ya preparada para reenvío) con espera según su puesto */
+inline EnqueueStatus oppHoldForward(const DataView &packet, uint16_t sender, int rank) {
+    int h;
+    for (h = 0; h < OPP_MAX_HELD && oppHeld[h].used; h++) {
+    }
+    if (h == OPP_MAX_HELD) {
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    int slot = allocDataSlot();
+    if (slot < 0) {
+        return noteEnqueueStatus(ENQUEUE_FULL);
+    }
+    copyDataView(itemData(slot), packet);
+    /* el candidato 0 confirma y reenvía dentro de INITIAL_WAIT_UPPER */
+    pushScheduledItem(slot, millis() + INITIAL_WAIT_UPPER + (unsigned long)rank * OPP_RANK_DELAY_MS +
+                            random(0, OPP_RANK_DELAY_MS / 2));
+    oppHeld[h].messageID = packet.messageID;
+    oppHeld[h].queueSlot = slot;
+    oppHeld[h].sender = sender;
+    oppHeld[h].used = true;
+    oppHeldTotal++;
+    Serial.printf("Oportunista => msgID=%u retenido (puesto %d)\n", packet.messageID, rank);
+    return ENQUEUE_OK;
+}
+/* Otro nodo se hizo cargo: se cancela la copia si aún no salió */
+inline void oppCancelHeld(int h) {
+    OppHeld &held = oppHeld[h];
+    const ScheduledItem &item = scheduledQueue[held.queueSlot];
+    if (item.inUse && item.kind == ITEM_DATA && item.heapPos != SCHED_NOT_IN_HEAP &&
+        itemData(held.queueSlot).messageID == held.messageID) {
+        releaseQueueSlot(held.queueSlot);
+        oppSuppressed++;
+        Serial.printf("Oportunista => msgID=%u suprimido (otro candidato lo reenvió)\n", held.messageID);
+    }
+    held.used = false;
+}
+/* La copia retenida salió: se confirma al salto previo */
+inline void oppNoteSent(uint32_t messageID) {
+    int h = oppFindHeld(messageID);
+    if (h < 0) {
+        return;
+    }
+    oppReleased++;
+    scheduleAckMessage(messageID, oppHeld[h].sender);
+    oppHeld[h].used = false;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Escucha: supresión y ACK implícito                                        */
+/*----------------------------------------------------------------------------*/
+/*  Se llama con toda trama DATA o ACK de la malla, vaya o no dirigida a     */
+/*  este nodo. sender = emisor de la trama; ackDestination = destinatario   */
+/*  del ACK (0 para DATA).                                                   */
+inline void oppOverheard(uint8_t messageType, uint32_t messageID, uint16_t sender, uint16_t ackDestination) {
+    int h = oppFindHeld(messageID);
+    if (h >= 0) {
+        bool forwardedByOther = (messageType == MESSAGE_TYPE_DATA && sender != oppHeld[h].sender);
+        bool ackedByOther = (messageType == MESSAGE_TYPE_ACK && ackDestination == oppHeld[h].sender);
+        if (forwardedByOther || ackedByOther) {
+            oppCancelHeld(h);
+        }
+    }
+    if (messageType != MESSAGE_TYPE_DATA) {
+        return;
+    }
+    int slot = findPendingAck(messageID);
+    if (slot < 0 || sender == getNodeID()) {
+        return;
+    }
+    /* un candidato de nuestra trama la reenvía: entregada */
+    if (dataCandidateRank(pendingData(slot), sender) >= 0) {
+        Serial.printf("ACK implícito de %u para messageID: %u\n", sender, messageID);
+        linkNoteAck(sender, true);
+        releasePendingAck(slot);
+        addMessageIDAfterAck(messageID);
+        oppImplicitAcks++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printOppStats() {
+    Serial.println("=== Reenvío oportunista ===");
+    Serial.printf("  Estado: %s, candidatos máx.: %u\n", oppEnabled ? "activo" : "inactivo", OPP_MAX_CANDIDATES);
+    Serial.printf("  Copias retenidas: %lu, suprimidas: %lu, reenviadas: %lu\n",
+                  (unsigned long)oppHeldTotal, (unsigned long)oppSuppressed, (unsigned long)oppReleased);
+    Serial.printf("  ACK implícitos: %lu\n", (unsigned long)oppImplicitAcks);
+    Serial.println("===========================");
+}
+
+#endif
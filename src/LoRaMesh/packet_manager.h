@@ -1,9 +1,11 @@
 /*==============================================================================
   packet_manager.h
   ------------------------------------------------------------------------------
-  Define estructuras DataPacket, AckPacket, HelloPacket y AltPacket.
+  Define estructuras DataPacket, AckPacket, HelloPacket, AltPacket y RdvPacket.
+  – DATA lleva payload de longitud variable (hasta MAX_PAYLOAD_SIZE bytes).
   – Genera nodeID y messageID únicos.
-  – Serializa / deserializa paquetes según el primer byte (messageType).
+  – Serializa / deserializa paquetes en un formato compacto little-endian
+    (tipo y flags empaquetados en el primer byte, varints, meshID opcional).
 ==============================================================================*/
 #ifndef PACKET_MANAGER_H
 #define PACKET_MANAGER_H
@@ -12,11 +14,19 @@
 #include <stdint.h>
 #include <string.h>  //memcpy()
 #include <esp_system.h> //ESP.getEfuseMac()
+#include <Preferences.h> //secuencia de mensajes en NVS
 
 /*----------------------------------------------------------------------------*/
 /*  Estructuras de paquete                                                    */
 /*----------------------------------------------------------------------------*/
-struct DataPacket {
+/*  Vista no propietaria sobre un rango de bytes (estilo span).               */
+struct ByteSpan {
+    const uint8_t *data;
+    uint16_t length;
+};
+/*  Cabecera DATA; DataPacket añade almacenamiento propio del payload (cola)  */
+/*  y DataView lo referencia directamente dentro de receivedBuffer.           */
+struct DataHeader {
     uint8_t messageType;     
     uint16_t meshID;         
     uint32_t messageID;      
@@ -25,7 +35,15 @@ struct DataPacket {
     uint16_t nextHop;        
     uint8_t extra;        
     uint8_t ttl;             
-    uint32_t payload;        
+    uint8_t candidateCount;  // 0 ⇒ unicast; si no, candidates[0] == nextHop
+    uint16_t candidates[OPP_MAX_CANDIDATES]; // reenviadores por prioridad
+};
+struct DataPacket : DataHeader {
+    uint8_t payloadLength;
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+};
+struct DataView : DataHeader {
+    ByteSpan payload;
 };
 struct AckPacket {
     uint8_t messageType;     
@@ -33,12 +51,28 @@ struct AckPacket {
     uint32_t messageID;      
     uint16_t originNode;     
     uint16_t destinationNode;
+    bool     hasReport;      // informe de enlace presente (control de potencia)
+    int8_t   reportMarginDb; // margen con que se oyó el último DATA del destino
+};
+/*  Entrada del vector de distancias que viaja en HELLO (estilo DSDV).       */
+struct RouteAdvert {
+    uint16_t destination;
+    uint8_t  cost;         // coste acumulado (ROUTE_COST_INFINITY ⇒ ruta rota)
+    uint16_t seq;          // número de secuencia emitido por el destino
 };
 struct HelloPacket {
     uint8_t  messageType;  
     uint16_t meshID;       
     uint32_t messageID;    
     uint16_t originNode;   
+    uint16_t seq;          // secuencia propia del emisor (siempre par)
+    uint8_t  routeCount;
+    RouteAdvert routes[ROUTE_ADVERT_MAX];
+    bool     hasGradient;    // bloque de recolección presente
+    uint16_t gradientSink;   // sumidero al que apunta el gradiente
+    uint16_t gradientRank;   // coste acumulado hasta el sumidero (0 en el sumidero)
+    uint16_t gradientParent; // padre elegido por el emisor
+    uint16_t lplIntervalMs;  // periodo de muestreo del emisor (0 ⇒ siempre a la escucha)
 };
 struct AltPacket {
     uint8_t messageType;
@@ -47,13 +81,27 @@ struct AltPacket {
     uint16_t originNode;
     uint16_t destinationNode;
 };
+/*  Cita previa a un DATA enviado a un SF distinto del de control.           */
+struct RdvPacket {
+    uint8_t messageType;
+    uint16_t meshID;
+    uint32_t messageID;       // el del DATA que sigue
+    uint16_t originNode;
+    uint16_t destinationNode; // nextHop del DATA
+    uint8_t spreadingFactor;  // SF al que llegará el DATA
+    uint8_t channel;          // canal de datos (CHANNEL_CONTROL ⇒ el de control)
+};
 /*----------------------------------------------------------------------------*/
 /*  Pendiente de ACK                                                          */
 /*----------------------------------------------------------------------------*/
+/*  La trama no se copia: queueSlot es la ranura del planificador que la    */
+/*  conserva hasta el ACK y desde la que se retransmite en el sitio.         */
 struct PendingAck {
-    DataPacket packet;
-    unsigned long timestamp;
+    uint16_t queueSlot;      // ranura de scheduledQueue con la trama DATA
+    unsigned long timestamp; // último envío (0 ⇒ libre)
+    unsigned long timeout;   // espera de ACK para el envío actual
     uint8_t retryCount;      
+    bool inQueue;            // retransmisión en cola (sin temporizador de ACK)
 };
 
 /*============================================================================*/
@@ -64,40 +112,88 @@ inline uint16_t getNodeID() {
     uint16_t nodeId = (uint16_t)((chipId & 0xFFFF) ^ ((chipId >> 32) & 0xFFFF)); 
     return nodeId;
 }
-inline uint32_t getMessageID(uint8_t messageType) {
-    // Genera un número aleatorio de 8 bits
-    uint8_t randomNumber = random(0, 256);
+/*----------------------------------------------------------------------------*/
+/*  messageID = (nodo origen << 16) | secuencia de 16 bits del origen.        */
+/*  La secuencia crece de forma monótona (módulo 2^16) y el receptor la usa   */
+/*  para la ventana anti-replay por origen (message_receiver.h). Para que un  */
+/*  reinicio no la haga retroceder, se reservan en NVS bloques de             */
+/*  MSG_SEQ_RESERVE_BLOCK secuencias: al arrancar se sigue desde el final del */
+/*  último bloque reservado (salto hacia delante de menos de un bloque) y     */
+/*  sólo se escribe en flash una vez por bloque. Sin nada guardado (primer    */
+/*  arranque o flash borrada) arranca en un valor aleatorio.                  */
+/*----------------------------------------------------------------------------*/
+inline uint16_t loadMessageSequence() {
+    Preferences store;
+    store.begin(MSG_SEQ_NVS_NAMESPACE, true);
+    uint16_t sequence = store.isKey("seq") ? store.getUShort("seq", 0) : (uint16_t)random(0, 65536);
+    store.end();
+    return sequence;
+}
+inline void reserveMessageSequence(uint16_t reservedEnd) {
+    Preferences store;
+    store.begin(MSG_SEQ_NVS_NAMESPACE, false);
+    store.putUShort("seq", reservedEnd);
+    store.end();
+}
+inline uint32_t getMessageID() {
+    static uint16_t sequence = loadMessageSequence();
+    static uint16_t reservedEnd = sequence;
+    if (sequence == reservedEnd) {
+        reservedEnd = (uint16_t)(sequence + MSG_SEQ_RESERVE_BLOCK);
+        reserveMessageSequence(reservedEnd);
+    }
     uint16_t nodeId = getNodeID();
-    uint32_t messageID = ((uint32_t)messageType << 24) | ((uint32_t)nodeId << 8) | ((uint32_t)(randomNumber & 0xFF));
+    uint32_t messageID = ((uint32_t)nodeId << 16) | sequence;
+    sequence++;
     return messageID;
 }
+inline uint16_t getMessageOrigin(uint32_t messageID) {
+    return (uint16_t)(messageID >> 16);
+}
+inline uint16_t getMessageSequence(uint32_t messageID) {
+    return (uint16_t)(messageID & 0xFFFF);
+}
 /*============================================================================*/
 /*  Helpers de rellenado                                                      */
 /*============================================================================*/
-inline void fillDataPacket(DataPacket &packet, uint8_t messageType, uint16_t meshID, uint32_t messageID,
-                    uint16_t originNode, uint16_t destinationNode, uint16_t nextHop, 
-                    uint8_t extra, uint8_t ttl, uint32_t payload) {
-    packet.messageType = messageType;
-    packet.meshID = meshID;
-    packet.messageID = messageID;
-    packet.originNode = originNode;
-    packet.destinationNode = destinationNode;
-    packet.nextHop = nextHop;
-    packet.extra = extra;
-    packet.ttl = ttl;
-    packet.payload = payload;
+inline void setDataPayload(DataPacket &packet, const uint8_t *payload, uint8_t payloadLength) {
+    if (payloadLength > MAX_PAYLOAD_SIZE) {
+        payloadLength = MAX_PAYLOAD_SIZE;
+    }
+    packet.payloadLength = payloadLength;
+    if (payloadLength > 0 && payload != nullptr) {
+        memcpy(packet.payload, payload, payloadLength);
+    }
 }
 inline void fillDataPacket(DataPacket &packet, uint16_t destinationNode, uint16_t nextHop, 
-                    uint8_t extra, uint8_t ttl, uint32_t payload) {
+                    uint8_t extra, uint8_t ttl, const uint8_t *payload, uint8_t payloadLength) {
     packet.messageType = MESSAGE_TYPE_DATA;
     packet.meshID = MESH_ID;
-    packet.messageID = getMessageID(MESSAGE_TYPE_DATA);
+    packet.messageID = getMessageID();
     packet.originNode = getNodeID();
     packet.destinationNode = destinationNode;
     packet.nextHop = nextHop;
     packet.extra = extra;
     packet.ttl = ttl;
-    packet.payload = payload;
+    packet.candidateCount = 0;
+    setDataPayload(packet, payload, payloadLength);
+}
+/* Copia una vista recibida a un DataPacket propio (p.ej. para reenviarlo) */
+inline void copyDataView(DataPacket &packet, const DataView &view) {
+    static_cast<DataHeader &>(packet) = view;
+    setDataPayload(packet, view.payload.data, (uint8_t)view.payload.length);
+}
+/* Puesto de nodeID entre los reenviadores del DATA (0 = nextHop, -1 = ninguno) */
+inline int dataCandidateRank(const DataHeader &packet, uint16_t nodeID) {
+    if (packet.nextHop == nodeID) {
+        return 0;
+    }
+    for (uint8_t i = 1; i < packet.candidateCount; i++) {
+        if (packet.candidates[i] == nodeID) {
+            return i;
+        }
+    }
+    return -1;
 }
 inline void fillAckPacket(AckPacket &packet, uint32_t messageID, uint16_t destinationNode) {
     packet.messageType = MESSAGE_TYPE_ACK;
@@ -105,12 +201,18 @@ inline void fillAckPacket(AckPacket &packet, uint32_t messageID, uint16_t destin
     packet.messageID = messageID;
     packet.originNode = getNodeID();
     packet.destinationNode = destinationNode;
+    packet.hasReport = false; // lo añade power_manager al enviar
+    packet.reportMarginDb = 0;
 }
-inline void fillHelloPacket(HelloPacket &pkt) {
+inline void fillHelloPacket(HelloPacket &pkt, uint32_t messageID) {
     pkt.messageType = MESSAGE_TYPE_HELLO;
     pkt.meshID      = MESH_ID;
-    pkt.messageID   = getMessageID(MESSAGE_TYPE_HELLO);
+    pkt.messageID   = messageID;
     pkt.originNode  = getNodeID();
+    pkt.seq         = 0;
+    pkt.routeCount  = 0; // el vector lo añade routing_manager al enviar
+    pkt.hasGradient = false; // y el gradiente, collection_manager
+    pkt.lplIntervalMs = 0;   // y el muestreo, lpl_manager
 }
 inline void fillAltPacket(AltPacket &packet,uint32_t messageID,uint16_t destinationNode) {
     packet.messageType = MESSAGE_TYPE_ALT;
@@ -119,54 +221,349 @@ inline void fillAltPacket(AltPacket &packet,uint32_t messageID,uint16_t destinat
     packet.originNode = getNodeID();
     packet.destinationNode = destinationNode;
 }
+inline void fillRdvPacket(RdvPacket &packet, uint32_t messageID, uint16_t destinationNode,
+                          uint8_t spreadingFactor, uint8_t channel) {
+    packet.messageType = MESSAGE_TYPE_RDV;
+    packet.meshID = MESH_ID;
+    packet.messageID = messageID;
+    packet.originNode = getNodeID();
+    packet.destinationNode = destinationNode;
+    packet.spreadingFactor = spreadingFactor;
+    packet.channel = channel;
+}
 /*============================================================================*/
-/*  Serialización / deserialización                                           */
+/*  Formato en el aire (compacto, little-endian explícito)                    */
 /*============================================================================*/
-inline void serializePacket(const void *packet, uint8_t *buffer) {
-    if (packet == nullptr || buffer == nullptr) {
+/*  Byte 0 ........ bits 0-3 = messageType, bits 4-7 = flags (WIRE_FLAG_*).   */
+/*  [meshID] ...... u16, sólo si WIRE_FLAG_MESH_ID (si falta ⇒ MESH_ID local). */
+/*  messageID ..... u32.                                                      */
+/*  originNode .... u16.                                                      */
+/*  DATA .......... destinationNode u16, nextHop u16, extra varint,           */
+/*                  ttl varint, [n u8, (n − 1) × candidato u16 si             */
+/*                  WIRE_FLAG_CANDIDATES; el primero es nextHop],             */
+/*                  payload = resto de la trama (sin longitud).               */
+/*  ACK ........... destinationNode u16, [margen i8 si WIRE_FLAG_LINK_REPORT]. */
+/*  ALT ........... destinationNode u16.                                      */
+/*  RDV ........... destinationNode u16, spreadingFactor u8, canal u8.        */
+/*  HELLO ......... [periodo de muestreo u16 si WIRE_FLAG_LPL],               */
+/*                  seq u16, n u8, n × (destino u16, coste u8, seq u16).       */
+/*                  [sumidero u16, rango u16, padre u16] opcional al final.  */
+/*                  Un HELLO sin vector (sólo cabecera) sigue siendo válido.  */
+/*                                                                            */
+/*  Bytes de cabecera (con meshID / sin meshID): DATA 15/13 + payload,        */
+/*  ACK 11/9 (+1 con informe), HELLO 12/10 + 5 por ruta (+6 con gradiente,   */
+/*  +2 con muestreo), ALT 11/9,                                               */
+/*  RDV 13/11.                                                                */
+/*----------------------------------------------------------------------------*/
+#define WIRE_TYPE_MASK      0x0F
+#define WIRE_FLAG_MESH_ID   0x10
+#define WIRE_FLAG_CANDIDATES 0x20 // DATA con lista de reenviadores oportunistas
+#define WIRE_FLAG_LINK_REPORT 0x40 // ACK con margen de enlace medido por el receptor
+#define WIRE_FLAG_LPL       0x80 // HELLO de un nodo con escucha de bajo consumo
+
+#define WIRE_VARINT_MAX_U32 5
+#define WIRE_COMMON_HEADER_MAX (1 + 2 + 4 + 2)
+#define WIRE_DATA_HEADER_MAX (WIRE_COMMON_HEADER_MAX + 2 + 2 + 2 + 2 + 1 + (OPP_MAX_CANDIDATES - 1) * 2)
+#define WIRE_DATA_MAX_SIZE  (WIRE_DATA_HEADER_MAX + MAX_PAYLOAD_SIZE)
+#define WIRE_ACK_MAX_SIZE   (WIRE_COMMON_HEADER_MAX + 2 + 1)
+#define WIRE_ROUTE_ADVERT_SIZE 5
+#define WIRE_GRADIENT_SIZE 6
+#define WIRE_HELLO_MAX_SIZE (WIRE_COMMON_HEADER_MAX + 2 + 2 + 1 + ROUTE_ADVERT_MAX * WIRE_ROUTE_ADVERT_SIZE + WIRE_GRADIENT_SIZE)
+#define WIRE_ALT_MAX_SIZE   (WIRE_COMMON_HEADER_MAX + 2)
+#define WIRE_RDV_MAX_SIZE   (WIRE_COMMON_HEADER_MAX + 2 + 1 + 1)
+
+/*----------------------------------------------------------------------------*/
+/*  Escritor / lector de bytes con control de límites                         */
+/*----------------------------------------------------------------------------*/
+struct WireWriter {
+    uint8_t *buffer;
+    uint16_t capacity;
+    uint16_t pos;
+    bool ok;
+};
+struct WireReader {
+    const uint8_t *buffer;
+    uint16_t length;
+    uint16_t pos;
+    bool ok;
+};
+
+inline void wirePutU8(WireWriter &w, uint8_t value) {
+    if (!w.ok || w.pos + 1 > w.capacity) {
+        w.ok = false;
         return;
     }
-    uint8_t messageType = *(reinterpret_cast<const uint8_t *>(packet));
+    w.buffer[w.pos++] = value;
+}
+inline void wirePutU16(WireWriter &w, uint16_t value) {
+    wirePutU8(w, (uint8_t)(value & 0xFF));
+    wirePutU8(w, (uint8_t)(value >> 8));
+}
+inline void wirePutU32(WireWriter &w, uint32_t value) {
+    wirePutU16(w, (uint16_t)(value & 0xFFFF));
+    wirePutU16(w, (uint16_t)(value >> 16));
+}
+/* LEB128 sin signo: 7 bits por byte, bit 7 = continúa */
+inline void wirePutVarint(WireWriter &w, uint32_t value) {
+    while (value >= 0x80) {
+        wirePutU8(w, (uint8_t)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    wirePutU8(w, (uint8_t)value);
+}
 
-    switch (messageType) {
-        case MESSAGE_TYPE_DATA:
-            memcpy(buffer, packet, sizeof(DataPacket));
-            break;
-        case MESSAGE_TYPE_ACK:
-            memcpy(buffer, packet, sizeof(AckPacket));
-            break;
-        case MESSAGE_TYPE_HELLO:
-            memcpy(buffer, packet, sizeof(HelloPacket));
-            break;
-        case MESSAGE_TYPE_ALT:
-            memcpy(buffer, packet, sizeof(AltPacket));
-            break;
-        default:
-            break;
+inline uint8_t wireGetU8(WireReader &r) {
+    if (!r.ok || r.pos + 1 > r.length) {
+        r.ok = false;
+        return 0;
     }
+    return r.buffer[r.pos++];
+}
+inline uint16_t wireGetU16(WireReader &r) {
+    uint16_t lo = wireGetU8(r);
+    uint16_t hi = wireGetU8(r);
+    return (uint16_t)(lo | (hi << 8));
+}
+inline uint32_t wireGetU32(WireReader &r) {
+    uint32_t lo = wireGetU16(r);
+    uint32_t hi = wireGetU16(r);
+    return lo | (hi << 16);
+}
+inline uint32_t wireGetVarint(WireReader &r) {
+    uint32_t value = 0;
+    for (int i = 0; i < WIRE_VARINT_MAX_U32; i++) {
+        uint8_t b = wireGetU8(r);
+        value |= (uint32_t)(b & 0x7F) << (7 * i);
+        if ((b & 0x80) == 0) {
+            return value;
+        }
+    }
+    r.ok = false; // varint demasiado largo
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Cabecera común (tipo + flags, meshID opcional, messageID, originNode)     */
+/*----------------------------------------------------------------------------*/
+inline uint8_t getPacketType(const uint8_t *buffer) {
+    return buffer[0] & WIRE_TYPE_MASK;
+}
+inline void wirePutHeader(WireWriter &w, uint8_t messageType, uint16_t meshID,
+                          uint32_t messageID, uint16_t originNode, uint8_t flags = 0) {
+    uint8_t first = (messageType & WIRE_TYPE_MASK) | flags;
+#if WIRE_OMIT_MESH_ID
+    bool withMesh = (meshID != MESH_ID);
+#else
+    bool withMesh = true;
+#endif
+    if (withMesh) {
+        first |= WIRE_FLAG_MESH_ID;
+    }
+    wirePutU8(w, first);
+    if (withMesh) {
+        wirePutU16(w, meshID);
+    }
+    wirePutU32(w, messageID);
+    wirePutU16(w, originNode);
+}
+inline void wireGetHeader(WireReader &r, uint8_t &messageType, uint16_t &meshID,
+                          uint32_t &messageID, uint16_t &originNode) {
+    uint8_t first = wireGetU8(r);
+    messageType = first & WIRE_TYPE_MASK;
+    meshID = (first & WIRE_FLAG_MESH_ID) ? wireGetU16(r) : (uint16_t)MESH_ID;
+    messageID = wireGetU32(r);
+    originNode = wireGetU16(r);
+}
+/* Emisor de cualquier trama (originNode de la cabecera común = último salto) */
+inline bool peekPacketSender(const uint8_t *buffer, uint16_t length, uint16_t &meshID, uint16_t &originNode) {
+    if (buffer == nullptr || length == 0) {
+        return false;
+    }
+    WireReader r = { buffer, length, 0, true };
+    uint8_t messageType;
+    uint32_t messageID;
+    wireGetHeader(r, messageType, meshID, messageID, originNode);
+    return r.ok;
 }
 
-inline void deserializePacket(void *packet, const uint8_t *buffer) {
-    if (packet == nullptr || buffer == nullptr) {
+/*============================================================================*/
+/*  Serialización / deserialización                                           */
+/*============================================================================*/
+/*  serializePacket() escribe la trama completa en el buffer de destino y     */
+/*  devuelve los bytes escritos (0 ⇒ error / sin espacio).                    */
+/*  deserializePacket() devuelve false si la trama está truncada o el tipo    */
+/*  no coincide. Para DATA se obtiene una DataView cuyo payload apunta al     */
+/*  propio buffer recibido (sin copia).                                       */
+/*----------------------------------------------------------------------------*/
+inline void wirePutDataHeader(WireWriter &w, const DataHeader &h) {
+    bool withCandidates = h.candidateCount > 1;
+    wirePutHeader(w, h.messageType, h.meshID, h.messageID, h.originNode,
+                  withCandidates ? WIRE_FLAG_CANDIDATES : 0);
+    wirePutU16(w, h.destinationNode);
+    wirePutU16(w, h.nextHop);
+    wirePutVarint(w, h.extra);
+    wirePutVarint(w, h.ttl);
+    if (withCandidates) {
+        wirePutU8(w, h.candidateCount);
+        for (uint8_t i = 1; i < h.candidateCount; i++) {
+            wirePutU16(w, h.candidates[i]);
+        }
+    }
+}
+inline void wirePutBytes(WireWriter &w, const uint8_t *data, uint16_t length) {
+    if (!w.ok || w.pos + length > w.capacity) {
+        w.ok = false;
         return;
     }
-    uint8_t messageType = buffer[0];
-    switch (messageType) {
-        case MESSAGE_TYPE_DATA:
-            memcpy(packet, buffer, sizeof(DataPacket));
-            break;
-        case MESSAGE_TYPE_ACK:
-            memcpy(packet, buffer, sizeof(AckPacket));
-            break;
-        case MESSAGE_TYPE_HELLO:
-            memcpy(packet, buffer, sizeof(HelloPacket));
-            break;
-        case MESSAGE_TYPE_ALT:
-            memcpy(packet, buffer, sizeof(AltPacket));
-            break;
-        default:
-            break;
+    if (length > 0) {
+        memcpy(w.buffer + w.pos, data, length);
+    }
+    w.pos += length;
+}
+
+inline uint16_t serializePacket(const DataPacket &p, uint8_t *buffer, uint16_t capacity) {
+    WireWriter w = { buffer, capacity, 0, true };
+    wirePutDataHeader(w, p);
+    wirePutBytes(w, p.payload, p.payloadLength);
+    return w.ok ? w.pos : 0;
+}
+inline uint16_t serializePacket(const AckPacket &p, uint8_t *buffer, uint16_t capacity) {
+    WireWriter w = { buffer, capacity, 0, true };
+    wirePutHeader(w, p.messageType, p.meshID, p.messageID, p.originNode,
+                  p.hasReport ? WIRE_FLAG_LINK_REPORT : 0);
+    wirePutU16(w, p.destinationNode);
+    if (p.hasReport) {
+        wirePutU8(w, (uint8_t)p.reportMarginDb);
+    }
+    return w.ok ? w.pos : 0;
+}
+inline uint16_t serializePacket(const HelloPacket &p, uint8_t *buffer, uint16_t capacity) {
+    WireWriter w = { buffer, capacity, 0, true };
+    wirePutHeader(w, p.messageType, p.meshID, p.messageID, p.originNode,
+                  p.lplIntervalMs != 0 ? WIRE_FLAG_LPL : 0);
+    if (p.lplIntervalMs != 0) {
+        wirePutU16(w, p.lplIntervalMs);
+    }
+    wirePutU16(w, p.seq);
+    wirePutU8(w, p.routeCount);
+    for (uint8_t i = 0; i < p.routeCount; i++) {
+        wirePutU16(w, p.routes[i].destination);
+        wirePutU8(w, p.routes[i].cost);
+        wirePutU16(w, p.routes[i].seq);
+    }
+    if (p.hasGradient) {
+        wirePutU16(w, p.gradientSink);
+        wirePutU16(w, p.gradientRank);
+        wirePutU16(w, p.gradientParent);
+    }
+    return w.ok ? w.pos : 0;
+}
+inline uint16_t serializePacket(const AltPacket &p, uint8_t *buffer, uint16_t capacity) {
+    WireWriter w = { buffer, capacity, 0, true };
+    wirePutHeader(w, p.messageType, p.meshID, p.messageID, p.originNode);
+    wirePutU16(w, p.destinationNode);
+    return w.ok ? w.pos : 0;
+}
+inline uint16_t serializePacket(const RdvPacket &p, uint8_t *buffer, uint16_t capacity) {
+    WireWriter w = { buffer, capacity, 0, true };
+    wirePutHeader(w, p.messageType, p.meshID, p.messageID, p.originNode);
+    wirePutU16(w, p.destinationNode);
+    wirePutU8(w, p.spreadingFactor);
+    wirePutU8(w, p.channel);
+    return w.ok ? w.pos : 0;
+}
+
+inline bool deserializePacket(DataView &p, const uint8_t *buffer, uint16_t length) {
+    if (buffer == nullptr || length == 0 || getPacketType(buffer) != MESSAGE_TYPE_DATA) {
+        return false;
+    }
+    WireReader r = { buffer, length, 0, true };
+    wireGetHeader(r, p.messageType, p.meshID, p.messageID, p.originNode);
+    p.destinationNode = wireGetU16(r);
+    p.nextHop = wireGetU16(r);
+    p.extra = (uint8_t)wireGetVarint(r);
+    p.ttl = (uint8_t)wireGetVarint(r);
+    p.candidateCount = 0;
+    if (buffer[0] & WIRE_FLAG_CANDIDATES) {
+        uint8_t count = wireGetU8(r);
+        if (count < 2 || count > OPP_MAX_CANDIDATES) {
+            return false;
+        }
+        p.candidates[0] = p.nextHop;
+        for (uint8_t i = 1; i < count; i++) {
+            p.candidates[i] = wireGetU16(r);
+        }
+        p.candidateCount = count;
+    }
+    if (!r.ok || length - r.pos > MAX_PAYLOAD_SIZE) {
+        return false;
+    }
+    p.payload.data = buffer + r.pos;
+    p.payload.length = length - r.pos;
+    return true;
+}
+inline bool deserializePacket(AckPacket &p, const uint8_t *buffer, uint16_t length) {
+    if (buffer == nullptr || length == 0 || getPacketType(buffer) != MESSAGE_TYPE_ACK) {
+        return false;
+    }
+    WireReader r = { buffer, length, 0, true };
+    wireGetHeader(r, p.messageType, p.meshID, p.messageID, p.originNode);
+    p.destinationNode = wireGetU16(r);
+    p.hasReport = (buffer[0] & WIRE_FLAG_LINK_REPORT) != 0;
+    p.reportMarginDb = p.hasReport ? (int8_t)wireGetU8(r) : 0;
+    return r.ok;
+}
+inline bool deserializePacket(HelloPacket &p, const uint8_t *buffer, uint16_t length) {
+    if (buffer == nullptr || length == 0 || getPacketType(buffer) != MESSAGE_TYPE_HELLO) {
+        return false;
+    }
+    WireReader r = { buffer, length, 0, true };
+    wireGetHeader(r, p.messageType, p.meshID, p.messageID, p.originNode);
+    p.seq = 0;
+    p.routeCount = 0;
+    p.hasGradient = false;
+    p.lplIntervalMs = (buffer[0] & WIRE_FLAG_LPL) ? wireGetU16(r) : 0;
+    if (r.ok && r.pos == length) {
+        return true; // HELLO sin vector de distancias
+    }
+    p.seq = wireGetU16(r);
+    uint8_t count = wireGetU8(r);
+    if (count > ROUTE_ADVERT_MAX) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        p.routes[i].destination = wireGetU16(r);
+        p.routes[i].cost = wireGetU8(r);
+        p.routes[i].seq = wireGetU16(r);
+    }
+    p.routeCount = count;
+    if (r.ok && r.pos < length) {
+        p.gradientSink = wireGetU16(r);
+        p.gradientRank = wireGetU16(r);
+        p.gradientParent = wireGetU16(r);
+        p.hasGradient = true;
+    }
+    return r.ok;
+}
+inline bool deserializePacket(AltPacket &p, const uint8_t *buffer, uint16_t length) {
+    if (buffer == nullptr || length == 0 || getPacketType(buffer) != MESSAGE_TYPE_ALT) {
+        return false;
+    }
+    WireReader r = { buffer, length, 0, true };
+    wireGetHeader(r, p.messageType, p.meshID, p.messageID, p.originNode);
+    p.destinationNode = wireGetU16(r);
+    return r.ok;
+}
+inline bool deserializePacket(RdvPacket &p, const uint8_t *buffer, uint16_t length) {
+    if (buffer == nullptr || length == 0 || getPacketType(buffer) != MESSAGE_TYPE_RDV) {
+        return false;
     }
+    WireReader r = { buffer, length, 0, true };
+    wireGetHeader(r, p.messageType, p.meshID, p.messageID, p.originNode);
+    p.destinationNode = wireGetU16(r);
+    p.spreadingFactor = wireGetU8(r);
+    p.channel = wireGetU8(r);
+    return r.ok;
 }
 
 #endif
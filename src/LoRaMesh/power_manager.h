@@ -0,0 +1,172 @@
+/*==============================================================================
+  power_manager.h
+  ------------------------------------------------------------------------------
+  Control de potencia de transmisión por enlace (lazo cerrado).
+  – El receptor mide el margen con que oye cada DATA dirigido a él (SNR
+    sobre el límite del SF al que llegó; con SNR saturada, RSSI sobre la
+    sensibilidad) y lo devuelve en el ACK (WIRE_FLAG_LINK_REPORT).
+  – El emisor ajusta la potencia hacia ese vecino para mantener el margen
+    en [TPC_TARGET_MARGIN_DB, + TPC_HYSTERESIS_DB]: sube de golpe lo que
+    falte, baja como mucho TPC_STEP_DOWN_DB por informe y sube
+    TPC_STEP_UP_LOSS_DB por cada ACK perdido.
+  – La potencia se aplica trama a trama a DATA, RDV, ACK y ALT unicast;
+    HELLO y el DATA con candidatos oportunistas salen a TX_OUTPUT_POWER.
+==============================================================================*/
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include "config.h"
+#include "lora_manager.h"
+#include "packet_manager.h"
+#include "routing_manager.h"
+
+#define TPC_LEVELS (TX_OUTPUT_POWER - TPC_MIN_DBM + 1)
+
+extern LoraManager loraAntena;
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+static bool tpcEnabled = TPC_ENABLED;
+static uint32_t tpcFramesByPower[TPC_LEVELS];
+static uint32_t tpcChanges = 0;
+static uint32_t tpcReports = 0;
+
+inline int8_t tpcClamp(int power) {
+    if (power < TPC_MIN_DBM) {
+        return TPC_MIN_DBM;
+    }
+    if (power > TX_OUTPUT_POWER) {
+        return TX_OUTPUT_POWER;
+    }
+    return (int8_t)power;
+}
+inline void tpcSetPower(NeighborInfo &n, int power, const char *reason) {
+    int8_t next = tpcClamp(power);
+    if (next == n.txPowerDbm) {
+        return;
+    }
+    Serial.printf("Potencia => vecino %u: %d -> %d dBm (%s)\n", n.neighborId, n.txPowerDbm, next, reason);
+    n.txPowerDbm = next;
+    tpcChanges++;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Receptor: margen del enlace                                               */
+/*----------------------------------------------------------------------------*/
+/*  Límite de SNR ≈ 10 − 2,5·SF dB; sensibilidad ≈ −174 + 10·log10(BW) + NF  */
+/*  (6 dB) + límite, es decir −117 dBm + límite a 125 kHz (+3 dB por cada    */
+/*  duplicación del ancho de banda).                                         */
+inline int8_t tpcLinkMarginDb(int16_t rssi, int8_t snr, uint8_t spreadingFactor) {
+    int32_t limitQ4 = 160 - 40 * spreadingFactor;
+    int32_t marginQ4 = (int32_t)snr * 16 - limitQ4;
+    if (snr >= TPC_SNR_SATURATION_DB) {
+        int32_t sensitivityQ4 = (-117 + 3 * LORA_BANDWIDTH) * 16 + limitQ4;
+        int32_t rssiMarginQ4 = (int32_t)rssi * 16 - sensitivityQ4;
+        if (rssiMarginQ4 > marginQ4) {
+            marginQ4 = rssiMarginQ4;
+        }
+    }
+    int32_t margin = marginQ4 / 16;
+    return (int8_t)(margin > 127 ? 127 : (margin < -127 ? -127 : margin));
+}
+/* DATA dirigido a este nodo: se guarda el margen para el ACK */
+inline void tpcNoteDataReceived(uint16_t sender, int16_t rssi, int8_t snr, uint8_t spreadingFactor) {
+    int i = findNeighbor(sender);
+    if (i < 0) {
+        return;
+    }
+    neighborTable[i].rxMarginDb = tpcLinkMarginDb(rssi, snr, spreadingFactor);
+    neighborTable[i].rxMarginValid = true;
+}
+/* El informe viaja en todo ACK hacia un vecino del que hay medida */
+inline void tpcFillAckReport(AckPacket &ack) {
+    int i = findNeighbor(ack.destinationNode);
+    if (i < 0 || !neighborTable[i].rxMarginValid) {
+        return;
+    }
+    ack.hasReport = true;
+    ack.reportMarginDb = neighborTable[i].rxMarginDb;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Emisor: ajuste por informe y por pérdidas                                 */
+/*----------------------------------------------------------------------------*/
+inline void tpcProcessReport(uint16_t neighborId, int8_t marginDb) {
+    int i = findNeighbor(neighborId);
+    if (i < 0) {
+        return;
+    }
+    tpcReports++;
+    if (!tpcEnabled) {
+        return;
+    }
+    NeighborInfo &n = neighborTable[i];
+    int excess = marginDb - TPC_TARGET_MARGIN_DB;
+    if (excess < 0) {
+        tpcSetPower(n, n.txPowerDbm - excess, "margen bajo");
+    } else if (excess > TPC_HYSTERESIS_DB) {
+        int step = excess - TPC_HYSTERESIS_DB;
+        tpcSetPower(n, n.txPowerDbm - (step < TPC_STEP_DOWN_DB ? step : TPC_STEP_DOWN_DB), "margen sobrante");
+    }
+}
+/* Resultado de ACK del vecino (desde linkNoteAck) */
+inline void tpcNoteAck(int idx, bool delivered) {
+    if (!tpcEnabled || delivered) {
+        return;
+    }
+    NeighborInfo &n = neighborTable[idx];
+    tpcSetPower(n, n.txPowerDbm + TPC_STEP_UP_LOSS_DB, "ACK perdido");
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Aplicación trama a trama                                                  */
+/*----------------------------------------------------------------------------*/
+/* destination = vecino de la trama unicast (0 ⇒ difusión) */
+inline void tpcApply(uint16_t destination) {
+    int8_t power = TX_OUTPUT_POWER;
+    if (tpcEnabled && destination != 0) {
+        int i = findNeighbor(destination);
+        if (i >= 0) {
+            power = neighborTable[i].txPowerDbm;
+        }
+    }
+    loraAntena.setTxPower(power);
+}
+/* Histograma de tramas por potencia (desde sendFrame) */
+inline void tpcNoteTx(int8_t powerDbm) {
+    int level = powerDbm - TPC_MIN_DBM;
+    if (level >= 0 && level < TPC_LEVELS) {
+        tpcFramesByPower[level]++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printPowerStats() {
+    Serial.println("=== Control de potencia ===");
+    Serial.printf("  Estado: %s, objetivo: %d dB (+%d), rango: %d..%d dBm\n", tpcEnabled ? "activo" : "inactivo",
+                  TPC_TARGET_MARGIN_DB, TPC_HYSTERESIS_DB, TPC_MIN_DBM, TX_OUTPUT_POWER);
+    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+        const NeighborInfo &n = neighborTable[i];
+        if (n.neighborId != 0) {
+            Serial.printf("  Vecino %u: %d dBm", n.neighborId, n.txPowerDbm);
+            if (n.rxMarginValid) {
+                Serial.printf(", margen con que le oímos %d dB", n.rxMarginDb);
+            }
+            Serial.println();
+        }
+    }
+    Serial.println("  Tramas por potencia:");
+    for (int level = 0; level < TPC_LEVELS; level++) {
+        if (tpcFramesByPower[level] != 0) {
+            Serial.printf("    %3d dBm: %lu\n", level + TPC_MIN_DBM, (unsigned long)tpcFramesByPower[level]);
+        }
+    }
+    Serial.printf("  Informes recibidos: %lu, cambios de potencia: %lu\n",
+                  (unsigned long)tpcReports, (unsigned long)tpcChanges);
+    Serial.println("===========================");
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*==============================================================================
+  rate_manager.h
+  ------------------------------------------------------------------------------
+  Velocidad de datos por enlace (SF adaptativo para DATA unicast) y cita
+  RDV que también lleva el canal de datos (channel_manager.h).
+  – HELLO, ACK, ALT y RDV van siempre al SF de control (LORA_SPREADING_FACTOR);
+    así todos los nodos se oyen y el ACK vuelve por el canal común.
+  – Para cada vecino se elige el SF de DATA que minimiza el tiempo en el
+    aire esperado por trama entregada: ToA(SF) / entrega(SF), con la entrega
+    estimada por el margen de SNR sobre el límite de ese SF. Si hace falta
+    RDV (SF distinto del de control o multicanal activo) se suma su coste,
+    de modo que sólo se usa otro SF cuando compensa. Cambiar exige una
+    mejora de RATE_SWITCH_GAIN_PCT.
+  – RATE_FAIL_STREAK ACK perdidos seguidos suben un SF y bloquean la bajada
+    durante RATE_HOLD_MS.
+  – Cita (RDV): el emisor envía un RDV al SF y canal de control con el SF y
+    el canal del DATA; el receptor pasa a ellos durante una ventana acotada
+    y vuelve a los de control al recibir una trama o al vencer la ventana.
+    Tras RATE_TURNAROUND_MS el emisor envía el DATA (sin nueva evaluación
+    LBT: el canal quedó reservado por el RDV) y vuelve a los de control.
+  – El DATA con candidatos oportunistas va siempre al SF y canal de control.
+==============================================================================*/
+#ifndef RATE_MANAGER_H
+#define RATE_MANAGER_H
+
+#include "config.h"
+#include "lora_manager.h"
+#include "packet_manager.h"
+#include "routing_manager.h"
+#include "airtime_manager.h"
+#include "communication_manager.h"
+#include "channel_manager.h"
+#include <string.h>  // memcpy()
+
+/*----------------------------------------------------------------------------*/
+/*  Estado                                                                    */
+/*----------------------------------------------------------------------------*/
+/* Emisor: DATA ya codificado a la espera de que termine su RDV */
+struct RateDeferred {
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint16_t size;            // 0 ⇒ nada pendiente
+    uint8_t spreadingFactor;
+    uint8_t channel;
+    unsigned long sendAt;     // 0 ⇒ el RDV aún está en el aire
+};
+static bool rateEnabled = RATE_ADAPT_ENABLED;
+static RateDeferred rateDeferred;
+static bool rateRestorePending = false; // volver al SF y canal de control tras el DATA
+/* Receptor: ventana de escucha a otro SF / canal */
+static bool rateRxActive = false;
+static unsigned long rateRxUntil = 0;
+static uint32_t rateRdvSent = 0;
+static uint32_t rateRdvReceived = 0;
+static uint32_t rateRxTimeouts = 0;
+static uint32_t rateSfChanges = 0;
+
+/*----------------------------------------------------------------------------*/
+/*  Selección de SF por vecino                                                */
+/*----------------------------------------------------------------------------*/
+inline bool rateNeedsRdv(uint8_t spreadingFactor) {
+    return spreadingFactor != LORA_SPREADING_FACTOR || channelHopping;
+}
+/* µs de aire esperados por trama entregada al SF dado (incluye el RDV) */
+inline uint32_t rateExpectedCostUs(const NeighborInfo &n, uint8_t spreadingFactor, uint16_t frameSize) {
+    uint32_t toaUs = getTimeOnAirUsAt(spreadingFactor, frameSize);
+    if (rateNeedsRdv(spreadingFactor)) {
+        toaUs += getTimeOnAirUs(WIRE_RDV_MAX_SIZE);
+    }
+    return (uint32_t)(((uint64_t)toaUs * 256) / linkSnrDeliveryAtQ8(n, spreadingFactor));
+}
+/* SF que conviene al vecino ahora (sin efectos: sirve también para estimar) */
+inline uint8_t rateBestSf(const NeighborInfo &n, uint16_t frameSize) {
+    uint32_t currentCost = rateExpectedCostUs(n, n.dataSf, frameSize);
+    uint32_t bestCost = currentCost;
+    uint8_t best = n.dataSf;
+    /* tras subir por pérdidas no se baja hasta que pase RATE_HOLD_MS */
+    uint8_t lowest = (long)(millis() - n.sfHoldUntil) < 0 ? n.dataSf : RATE_SF_MIN;
+    for (uint8_t sf = lowest; sf <= RATE_SF_MAX; sf++) {
+        uint32_t cost = rateExpectedCostUs(n, sf, frameSize);
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = sf;
+        }
+    }
+    if (best != n.dataSf && (uint64_t)bestCost * 100 < (uint64_t)currentCost * (100 - RATE_SWITCH_GAIN_PCT)) {
+        return best;
+    }
+    return n.dataSf;
+}
+/* Vecino cuyo SF de DATA se adapta (-1 ⇒ va al SF de control) */
+inline int rateNeighborFor(const DataHeader &h) {
+    if (!rateEnabled || h.candidateCount > 0) {
+        return -1;
+    }
+    return findNeighbor(h.nextHop);
+}
+/* SF al que saldrá el DATA (el de control si no procede adaptar) */
+inline uint8_t rateSfFor(const DataHeader &h, uint16_t frameSize) {
+    int idx = rateNeighborFor(h);
+    return idx < 0 ? LORA_SPREADING_FACTOR : rateBestSf(neighborTable[idx], frameSize);
+}
+/* Fija el SF del vecino al enviar: el cambio se registra una sola vez */
+inline uint8_t rateCommitSf(const DataHeader &h, uint16_t frameSize) {
+    int idx = rateNeighborFor(h);
+    if (idx < 0) {
+        return LORA_SPREADING_FACTOR;
+    }
+    NeighborInfo &n = neighborTable[idx];
+    uint8_t best = rateBestSf(n, frameSize);
+    if (best != n.dataSf) {
+        Serial.printf("SF por enlace => vecino %u: SF%u -> SF%u\n", n.neighborId, n.dataSf, best);
+        n.dataSf = best;
+        n.sfFailStreak = 0;
+        rateSfChanges++;
+    }
+    return n.dataSf;
+}
+/* Resultado de ACK del vecino (desde linkNoteAck) */
+inline void rateNoteAck(int idx, bool delivered) {
+    NeighborInfo &n = neighborTable[idx];
+    if (delivered) {
+        n.sfFailStreak = 0;
+        return;
+    }
+    if (!rateEnabled || ++n.sfFailStreak < RATE_FAIL_STREAK) {
+        return;
+    }
+    n.sfFailStreak = 0;
+    if (n.dataSf < RATE_SF_MAX) {
+        n.dataSf++;
+        n.sfHoldUntil = millis() + RATE_HOLD_MS;
+        rateSfChanges++;
+        Serial.printf("SF por enlace => vecino %u: pérdidas, sube a SF%u\n", n.neighborId, n.dataSf);
+    }
+}
+/* Tiempo en el aire de un DATA ya codificado, con su RDV si lo lleva (estimación) */
+inline uint32_t rateDataToaUs(const DataHeader &h, uint16_t frameSize) {
+    uint8_t sf = rateSfFor(h, frameSize);
+    uint32_t toaUs = getTimeOnAirUsAt(sf, frameSize);
+    if (sf != LORA_SPREADING_FACTOR || channelFor(h) != CHANNEL_CONTROL) {
+        toaUs += getTimeOnAirUs(WIRE_RDV_MAX_SIZE);
+    }
+    return toaUs;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Emisor                                                                    */
+/*----------------------------------------------------------------------------*/
+/* El DATA ya está codificado en txFrame; sale directo o tras su RDV */
+inline void rateSendData(const DataHeader &h, uint16_t frameSize) {
+    uint8_t sf = rateCommitSf(h, frameSize);
+    uint8_t channel = channelFor(h);
+    if ((sf == LORA_SPREADING_FACTOR && channel == CHANNEL_CONTROL) || frameSize == 0) {
+        sendFrame(frameSize);
+        return;
+    }
+    memcpy(rateDeferred.frame, txFrame, frameSize);
+    rateDeferred.size = frameSize;
+    rateDeferred.spreadingFactor = sf;
+    rateDeferred.channel = channel;
+    rateDeferred.sendAt = 0;
+    RdvPacket rdv;
+    fillRdvPacket(rdv, h.messageID, h.nextHop, sf, channel);
+    sendFrame(serializePacket(rdv, txFrame, sizeof(txFrame)));
+    rateRdvSent++;
+    Serial.printf("RDV enviado => nextHop=%u, DATA a SF%u canal %u\n", h.nextHop, sf, channel);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Receptor                                                                  */
+/*----------------------------------------------------------------------------*/
+/* Vuelta al SF y canal de control */
+inline void rateRestoreControl() {
+    loraAntena.setSpreadingFactor(LORA_SPREADING_FACTOR);
+    loraAntena.setChannel(RF_FREQUENCY);
+}
+inline void rateRxEnd() {
+    rateRxActive = false;
+    rateRestoreControl();
+}
+/* RDV dirigido a este nodo: se escucha al SF y canal indicados durante la ventana */
+inline void rateProcessRdv(const RdvPacket &rdv) {
+    uint8_t sf = rdv.spreadingFactor;
+    uint8_t channel = rdv.channel;
+    bool validChannel = channel == CHANNEL_CONTROL || channel < CHANNEL_DATA_COUNT;
+    if (sf < RATE_SF_MIN || sf > RATE_SF_MAX || !validChannel || rateDeferred.size > 0 ||
+        (sf == LORA_SPREADING_FACTOR && channel == CHANNEL_CONTROL)) {
+        return;
+    }
+    unsigned long windowMs = RATE_TURNAROUND_MS + getTimeOnAirUsAt(sf, WIRE_DATA_MAX_SIZE) / 1000 + RATE_RX_GUARD_MS;
+    loraAntena.setSpreadingFactor(sf);
+    loraAntena.setChannel(channelFrequency(channel));
+    rateRxActive = true;
+    rateRxUntil = millis() + windowMs;
+    rateRdvReceived++;
+    Serial.printf("RDV recibido de %u => escucha a SF%u canal %u durante %lu ms\n", rdv.originNode, sf, channel, windowMs);
+}
+/* Cualquier trama recibida cierra la ventana (el DATA ya llegó) */
+inline void rateNoteFrameReceived() {
+    if (rateRxActive) {
+        rateRxEnd();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Mantenimiento (desde el planificador, con el radio libre)                 */
+/*----------------------------------------------------------------------------*/
+/*  Devuelve true mientras el radio esté reservado para una cita: el         */
+/*  planificador no debe enviar otra trama.                                   */
+inline bool rateService() {
+    unsigned long now = millis();
+    if (rateRestorePending) {
+        rateRestoreControl();
+        rateRestorePending = false;
+    }
+    if (rateDeferred.size > 0) {
+        if (rateDeferred.sendAt == 0) {
+            rateDeferred.sendAt = now + RATE_TURNAROUND_MS; // RDV terminado
+            return true;
+        }
+        if ((long)(now - rateDeferred.sendAt) < 0) {
+            return true;
+        }
+        loraAntena.setPreambleLength(LORA_PREAMBLE_LENGTH); // el RDV ya despertó al receptor
+        loraAntena.setSpreadingFactor(rateDeferred.spreadingFactor);
+        loraAntena.setChannel(channelFrequency(rateDeferred.channel));
+        channelNoteData(rateDeferred.channel);
+        memcpy(txFrame, rateDeferred.frame, rateDeferred.size);
+        sendFrame(rateDeferred.size);
+        rateDeferred.size = 0;
+        rateRestorePending = true;
+        return true;
+    }
+    if (rateRxActive) {
+        if ((long)(now - rateRxUntil) < 0) {
+            return true;
+        }
+        rateRxTimeouts++;
+        Serial.println("RDV => ventana vencida sin DATA, vuelta al SF y canal de control");
+        rateRxEnd();
+    }
+    return false;
+}
+
+/* ms hasta que rateService() tenga algo que hacer (-1 ⇒ ninguna cita) */
+inline long rateNextDueMs(unsigned long now) {
+    if (rateRestorePending || (rateDeferred.size > 0 && rateDeferred.sendAt == 0)) {
+        return 0;
+    }
+    unsigned long due;
+    if (rateDeferred.size > 0) {
+        due = rateDeferred.sendAt;
+    } else if (rateRxActive) {
+        due = rateRxUntil;
+    } else {
+        return -1;
+    }
+    return (long)(due - now) > 0 ? (long)(due - now) : 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Consola                                                                   */
+/*----------------------------------------------------------------------------*/
+inline void printRateTable() {
+    Serial.println("=== SF por enlace ===");
+    Serial.printf("  Estado: %s, SF de control: %u, rango DATA: SF%u-SF%u\n",
+                  rateEnabled ? "activo" : "inactivo", LORA_SPREADING_FACTOR, RATE_SF_MIN, RATE_SF_MAX);
+    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+        const NeighborInfo &n = neighborTable[i];
+        if (n.neighborId != 0) {
+            Serial.printf("  Vecino %u: SNR %.1f, SF%u (coste %lu us)%s\n", n.neighborId, n.snrQ4 / 16.0, n.dataSf,
+                          (unsigned long)rateExpectedCostUs(n, n.dataSf, WIRE_DATA_HEADER_MAX),
+                          (long)(millis() - n.sfHoldUntil) < 0 ? " [retenido]" : "");
+        }
+    }
+    Serial.printf("  RDV enviados: %lu, recibidos: %lu, ventanas vencidas: %lu, cambios de SF: %lu\n",
+                  (unsigned long)rateRdvSent, (unsigned long)rateRdvReceived,
+                  (unsigned long)rateRxTimeouts, (unsigned long)rateSfChanges);
+    Serial.println("=====================");
+}
+
+#endif
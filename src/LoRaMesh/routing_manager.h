@@ -2,9 +2,16 @@
   routing_manager.h
   ------------------------------------------------------------------------------
   Mantenimiento de tabla de vecinos y selección de nextHop:
-  – Guarda RSSI y marca temporal por cada vecino que responde HELLO.
+  – Almacén de vecinos con búsqueda por hash, expulsión LRU / por calidad
+    y ranking de candidatos mantenido de forma incremental.
   – Elimina vecinos inactivos.
-  – Selecciona nextHop con métrica compuesta RSSI + antigüedad.
+  – Temporizador Trickle que decide cuándo emitir HELLO.
+  – Tabla de rutas por vector de distancias (DSDV) anunciada en HELLO.
+  – Estimador de calidad de enlace (ETX) a partir de SNR y de los ACK.
+  – Estima el RTT hasta el ACK por vecino (timeout de ACK adaptativo).
+  – Selecciona nextHop por ETX entre los mejores candidatos.
+  – Caché de nextHop por destino invalidada sólo por eventos.
+  – En modo recolección delega el tráfico al sumidero en collection_manager.
 ==============================================================================*/
 #ifndef ROUTING_MANAGER_H
 #define ROUTING_MANAGER_H
@@ -12,6 +19,34 @@
 #include "config.h"
 #include "packet_manager.h"
 
+/*----------------------------------------------------------------------------*/
+/*  Declaraciones adelantadas (tabla de rutas y estimador, más abajo)         */
+/*----------------------------------------------------------------------------*/
+void routeInvalidateVia(uint16_t neighborId);
+void routeSweep(int steps);
+void linkNoteAck(uint16_t neighborId, bool delivered);
+bool collectHandlesDestination(uint16_t destID); // collection_manager.h
+uint16_t collectNextHop(uint16_t excludeID);     // collection_manager.h
+void collectNeighborLost(uint16_t neighborId);   // collection_manager.h
+void rateNoteAck(int idx, bool delivered);       // rate_manager.h
+void tpcNoteAck(int idx, bool delivered);        // power_manager.h
+
+/*----------------------------------------------------------------------------*/
+/*  Caché de rutas: época de validez                                          */
+/*----------------------------------------------------------------------------*/
+/*  Las entradas de la caché (más abajo, junto a getNextHop) sólo valen en la */
+/*  época en que se calcularon. Cualquier evento que pueda cambiar la         */
+/*  elección (alta/baja de vecino, cambio de ETX por encima del umbral,       */
+/*  cambio en la tabla de rutas o ALT recibido) avanza la época y las         */
+/*  invalida todas en O(1).                                                   */
+/*----------------------------------------------------------------------------*/
+static uint32_t routeCacheEpoch = 1;
+static uint32_t routeCacheInvalidations = 0;
+
+inline void routeCacheInvalidate() {
+    routeCacheEpoch++;
+    routeCacheInvalidations++;
+}
 
 /*----------------------------------------------------------------------------*/
 /*  Tabla de vecinos                                                          */
@@ -20,8 +55,178 @@ struct NeighborInfo {
   uint16_t neighborId;
   int16_t  rssi;
   unsigned long lastHeard; 
+  uint32_t srttMs;    // RTT suavizado hasta el ACK (0 ⇒ sin muestras)
+  uint32_t rttVarMs;  // variación media del RTT
+  uint8_t  lossStreak; // ACK perdidos seguidos (back-off del RTO)
+  int16_t  rssiQ4;     // RSSI suavizado (dBm · 16)
+  int16_t  snrQ4;      // SNR suavizado (dB · 16)
+  uint16_t prrQ8;      // tasa de entrega medida con ACK (0..256)
+  uint8_t  ackSamples; // resultados de ACK acumulados (satura)
+  uint16_t etxQ8;      // ETX en caché (clave del ranking de candidatos)
+  uint16_t etxRefQ8;   // ETX al invalidar la caché de rutas por última vez
+  bool     allowed;    // pasa ALLOWED_NEIGHBORS (sólo estos entran al ranking)
+  uint16_t gradientSink;   // sumidero anunciado por el vecino
+  uint16_t gradientRank;   // rango anunciado hacia el sumidero (COLLECT_RANK_INFINITY ⇒ ninguno)
+  uint16_t gradientParent; // padre anunciado por el vecino
+  uint8_t  dataSf;         // SF elegido para DATA unicast hacia el vecino
+  uint8_t  sfFailStreak;   // ACK perdidos seguidos a ese SF
+  unsigned long sfHoldUntil; // hasta entonces no se baja de SF (tras pérdidas)
+  int8_t   txPowerDbm;     // potencia de las tramas unicast hacia el vecino
+  int8_t   rxMarginDb;     // margen del último DATA suyo (se le informa en el ACK)
+  bool     rxMarginValid;
+  uint16_t lplIntervalMs;  // periodo de muestreo anunciado (0 ⇒ siempre a la escucha)
 };
 static NeighborInfo neighborTable[MAX_NEIGHBORS];
+static int neighborCount = 0;
+
+/* Media móvil de la señal de cada trama oída del vecino */
+inline void linkObserve(NeighborInfo &n, int16_t rssi, int8_t snr) {
+    n.rssiQ4 += (int16_t)(((int32_t)rssi * 16 - n.rssiQ4) / (1 << LINK_SIGNAL_EWMA_SHIFT));
+    n.snrQ4 += (int16_t)(((int32_t)snr * 16 - n.snrQ4) / (1 << LINK_SIGNAL_EWMA_SHIFT));
+}
+inline void linkInit(NeighborInfo &n, int16_t rssi, int8_t snr) {
+    n.rssiQ4 = rssi * 16;
+    n.snrQ4 = snr * 16;
+    n.prrQ8 = 256;
+    n.ackSamples = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Estimador de enlace (ETX)                                                 */
+/*----------------------------------------------------------------------------*/
+/*  – Señal: EWMA de RSSI/SNR de todas las tramas oídas del vecino (DATA,     */
+/*    ACK, HELLO y ALT), no sólo de los HELLO.                                */
+/*  – Entrega: EWMA de los resultados de ACK (éxito / timeout) de las tramas  */
+/*    DATA enviadas a ese vecino; mide ida y vuelta, como ETX = 1/(df·dr).    */
+/*  – Mientras hay pocos resultados se mezcla con una entrega estimada por    */
+/*    el margen de SNR sobre el límite de demodulación del SF.                */
+/*  – ETX = 1/entrega en Q8 (256 ⇒ enlace perfecto), tope LINK_ETX_MAX.       */
+/*----------------------------------------------------------------------------*/
+#define LINK_PRR_MIN_Q8 (256 / LINK_ETX_MAX)
+
+/* Entrega estimada sólo con la SNR a un SF dado (límite ≈ 10 − 2,5·SF dB) */
+inline uint16_t linkSnrDeliveryAtQ8(const NeighborInfo &n, uint8_t spreadingFactor) {
+    int32_t limitQ4 = 160 - 40 * spreadingFactor;
+    int32_t marginQ4 = n.snrQ4 - limitQ4;
+    int32_t prr = LINK_PRR_MIN_Q8 + marginQ4 * (256 - LINK_PRR_MIN_Q8) / (LINK_SNR_MARGIN_FULL_DB * 16);
+    if (prr < LINK_PRR_MIN_Q8) {
+        prr = LINK_PRR_MIN_Q8;
+    }
+    if (prr > 256) {
+        prr = 256;
+    }
+    return (uint16_t)prr;
+}
+inline uint16_t linkSnrDeliveryQ8(const NeighborInfo &n) {
+    return linkSnrDeliveryAtQ8(n, LORA_SPREADING_FACTOR);
+}
+inline uint16_t linkDeliveryQ8(const NeighborInfo &n) {
+    uint32_t prr = n.prrQ8;
+    if (n.ackSamples < LINK_PRR_PRIOR_SAMPLES) {
+        uint32_t k = n.ackSamples;
+        prr = (linkSnrDeliveryQ8(n) * (LINK_PRR_PRIOR_SAMPLES - k) + prr * k) / LINK_PRR_PRIOR_SAMPLES;
+    }
+    return prr < LINK_PRR_MIN_Q8 ? LINK_PRR_MIN_Q8 : (uint16_t)prr;
+}
+inline uint16_t linkEtxQ8(const NeighborInfo &n) {
+    return (uint16_t)(65536UL / linkDeliveryQ8(n));
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Temporizador Trickle para HELLO (RFC 6206)                                */
+/*----------------------------------------------------------------------------*/
+/*  – Intervalo I en [TRICKLE_IMIN_MS, TRICKLE_IMAX_MS]; se duplica al final */
+/*    de cada intervalo sin cambios.                                         */
+/*  – En un instante t aleatorio de [I/2, I) se emite HELLO salvo que ya se  */
+/*    hayan oído TRICKLE_K HELLO coherentes (vecinos conocidos) en este I.   */
+/*  – Un vecino nuevo, perdido o un fallo de ruta devuelve I a TRICKLE_IMIN. */
+/*  – Nunca pasan más de NEIGHBOR_EXPIRATION_TIME/2 sin HELLO propio, para   */
+/*    que los vecinos no nos den por caídos.                                 */
+/*----------------------------------------------------------------------------*/
+struct TrickleTimer {
+    unsigned long interval;
+    unsigned long intervalStart;
+    unsigned long fireOffset;  // t dentro del intervalo
+    uint8_t heard;             // HELLO coherentes oídos en el intervalo (c)
+    bool fired;
+};
+static TrickleTimer helloTrickle;
+static unsigned long lastOwnHello = 0;
+static uint32_t hellosSuppressed = 0;
+
+inline void trickleStartInterval(unsigned long now) {
+    helloTrickle.intervalStart = now;
+    helloTrickle.fireOffset = helloTrickle.interval / 2 + random(0, helloTrickle.interval / 2);
+    helloTrickle.heard = 0;
+    helloTrickle.fired = false;
+}
+inline void initTrickle() {
+    helloTrickle.interval = TRICKLE_IMIN_MS;
+    trickleStartInterval(millis());
+    lastOwnHello = millis();
+    hellosSuppressed = 0;
+}
+/* Evento incoherente: topología cambiada */
+inline void trickleReset(const char *reason) {
+    if (helloTrickle.interval > TRICKLE_IMIN_MS) {
+        Serial.printf("Trickle => reinicio a %u ms (%s)\n", (unsigned)TRICKLE_IMIN_MS, reason);
+        helloTrickle.interval = TRICKLE_IMIN_MS;
+        trickleStartInterval(millis());
+    }
+}
+/* Evento coherente: HELLO de un vecino ya conocido */
+inline void trickleHeard() {
+    if (helloTrickle.heard < 0xFF) {
+        helloTrickle.heard++;
+    }
+}
+inline void trickleNoteSent() {
+    lastOwnHello = millis();
+}
+/* HELLO no encolado (cola llena): el mínimo de vigencia se reintenta en
+   TRICKLE_IMIN_MS en vez de en cada pasada del bucle */
+inline void trickleNoteBlocked() {
+    unsigned long now = millis();
+    if ((now - lastOwnHello) > NEIGHBOR_EXPIRATION_TIME / 2 - TRICKLE_IMIN_MS) {
+        lastOwnHello = now + TRICKLE_IMIN_MS - NEIGHBOR_EXPIRATION_TIME / 2;
+    }
+}
+/* true si toca emitir HELLO ahora; avanza el temporizador */
+inline bool trickleShouldSend() {
+    unsigned long now = millis();
+    /* vigencia mínima ante los vecinos; el intervalo avanza igualmente */
+    bool send = (now - lastOwnHello) >= NEIGHBOR_EXPIRATION_TIME / 2;
+    if (!helloTrickle.fired && (now - helloTrickle.intervalStart) >= helloTrickle.fireOffset) {
+        helloTrickle.fired = true;
+        if (helloTrickle.heard < TRICKLE_K) {
+            send = true;
+        } else {
+            hellosSuppressed++;
+        }
+    }
+    if ((now - helloTrickle.intervalStart) >= helloTrickle.interval) {
+        helloTrickle.interval *= 2;
+        if (helloTrickle.interval > TRICKLE_IMAX_MS) {
+            helloTrickle.interval = TRICKLE_IMAX_MS;
+        }
+        trickleStartInterval(now);
+    }
+    return send;
+}
+
+/* ms hasta que trickleShouldSend() tenga algo que hacer (bucle por eventos) */
+inline unsigned long trickleNextDueMs(unsigned long now) {
+    unsigned long due = lastOwnHello + NEIGHBOR_EXPIRATION_TIME / 2;
+    unsigned long intervalEnd = helloTrickle.intervalStart + helloTrickle.interval;
+    if ((long)(intervalEnd - due) < 0) {
+        due = intervalEnd;
+    }
+    unsigned long fireAt = helloTrickle.intervalStart + helloTrickle.fireOffset;
+    if (!helloTrickle.fired && (long)(fireAt - due) < 0) {
+        due = fireAt;
+    }
+    return (long)(due - now) > 0 ? due - now : 0;
+}
 
 /*----------------------------------------------------------------------------*/
 /*  Lista blanca opcional (ALLOWED_NEIGHBORS)                                 */
@@ -39,53 +244,636 @@ inline bool isAllowedNeighbor(uint16_t nodeID) {
     return false;
 }
 /*----------------------------------------------------------------------------*/
-/*  Operaciones sobre la tabla                                                */
+/*  Almacén de vecinos                                                        */
 /*----------------------------------------------------------------------------*/
-inline void addOrUpdateNeighbor(uint16_t neighborId, int16_t rssi) {
-    // Buscar existente
+/*  – neighborTable es un pool de MAX_NEIGHBORS entradas (neighborId 0 ⇒     */
+/*    libre); neighborHash lo indexa por ID con direccionamiento abierto.    */
+/*  – neighborRank mantiene los vecinos permitidos ordenados por ETX. Cada   */
+/*    HELLO, ACK o trama oída recoloca sólo la entrada que cambió, así       */
+/*    getNextHop no ordena nada por paquete.                                 */
+/*  – Con la tabla llena se expulsa el vecino menos reciente si lleva más de */
+/*    NEIGHBOR_STALE_MS callado, luego uno no permitido y, si no, el de peor */
+/*    ETX cuando el recién llegado es mejor.                                 */
+/*----------------------------------------------------------------------------*/
+#define NEIGHBOR_HASH_MASK (NEIGHBOR_HASH_SIZE - 1)
+#define NEIGHBOR_STALE_MS (NEIGHBOR_EXPIRATION_TIME / 2)
+
+static_assert((NEIGHBOR_HASH_SIZE & NEIGHBOR_HASH_MASK) == 0, "NEIGHBOR_HASH_SIZE debe ser potencia de 2");
+static_assert(NEIGHBOR_HASH_SIZE >= 2 * MAX_NEIGHBORS, "NEIGHBOR_HASH_SIZE debe ser al menos 2 × MAX_NEIGHBORS");
+
+static uint16_t neighborHash[NEIGHBOR_HASH_SIZE]; // índice + 1 en neighborTable (0 ⇒ libre)
+static uint16_t neighborRank[MAX_NEIGHBORS];      // índices ordenados por ETX
+static uint16_t neighborRankPos[MAX_NEIGHBORS];   // posición de cada índice en neighborRank
+static int neighborRankCount = 0;
+static int neighborSweepPos = 0;
+
+inline int neighborHashOf(uint16_t neighborId) {
+    return (int)(((uint32_t)neighborId * 2654435761u) >> 16) & NEIGHBOR_HASH_MASK;
+}
+inline int findNeighbor(uint16_t neighborId) {
+    if (neighborId == 0) {
+        return -1;
+    }
+    int h = neighborHashOf(neighborId);
+    for (int n = 0; n < NEIGHBOR_HASH_SIZE; n++) {
+        uint16_t slot = neighborHash[h];
+        if (slot == 0) {
+            return -1;
+        }
+        if (neighborTable[slot - 1].neighborId == neighborId) {
+            return slot - 1;
+        }
+        h = (h + 1) & NEIGHBOR_HASH_MASK;
+    }
+    return -1;
+}
+inline void neighborHashInsert(int idx) {
+    int h = neighborHashOf(neighborTable[idx].neighborId);
+    while (neighborHash[h] != 0) {
+        h = (h + 1) & NEIGHBOR_HASH_MASK;
+    }
+    neighborHash[h] = (uint16_t)(idx + 1);
+}
+/* Borrado con desplazamiento hacia atrás (sin lápidas) */
+inline void neighborHashRemove(int idx) {
+    int h = neighborHashOf(neighborTable[idx].neighborId);
+    while (neighborHash[h] != (uint16_t)(idx + 1)) {
+        h = (h + 1) & NEIGHBOR_HASH_MASK;
+    }
+    neighborHash[h] = 0;
+    int next = (h + 1) & NEIGHBOR_HASH_MASK;
+    while (neighborHash[next] != 0) {
+        int home = neighborHashOf(neighborTable[neighborHash[next] - 1].neighborId);
+        if (((next - home) & NEIGHBOR_HASH_MASK) >= ((next - h) & NEIGHBOR_HASH_MASK)) {
+            neighborHash[h] = neighborHash[next];
+            neighborHash[next] = 0;
+            h = next;
+        }
+        next = (next + 1) & NEIGHBOR_HASH_MASK;
+    }
+}
+
+/*-------------------------------- Ranking por ETX ---------------------------*/
+inline bool neighborRankBefore(int a, int b) {
+    const NeighborInfo &na = neighborTable[a];
+    const NeighborInfo &nb = neighborTable[b];
+    if (na.etxQ8 != nb.etxQ8) {
+        return na.etxQ8 < nb.etxQ8;
+    }
+    return na.neighborId < nb.neighborId; // desempate estable
+}
+inline void neighborRankSwap(int p, int q) {
+    uint16_t a = neighborRank[p];
+    uint16_t b = neighborRank[q];
+    neighborRank[p] = b;
+    neighborRank[q] = a;
+    neighborRankPos[b] = p;
+    neighborRankPos[a] = q;
+}
+/* Recoloca idx tras un cambio de ETX (sólo se desplaza lo necesario) */
+inline void neighborRankFix(int idx) {
+    int p = neighborRankPos[idx];
+    while (p > 0 && neighborRankBefore(neighborRank[p], neighborRank[p - 1])) {
+        neighborRankSwap(p, p - 1);
+        p--;
+    }
+    while (p + 1 < neighborRankCount && neighborRankBefore(neighborRank[p + 1], neighborRank[p])) {
+        neighborRankSwap(p, p + 1);
+        p++;
+    }
+}
+inline void neighborRankInsert(int idx) {
+    neighborRank[neighborRankCount] = idx;
+    neighborRankPos[idx] = neighborRankCount;
+    neighborRankCount++;
+    neighborRankFix(idx);
+}
+inline void neighborRankRemove(int idx) {
+    for (int p = neighborRankPos[idx]; p + 1 < neighborRankCount; p++) {
+        neighborRank[p] = neighborRank[p + 1];
+        neighborRankPos[neighborRank[p]] = p;
+    }
+    neighborRankCount--;
+}
+/* Recalcula el ETX en caché y, si cambió, recoloca el vecino */
+inline void neighborRefresh(int idx) {
+    NeighborInfo &n = neighborTable[idx];
+    uint16_t etx = linkEtxQ8(n);
+    if (etx != n.etxQ8) {
+        n.etxQ8 = etx;
+        if (n.allowed) {
+            neighborRankFix(idx);
+        }
+        uint32_t delta = (etx > n.etxRefQ8) ? (etx - n.etxRefQ8) : (n.etxRefQ8 - etx);
+        if (delta * 100 > (uint32_t)n.etxRefQ8 * ROUTE_CACHE_ETX_DELTA_PCT) {
+            n.etxRefQ8 = etx;
+            routeCacheInvalidate();
+        }
+    }
+}
+
+/*-------------------------------- Altas y bajas -----------------------------*/
+inline void neighborRemoveAt(int idx, const char *reason) {
+    NeighborInfo &n = neighborTable[idx];
+    uint16_t neighborId = n.neighborId;
+    routeInvalidateVia(neighborId);
+    neighborHashRemove(idx);
+    if (n.allowed) {
+        neighborRankRemove(idx);
+    }
+    n.neighborId = 0;
+    n.rssi = 0;
+    n.lastHeard = 0;
+    neighborCount--;
+    routeCacheInvalidate();
+    trickleReset(reason);
+    collectNeighborLost(neighborId);
+}
+/* Ranura a sacrificar para un vecino nuevo de ETX candidateEtx (-1 ⇒ ninguna) */
+inline int neighborEvictionVictim(uint16_t candidateEtx) {
+    unsigned long now = millis();
+    int lru = -1;
+    int lruBlocked = -1;
     for (int i = 0; i < MAX_NEIGHBORS; i++) {
-        if (neighborTable[i].neighborId == neighborId) {
-            neighborTable[i].rssi = rssi;
-            neighborTable[i].lastHeard = millis();
+        const NeighborInfo &n = neighborTable[i];
+        if (n.neighborId == 0) {
+            continue;
+        }
+        if (lru < 0 || (now - n.lastHeard) > (now - neighborTable[lru].lastHeard)) {
+            lru = i;
+        }
+        if (!n.allowed && (lruBlocked < 0 || (now - n.lastHeard) > (now - neighborTable[lruBlocked].lastHeard))) {
+            lruBlocked = i;
+        }
+    }
+    if (lru >= 0 && (now - neighborTable[lru].lastHeard) > NEIGHBOR_STALE_MS) {
+        return lru;
+    }
+    if (lruBlocked >= 0) {
+        return lruBlocked;
+    }
+    if (neighborRankCount > 0) {
+        int worst = neighborRank[neighborRankCount - 1];
+        if (candidateEtx < neighborTable[worst].etxQ8) {
+            return worst;
+        }
+    }
+    return -1;
+}
+inline void addOrUpdateNeighbor(uint16_t neighborId, int16_t rssi, int8_t snr) {
+    // Buscar existente
+    int i = findNeighbor(neighborId);
+    if (i >= 0) {
+        neighborTable[i].rssi = rssi;
+        neighborTable[i].lastHeard = millis();
+        linkObserve(neighborTable[i], rssi, snr);
+        neighborRefresh(i);
+        trickleHeard();
+        return;
+    }
+    NeighborInfo fresh;
+    fresh.neighborId = neighborId;
+    fresh.rssi = rssi;
+    fresh.lastHeard = millis();
+    fresh.srttMs = 0;
+    fresh.rttVarMs = 0;
+    fresh.lossStreak = 0;
+    linkInit(fresh, rssi, snr);
+    fresh.etxQ8 = linkEtxQ8(fresh);
+    fresh.etxRefQ8 = fresh.etxQ8;
+    fresh.allowed = isAllowedNeighbor(neighborId);
+    fresh.gradientSink = 0;
+    fresh.gradientRank = COLLECT_RANK_INFINITY;
+    fresh.gradientParent = 0;
+    fresh.dataSf = LORA_SPREADING_FACTOR;
+    fresh.sfFailStreak = 0;
+    fresh.sfHoldUntil = 0;
+    fresh.txPowerDbm = TX_OUTPUT_POWER;
+    fresh.rxMarginValid = false;
+    fresh.lplIntervalMs = 0;
+    if (neighborCount >= MAX_NEIGHBORS) {
+        int victim = neighborEvictionVictim(fresh.allowed ? fresh.etxQ8 : 0xFFFF);
+        if (victim < 0) {
+            Serial.println("Tabla de vecinos llena => no se pudo agregar.");
             return;
         }
+        Serial.printf("Tabla de vecinos llena => se expulsa %u.\n", neighborTable[victim].neighborId);
+        neighborRemoveAt(victim, "vecino expulsado");
     }
-    for (int i = 0; i < MAX_NEIGHBORS; i++) {
+    for (i = 0; i < MAX_NEIGHBORS; i++) {
         if (neighborTable[i].neighborId == 0) {
-            neighborTable[i].neighborId = neighborId;
-            neighborTable[i].rssi       = rssi;
-            neighborTable[i].lastHeard = millis();
-            return;
+            break;
         }
     }
-    Serial.println("Tabla de vecinos llena => no se pudo agregar.");
+    neighborTable[i] = fresh;
+    neighborCount++;
+    neighborHashInsert(i);
+    if (fresh.allowed) {
+        neighborRankInsert(i);
+    }
+    routeCacheInvalidate();
+    trickleReset("vecino nuevo");
 }
 
+/* Barrido incremental: NEIGHBOR_SWEEP_STEP ranuras por llamada */
 inline void cleanupNeighbors() {
     unsigned long now = millis();
-    for (int i = 0; i < MAX_NEIGHBORS; i++) {
-        if (neighborTable[i].neighborId != 0) {
-            if ((now - neighborTable[i].lastHeard) > NEIGHBOR_EXPIRATION_TIME) {
-                Serial.printf("Eliminando vecino %u por inactividad.\n", neighborTable[i].neighborId);
-                neighborTable[i].neighborId = 0;
-                neighborTable[i].rssi = 0;
-                neighborTable[i].lastHeard = 0;
-            }
+    for (int n = 0; n < NEIGHBOR_SWEEP_STEP; n++) {
+        NeighborInfo &info = neighborTable[neighborSweepPos];
+        if (info.neighborId != 0 && (now - info.lastHeard) > NEIGHBOR_EXPIRATION_TIME) {
+            Serial.printf("Eliminando vecino %u por inactividad.\n", info.neighborId);
+            neighborRemoveAt(neighborSweepPos, "vecino expirado");
         }
+        neighborSweepPos = (neighborSweepPos + 1) % MAX_NEIGHBORS;
     }
+    routeSweep(ROUTE_SWEEP_STEP);
 }
 
 
 inline void removeNeighbor(uint16_t neighborId) {
-    for (int i = 0; i < MAX_NEIGHBORS; i++) {
-        if (neighborTable[i].neighborId == neighborId) {
-            Serial.printf("Eliminando vecino %u (por ACK no recibido o similar).\n", neighborId);
-            neighborTable[i].neighborId = 0;
-            neighborTable[i].rssi = 0;
-            neighborTable[i].lastHeard = 0;
-            return;
+    int i = findNeighbor(neighborId);
+    if (i >= 0) {
+        Serial.printf("Eliminando vecino %u (por ACK no recibido o similar).\n", neighborId);
+        neighborRemoveAt(i, "vecino eliminado");
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  RTT por vecino y timeout de ACK adaptativo (Jacobson/Karels)              */
+/*----------------------------------------------------------------------------*/
+/*  – Muestra = envío DATA → ACK del vecino (sólo envíos sin reintento,       */
+/*    regla de Karn). El receptor retiene el ACK sólo ACK_JITTER_*, así que   */
+/*    la muestra refleja el enlace y no la espera de la cola.                 */
+/*  – RTO = SRTT + max(G, 4·RTTVAR), limitado a [ACK_TIMEOUT_MIN, _MAX] y     */
+/*    duplicado por cada ACK perdido seguido (hasta RTO_MAX_BACKOFF).         */
+/*----------------------------------------------------------------------------*/
+inline void updateNeighborRtt(uint16_t neighborId, unsigned long rttMs) {
+    int i = findNeighbor(neighborId);
+    if (i < 0) {
+        return;
+    }
+    NeighborInfo &n = neighborTable[i];
+    if (n.srttMs == 0) {
+        n.srttMs = rttMs;
+        n.rttVarMs = rttMs / 2;
+    } else {
+        uint32_t delta = (n.srttMs > rttMs) ? (n.srttMs - rttMs) : (rttMs - n.srttMs);
+        n.rttVarMs = (3 * n.rttVarMs + delta) / 4;
+        n.srttMs = (7 * n.srttMs + rttMs) / 8;
+    }
+    n.lossStreak = 0;
+}
+inline void noteNeighborAckTimeout(uint16_t neighborId) {
+    int i = findNeighbor(neighborId);
+    if (i >= 0 && neighborTable[i].lossStreak < RTO_MAX_BACKOFF) {
+        neighborTable[i].lossStreak++;
+    }
+    linkNoteAck(neighborId, false);
+}
+inline unsigned long getAckTimeout(uint16_t neighborId) {
+    int i = findNeighbor(neighborId);
+    unsigned long rto = ACK_TIMEOUT;
+    uint8_t backoff = 0;
+    if (i >= 0) {
+        const NeighborInfo &n = neighborTable[i];
+        if (n.srttMs != 0) {
+            uint32_t var4 = 4 * n.rttVarMs;
+            rto = n.srttMs + (var4 > RTT_GRANULARITY_MS ? var4 : RTT_GRANULARITY_MS);
+        }
+        backoff = n.lossStreak;
+    }
+    if (rto < ACK_TIMEOUT_MIN) {
+        rto = ACK_TIMEOUT_MIN;
+    }
+    rto <<= backoff;
+    if (rto > ACK_TIMEOUT_MAX) {
+        rto = ACK_TIMEOUT_MAX;
+    }
+    return rto;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Estimador de enlace: actualización                                        */
+/*----------------------------------------------------------------------------*/
+/* Resultado de un envío DATA al vecino: ACK recibido o timeout */
+inline void linkNoteAck(uint16_t neighborId, bool delivered) {
+    int i = findNeighbor(neighborId);
+    if (i < 0) {
+        return;
+    }
+    NeighborInfo &n = neighborTable[i];
+    if (n.ackSamples == 0) {
+        n.prrQ8 = linkSnrDeliveryQ8(n); // parte de la estimación por SNR
+    }
+    int32_t sample = delivered ? 256 : 0;
+    n.prrQ8 = (uint16_t)(n.prrQ8 + (sample - (int32_t)n.prrQ8) / (1 << LINK_PRR_EWMA_SHIFT));
+    if (n.ackSamples < 0xFF) {
+        n.ackSamples++;
+    }
+    rateNoteAck(i, delivered);
+    tpcNoteAck(i, delivered);
+    neighborRefresh(i);
+}
+/* Trama cualquiera oída de un vecino conocido */
+inline void noteNeighborFrame(uint16_t neighborId, int16_t rssi, int8_t snr) {
+    int i = findNeighbor(neighborId);
+    if (i < 0) {
+        return;
+    }
+    neighborTable[i].rssi = rssi;
+    neighborTable[i].lastHeard = millis();
+    linkObserve(neighborTable[i], rssi, snr);
+    neighborRefresh(i);
+}
+/* Coste de enlace para el vector de distancias: ETX · ROUTE_HOP_COST */
+inline uint8_t getLinkCost(uint16_t neighborId) {
+    int i = findNeighbor(neighborId);
+    if (i < 0) {
+        return ROUTE_HOP_COST;
+    }
+    uint32_t cost = ((uint32_t)neighborTable[i].etxQ8 * ROUTE_HOP_COST + 128) / 256;
+    if (cost >= ROUTE_COST_INFINITY) {
+        cost = ROUTE_COST_INFINITY - 1;
+    }
+    return (uint8_t)cost;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Tabla de rutas por vector de distancias (DSDV)                            */
+/*----------------------------------------------------------------------------*/
+/*  – Hash de direccionamiento abierto por destino (borrado sin lápidas).    */
+/*  – Cada destino emite números de secuencia pares; una ruta rota se marca  */
+/*    con coste ROUTE_COST_INFINITY y secuencia impar (+1).                  */
+/*  – Se acepta un anuncio si su secuencia es más nueva, si con la misma     */
+/*    secuencia mejora el coste, o si llega del nextHop actual (así también  */
+/*    se propagan los empeoramientos). Con esto no se forman bucles.         */
+/*----------------------------------------------------------------------------*/
+#define ROUTE_MASK (ROUTE_TABLE_CAPACITY - 1)
+#define ROUTE_LOAD_LIMIT ((ROUTE_TABLE_CAPACITY * 3) / 4)
+
+static_assert((ROUTE_TABLE_CAPACITY & ROUTE_MASK) == 0, "ROUTE_TABLE_CAPACITY debe ser potencia de 2");
+
+struct RouteEntry {
+    uint16_t destination;
+    uint16_t nextHop;
+    uint16_t seq;
+    uint8_t  cost;
+    bool     used;
+    unsigned long updatedAt;
+    uint16_t altHop;   // segundo vecino viable (0 ⇒ ninguno), para reenvío oportunista
+    uint16_t altSeq;   // secuencia con la que se anunció (vale si == seq)
+    uint8_t  altCost;
+};
+static RouteEntry routeTable[ROUTE_TABLE_CAPACITY];
+static int routeCount = 0;
+static int routeSweepPos = 0;
+static int routeAdvertCursor = 0;
+static int routeAdvertNext = 0;   // cursor tras el último vector codificado
+static uint16_t routeOwnSeq = 0;
+
+inline int routeHash(uint16_t destination) {
+    return (int)(((uint32_t)destination * 2654435761u) >> 16) & ROUTE_MASK;
+}
+inline bool routeSeqNewer(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+inline void routeRemoveAt(int idx) {
+    routeTable[idx].used = false;
+    routeCount--;
+    int next = (idx + 1) & ROUTE_MASK;
+    while (routeTable[next].used) {
+        int home = routeHash(routeTable[next].destination);
+        if (((next - home) & ROUTE_MASK) >= ((next - idx) & ROUTE_MASK)) {
+            routeTable[idx] = routeTable[next];
+            routeTable[next].used = false;
+            idx = next;
+        }
+        next = (next + 1) & ROUTE_MASK;
+    }
+}
+inline RouteEntry *routeFind(uint16_t destination) {
+    int idx = routeHash(destination);
+    for (int n = 0; n < ROUTE_TABLE_CAPACITY; n++) {
+        RouteEntry &e = routeTable[idx];
+        if (!e.used) {
+            return nullptr;
+        }
+        if (e.destination == destination) {
+            return &e;
+        }
+        idx = (idx + 1) & ROUTE_MASK;
+    }
+    return nullptr;
+}
+/* Barrido incremental: borra rutas sin refrescar en ROUTE_EXPIRATION_TIME */
+inline void routeSweep(int steps) {
+    unsigned long now = millis();
+    int n = 0;
+    while (n < steps && routeCount > 0) {
+        RouteEntry &e = routeTable[routeSweepPos];
+        if (e.used && (now - e.updatedAt) > ROUTE_EXPIRATION_TIME) {
+            if (e.cost < ROUTE_COST_INFINITY) {
+                routeCacheInvalidate();
+            }
+            routeRemoveAt(routeSweepPos);
+            continue;
+        }
+        routeSweepPos = (routeSweepPos + 1) & ROUTE_MASK;
+        n++;
+    }
+}
+inline RouteEntry *routeInsert(uint16_t destination) {
+    if (routeCount >= ROUTE_LOAD_LIMIT) {
+        routeSweep(ROUTE_TABLE_CAPACITY);
+    }
+    if (routeCount >= ROUTE_LOAD_LIMIT) {
+        /* se sacrifica la ruta más cara (las rotas primero) */
+        int worst = -1;
+        for (int i = 0; i < ROUTE_TABLE_CAPACITY; i++) {
+            if (routeTable[i].used && (worst < 0 || routeTable[i].cost > routeTable[worst].cost)) {
+                worst = i;
+            }
+        }
+        if (worst < 0) {
+            return nullptr;
+        }
+        routeRemoveAt(worst);
+    }
+    int idx = routeHash(destination);
+    while (routeTable[idx].used) {
+        idx = (idx + 1) & ROUTE_MASK;
+    }
+    RouteEntry &e = routeTable[idx];
+    e.destination = destination;
+    e.used = true;
+    routeCount++;
+    return &e;
+}
+/* Alternativa viable: misma secuencia y coste anunciado menor que el nuestro */
+/* (condición de factibilidad), así reenviar por ella no forma bucles.       */
+inline void routeNoteAlternate(RouteEntry &e, uint16_t via, uint8_t cost, uint16_t seq, uint8_t advertised) {
+    if (via == e.nextHop) {
+        return;
+    }
+    bool viable = cost < ROUTE_COST_INFINITY && seq == e.seq && advertised < e.cost;
+    if (!viable) {
+        if (e.altHop == via) {
+            e.altHop = 0;
+        }
+        return;
+    }
+    if (e.altHop == 0 || e.altHop == via || e.altSeq != e.seq || cost < e.altCost) {
+        e.altHop = via;
+        e.altSeq = seq;
+        e.altCost = cost;
+    }
+}
+/* Aplica un anuncio recibido de 'via' (advertised = coste que anuncia él); */
+/* devuelve true si la ruta cambió                                          */
+inline bool routeUpdate(uint16_t destination, uint16_t via, uint8_t cost, uint16_t seq, uint8_t advertised) {
+    if (destination == getNodeID()) {
+        return false;
+    }
+    RouteEntry *e = routeFind(destination);
+    if (e == nullptr) {
+        if (cost >= ROUTE_COST_INFINITY) {
+            return false; // no se aprende una ruta ya rota
+        }
+        e = routeInsert(destination);
+        if (e == nullptr) {
+            return false;
+        }
+        e->nextHop = via;
+        e->cost = cost;
+        e->seq = seq;
+        e->updatedAt = millis();
+        e->altHop = 0;
+        routeCacheInvalidate();
+        trickleReset("ruta nueva");
+        return true;
+    }
+    bool newer = routeSeqNewer(seq, e->seq);
+    bool sameSeq = (seq == e->seq);
+    if (!newer && !(sameSeq && (cost < e->cost || e->nextHop == via))) {
+        routeNoteAlternate(*e, via, cost, seq, advertised);
+        return false;
+    }
+    if (e->altHop == via) {
+        e->altHop = 0; // pasa a ser la principal
+    }
+    bool changed = (e->nextHop != via || e->cost != cost);
+    bool broke = (cost >= ROUTE_COST_INFINITY && e->cost < ROUTE_COST_INFINITY);
+    e->nextHop = via;
+    e->cost = cost;
+    e->seq = seq;
+    e->updatedAt = millis();
+    if (changed) {
+        routeCacheInvalidate();
+    }
+    if (broke) {
+        trickleReset("ruta rota");
+    }
+    return changed;
+}
+/* Vecino perdido: toda ruta que pasaba por él queda rota (seq impar) */
+inline void routeInvalidateVia(uint16_t neighborId) {
+    bool any = false;
+    for (int i = 0; i < ROUTE_TABLE_CAPACITY; i++) {
+        RouteEntry &e = routeTable[i];
+        if (e.used && e.altHop == neighborId) {
+            e.altHop = 0;
         }
+        if (e.used && e.nextHop == neighborId && e.cost < ROUTE_COST_INFINITY) {
+            e.cost = ROUTE_COST_INFINITY;
+            e.seq |= 1;
+            e.updatedAt = millis();
+            any = true;
+        }
+    }
+    if (any) {
+        routeCacheInvalidate();
+        trickleReset("ruta rota");
+    }
+}
+/* Incorpora el vector de un HELLO recibido por un enlace de coste linkCost */
+inline void routeProcessHello(const HelloPacket &hello, uint8_t linkCost) {
+    if (hello.seq != 0) {
+        routeUpdate(hello.originNode, hello.originNode, linkCost, hello.seq, 0);
+    }
+    for (uint8_t i = 0; i < hello.routeCount; i++) {
+        const RouteAdvert &a = hello.routes[i];
+        uint16_t cost = (uint16_t)a.cost + linkCost;
+        if (cost > ROUTE_COST_INFINITY) {
+            cost = ROUTE_COST_INFINITY;
+        }
+        routeUpdate(a.destination, hello.originNode, (uint8_t)cost, a.seq, a.cost);
+    }
+}
+/* Rellena el vector de un HELLO propio (rotando si no caben todas). El     */
+/* HELLO se codifica más de una vez por envío (presupuesto de aire, LBT):   */
+/* secuencia y cursor sólo avanzan al salir, con routeNoteHelloSent().      */
+inline void fillHelloRoutes(HelloPacket &hello) {
+    hello.seq = (uint16_t)(routeOwnSeq + 2);
+    hello.routeCount = 0;
+    int cursor = routeAdvertCursor;
+    for (int n = 0; n < ROUTE_TABLE_CAPACITY && hello.routeCount < ROUTE_ADVERT_MAX; n++) {
+        const RouteEntry &e = routeTable[cursor];
+        cursor = (cursor + 1) & ROUTE_MASK;
+        if (!e.used) {
+            continue;
+        }
+        RouteAdvert &a = hello.routes[hello.routeCount++];
+        a.destination = e.destination;
+        a.cost = e.cost;
+        a.seq = e.seq;
+    }
+    routeAdvertNext = cursor;
+}
+inline void routeNoteHelloSent() {
+    routeOwnSeq += 2;
+    routeAdvertCursor = routeAdvertNext;
+}
+/* Siguiente salto según la tabla (INVALID_NEXT_HOP si no hay ruta válida) */
+inline uint16_t getRouteNextHop(uint16_t destination, uint16_t excludeID) {
+    const RouteEntry *e = routeFind(destination);
+    if (e == nullptr || e->cost >= ROUTE_COST_INFINITY || e->nextHop == excludeID) {
+        return INVALID_NEXT_HOP;
+    }
+    if (findNeighbor(e->nextHop) < 0) {
+        return INVALID_NEXT_HOP;
     }
+    return e->nextHop;
+}
+/* Segundo salto viable hacia el destino (INVALID_NEXT_HOP si no hay) */
+inline uint16_t getRouteAlternate(uint16_t destination, uint16_t excludeA, uint16_t excludeB) {
+    const RouteEntry *e = routeFind(destination);
+    if (e == nullptr || e->cost >= ROUTE_COST_INFINITY || e->altHop == 0 || e->altSeq != e->seq) {
+        return INVALID_NEXT_HOP;
+    }
+    if (e->altHop == excludeA || e->altHop == excludeB || findNeighbor(e->altHop) < 0) {
+        return INVALID_NEXT_HOP;
+    }
+    return e->altHop;
+}
+inline void initRouteTable() {
+    for (int i = 0; i < ROUTE_TABLE_CAPACITY; i++) {
+        routeTable[i].used = false;
+    }
+    routeCount = 0;
+    routeSweepPos = 0;
+    routeAdvertCursor = 0;
+    routeAdvertNext = 0;
+    routeOwnSeq = (uint16_t)(random(0, 32768) * 2);
+}
+inline void printRouteTable() {
+    Serial.println("=== Tabla de Rutas ===");
+    for (int i = 0; i < ROUTE_TABLE_CAPACITY; i++) {
+        const RouteEntry &e = routeTable[i];
+        if (e.used) {
+            Serial.printf("  Destino: %u, nextHop: %u, coste: %u, seq: %u\n", e.destination, e.nextHop, e.cost, e.seq);
+        }
+    }
+    Serial.println("======================");
 }
 
 /*----------------------------------------------------------------------------*/
@@ -95,87 +883,134 @@ inline void printNeighborTable() {
     Serial.println("=== Tabla de Vecinos ===");
     for (int i = 0; i < MAX_NEIGHBORS; i++) {
         if (neighborTable[i].neighborId != 0) {
-            Serial.printf("  Vecino: %u, RSSI: %d, lastHeard: %lu\n",neighborTable[i].neighborId,neighborTable[i].rssi,neighborTable[i].lastHeard);
+            const NeighborInfo &n = neighborTable[i];
+            Serial.printf("  Vecino: %u, RSSI: %d (media %.1f), SNR: %.1f, entrega: %u%% (%u ACK), ETX: %.2f, lastHeard: %lu\n",
+                          n.neighborId, n.rssi, n.rssiQ4 / 16.0, n.snrQ4 / 16.0, (unsigned)(linkDeliveryQ8(n) * 100 / 256),
+                          (unsigned)n.ackSamples, linkEtxQ8(n) / 256.0, n.lastHeard);
         }
     }
+    Serial.printf("  HELLO: intervalo Trickle %lu ms, suprimidos %lu\n",helloTrickle.interval,(unsigned long)hellosSuppressed);
     Serial.println("========================");
 }
 
 /*============================================================================*/
 /*  Métrica y algoritmo de selección de nextHop                               */
 /*============================================================================*/
-inline float getNeighborScore(int16_t rssi, unsigned long lastHeard) {
-    unsigned long now = millis();
-    float secsAgo = (float)(now - lastHeard) / 1000.0;
-    return (float)rssi - secsAgo;
-}
+/*  Se recorre neighborRank (ya ordenado por ETX) y se elige al azar entre  */
+/*  los ROUTING_MAX_CANDIDATES primeros cuyo ETX no supera                  */
+/*  LINK_ETX_SPREAD_PCT del mejor, para repartir carga sin usar enlaces     */
+/*  claramente peores. Los vecinos de bajo consumo (LPL) no hacen de        */
+/*  tránsito: a esa altura el destino ya no es un vecino directo.           */
+/*----------------------------------------------------------------------------*/
 
-inline uint16_t getNextHop(uint16_t localID, uint16_t destID, uint16_t excludeID) {
+/* Parte determinista: destino directo o tabla de rutas (la que se cachea) */
+inline uint16_t computeFixedNextHop(uint16_t destID, uint16_t excludeID) {
     /*-------------------------------- Destino directo ---------------------*/
-    for (int i = 0; i < MAX_NEIGHBORS; i++) {
-        if (neighborTable[i].neighborId == destID) {
-            return destID;
-        }
+    if (findNeighbor(destID) >= 0) {
+        return destID;
     }
-    /*------------------------------- Candidatos ---------------------------*/
-    struct Candidate {
-        uint16_t id;
-        float score;
-    };
-    Candidate allCandidates[MAX_NEIGHBORS];
-    int countAll = 0;
-
-    for (int i = 0; i < MAX_NEIGHBORS; i++) {
-        uint16_t neighborIdCandidate = neighborTable[i].neighborId;
-        if (neighborIdCandidate == 0) {
-            continue; 
-        }
-        if (neighborIdCandidate == localID) {
-            continue; 
+    /*------------------------------- Tabla de rutas -----------------------*/
+    return getRouteNextHop(destID, excludeID);
+}
+inline uint16_t computeNextHop(uint16_t localID, uint16_t destID, uint16_t excludeID) {
+    uint16_t fixed = computeFixedNextHop(destID, excludeID);
+    if (fixed != INVALID_NEXT_HOP) {
+        return fixed;
+    }
+    /*------------------------- Candidatos (ya ordenados) ------------------*/
+    uint16_t candidates[ROUTING_MAX_CANDIDATES];
+    int topCount = 0;
+    uint32_t etxLimit = 0;
+    for (int p = 0; p < neighborRankCount && topCount < ROUTING_MAX_CANDIDATES; p++) {
+        const NeighborInfo &n = neighborTable[neighborRank[p]];
+        if (n.neighborId == localID || n.neighborId == excludeID) {
+            continue;
         }
-        if (neighborIdCandidate == excludeID) {
-            continue; 
+        if (n.lplIntervalMs != 0) {
+            continue; // duerme (LPL): sólo se le envía lo que va dirigido a él
         }
-        if (!isAllowedNeighbor(neighborIdCandidate)) {
-            continue; 
+        if (topCount == 0) {
+            etxLimit = (uint32_t)n.etxQ8 * LINK_ETX_SPREAD_PCT / 100;
+        } else if (n.etxQ8 > etxLimit) {
+            break;
         }
-
-        float sc = getNeighborScore(neighborTable[i].rssi, neighborTable[i].lastHeard);
-        allCandidates[countAll].id = neighborIdCandidate;
-        allCandidates[countAll].score = sc;
-        countAll++;
+        candidates[topCount++] = neighborRank[p];
     }
-    if (countAll == 0) {
-        Serial.println("getNextHop => NO vecinos válidos");
-        return INVALID_NEXT_HOP;
+    if (topCount > 0) {
+        const NeighborInfo &chosen = neighborTable[candidates[random(0, topCount)]];
+        Serial.printf("getNextHop => TopCount=%d, elegido %u con ETX=%.2f\n",topCount, chosen.neighborId, chosen.etxQ8 / 256.0);
+        return chosen.neighborId;
     }
-    /*------------------------------- Ordena por score ---------------------*/
-    for (int outer = 0; outer < (countAll - 1); outer++) {
-        for (int inner = 0; inner < (countAll - 1 - outer); inner++) {
-            if (allCandidates[inner].score < allCandidates[inner + 1].score) {
-                Candidate temp = allCandidates[inner];
-                allCandidates[inner] = allCandidates[inner + 1];
-                allCandidates[inner + 1] = temp;
-            }
-        }
+    Serial.println("getNextHop => NO vecinos válidos");
+    return INVALID_NEXT_HOP;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Caché de nextHop por destino                                              */
+/*----------------------------------------------------------------------------*/
+/*  – Tabla de correspondencia directa por hash del destino; una entrada es  */
+/*    válida sólo si su época coincide con routeCacheEpoch.                  */
+/*  – Sólo se guardan elecciones deterministas (destino directo o tabla de   */
+/*    rutas); el sorteo entre los mejores candidatos se repite en cada       */
+/*    consulta para no perder el reparto de LINK_ETX_SPREAD_PCT.             */
+/*  – Se guarda la elección sin exclusiones; si coincide con el vecino a     */
+/*    excluir (salto previo o vecino fallido) se calcula aparte sin cachear. */
+/*----------------------------------------------------------------------------*/
+#define ROUTE_CACHE_MASK (ROUTE_CACHE_SIZE - 1)
+
+static_assert((ROUTE_CACHE_SIZE & ROUTE_CACHE_MASK) == 0, "ROUTE_CACHE_SIZE debe ser potencia de 2");
+
+struct RouteCacheEntry {
+    uint16_t destination;
+    uint16_t nextHop;
+    uint16_t etxQ8;   // ETX del enlace elegido al calcularla
+    uint32_t epoch;   // 0 ⇒ vacía
+};
+static RouteCacheEntry routeCache[ROUTE_CACHE_SIZE];
+static uint32_t routeCacheHits = 0;
+static uint32_t routeCacheMisses = 0;
+
+inline uint16_t getNextHop(uint16_t localID, uint16_t destID, uint16_t excludeID) {
+    /* Recolección: tráfico hacia el sumidero ⇒ padre (sin caché, ya es O(1)) */
+    if (collectHandlesDestination(destID)) {
+        return collectNextHop(excludeID);
     }
-    int topCount = countAll;
-    if (topCount > ROUTING_MAX_CANDIDATES) {
-        topCount = ROUTING_MAX_CANDIDATES;
+    RouteCacheEntry &e = routeCache[(int)(((uint32_t)destID * 2654435761u) >> 16) & ROUTE_CACHE_MASK];
+    if (e.epoch == routeCacheEpoch && e.destination == destID && e.nextHop != excludeID) {
+        routeCacheHits++;
+        return e.nextHop;
     }
-    if (topCount > 0) {
-        int chosenIndex = random(0, topCount);
-        uint16_t chosenId = allCandidates[chosenIndex].id;
-        float chosenScore = allCandidates[chosenIndex].score;
-        Serial.printf("getNextHop => TopCount=%d, elegido %u con score=%.2f\n",topCount, chosenId, chosenScore);
-        return chosenId;
+    routeCacheMisses++;
+    if (e.epoch != routeCacheEpoch || e.destination != destID) {
+        uint16_t hop = computeFixedNextHop(destID, 0);
+        if (hop == INVALID_NEXT_HOP) {
+            return computeNextHop(localID, destID, excludeID); // sorteo sin cachear
+        }
+        int i = findNeighbor(hop);
+        e.destination = destID;
+        e.nextHop = hop;
+        e.etxQ8 = (i >= 0) ? neighborTable[i].etxQ8 : 0;
+        e.epoch = routeCacheEpoch;
+        if (hop != excludeID) {
+            return hop;
+        }
     }
-    if (countAll > 0) {
-        Serial.println("getNextHop => topCount=0, usando primer candidato disponible...");
-        return allCandidates[0].id; 
+    return computeNextHop(localID, destID, excludeID);
+}
+inline void printRouteCacheStats() {
+    uint32_t total = routeCacheHits + routeCacheMisses;
+    Serial.println("=== Caché de Rutas ===");
+    Serial.printf("  Aciertos %lu, fallos %lu (%lu%%), invalidaciones %lu\n",
+                  (unsigned long)routeCacheHits, (unsigned long)routeCacheMisses,
+                  (unsigned long)(total ? routeCacheHits * 100 / total : 0),
+                  (unsigned long)routeCacheInvalidations);
+    for (int i = 0; i < ROUTE_CACHE_SIZE; i++) {
+        const RouteCacheEntry &e = routeCache[i];
+        if (e.epoch == routeCacheEpoch) {
+            Serial.printf("  Destino: %u -> %u (ETX %.2f)\n", e.destination, e.nextHop, e.etxQ8 / 256.0);
+        }
     }
-    Serial.println("getNextHop => Sin candidatos => retorno ID error");
-    return INVALID_NEXT_HOP;
+    Serial.println("======================");
 }
 
 #endif
@@ -0,0 +1,142 @@
+/*==============================================================================
+  bench_scheduler_heap.cpp
+  ------------------------------------------------------------------------------
+  Rendimiento de la cola de transmisión con 10, 100 y 1000 elementos
+  (se compila con MAX_QUEUE_SIZE=1024, ver CMakeLists.txt).
+  – alta: allocQueueSlot + pushScheduledItem;
+  – reprogramación: rescheduleItem de un elemento al azar;
+  – extracción: peekReadyItem + drrCharge + releaseQueueSlot (y alta de
+    reposición para mantener el tamaño);
+  – referencia: la doble búsqueda lineal del planificador original.
+  Sólo informa de los tiempos; comprueba que la cola queda coherente.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+#include <chrono>
+
+static_assert(MAX_QUEUE_SIZE >= 1000 + QUEUE_RESERVED_CONTROL, "compilar con MAX_QUEUE_SIZE=1024");
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerOp(Clock::time_point start, long ops) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)ops;
+}
+
+static int pushControlItem(unsigned long scheduleTime) {
+    static const uint8_t kinds[] = { ITEM_ACK, ITEM_HELLO, ITEM_ALT };
+    int slot = allocQueueSlot(kinds[random(0, 3)]);
+    if (slot < 0) {
+        return -1;
+    }
+    scheduledQueue[slot].messageID = (uint32_t)random(1, 1000000);
+    scheduledQueue[slot].node = (uint16_t)random(1, 100);
+    pushScheduledItem(slot, scheduleTime);
+    return slot;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Referencia: cola plana con las dos pasadas de updateMessageScheduler      */
+/*  original (primero un ACK vencido, luego cualquier vencido).               */
+/*----------------------------------------------------------------------------*/
+struct LinearItem {
+    unsigned long scheduleTime;
+    uint8_t kind;
+    bool inUse;
+};
+static LinearItem linearQueue[MAX_QUEUE_SIZE];
+
+static int linearPeek(int size, unsigned long now) {
+    for (int i = 0; i < size; i++) {
+        if (linearQueue[i].inUse && linearQueue[i].kind == ITEM_ACK && !timeBefore(now, linearQueue[i].scheduleTime)) {
+            return i;
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        if (linearQueue[i].inUse && !timeBefore(now, linearQueue[i].scheduleTime)) {
+            return i;
+        }
+    }
+    return -1;
+}
+static double benchLinear(int size, long ops) {
+    for (int i = 0; i < size; i++) {
+        linearQueue[i].scheduleTime = millis() + (unsigned long)random(1, 60000);
+        linearQueue[i].kind = (uint8_t)random(0, 4);
+        linearQueue[i].inUse = true;
+    }
+    volatile int sink = 0;
+    Clock::time_point start = Clock::now();
+    for (long n = 0; n < ops; n++) {
+        /* el elemento que vence es el último: peor caso habitual del escaneo */
+        linearQueue[size - 1].scheduleTime = millis();
+        int slot = linearPeek(size, millis());
+        sink += slot;
+        linearQueue[slot].scheduleTime = millis() + 60000;
+    }
+    (void)sink;
+    return nsPerOp(start, ops);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Cola indexada                                                             */
+/*----------------------------------------------------------------------------*/
+static void benchSize(int size) {
+    const long ops = 200000;
+    initMessageScheduler();
+    releaseQueueSlot(timerHeap.slots[0]); // HELLO inicial
+    hostNowMs = 1000000;
+
+    /* alta (la cola se vacía y se vuelve a llenar hasta 'size') */
+    long pushes = 0;
+    Clock::time_point start = Clock::now();
+    while (pushes < ops) {
+        for (int i = 0; i < size; i++) {
+            pushControlItem(millis() + (unsigned long)random(1, 60000));
+        }
+        pushes += size;
+        if (pushes < ops) {
+            while (timerHeap.size > 0) {
+                releaseQueueSlot(timerHeap.slots[timerHeap.size - 1]);
+            }
+        }
+    }
+    double pushNs = nsPerOp(start, pushes);
+    CHECK_EQ(queueOccupancy(), size);
+
+    /* reprogramación de elementos al azar */
+    start = Clock::now();
+    for (long n = 0; n < ops; n++) {
+        rescheduleItem(timerHeap.slots[random(0, timerHeap.size)], millis() + (unsigned long)random(1, 60000));
+    }
+    double rescheduleNs = nsPerOp(start, ops);
+
+    /* extracción en régimen: vence uno, se envía y entra otro */
+    long served = 0;
+    start = Clock::now();
+    for (long n = 0; n < ops; n++) {
+        hostNowMs += 60000 / (unsigned long)size;
+        int slot = peekReadyItem(millis());
+        if (slot >= 0) {
+            drrCharge(slot);
+            releaseQueueSlot(slot);
+            served++;
+            pushControlItem(millis() + (unsigned long)random(1, 60000));
+        }
+    }
+    double popNs = nsPerOp(start, ops);
+    CHECK(served > ops / 2);
+    CHECK_EQ(queueOccupancy(), size);
+
+    double linearNs = benchLinear(size, ops);
+    printf("  %5d  %10.1f  %14.1f  %13.1f  %16.1f\n", size, pushNs, rescheduleNs, popNs, linearNs);
+}
+
+int main() {
+    hostSeed(7);
+    printf("  (ns por operación)\n");
+    printf("  Tamaño  alta   reprogramación  extracción  escaneo lineal\n");
+    benchSize(10);
+    benchSize(100);
+    benchSize(1000);
+    return hostTestResult("bench_scheduler_heap");
+}
@@ -0,0 +1,42 @@
+/*==============================================================================
+  host_test.h
+  ------------------------------------------------------------------------------
+  Utilidades mínimas de las pruebas de host (sin dependencias externas).
+  – CHECK / CHECK_EQ registran el fallo con archivo y línea y siguen.
+  – hostTestResult() se devuelve desde main(): 0 ⇒ todo bien (ctest).
+==============================================================================*/
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+static int hostChecks = 0;
+static int hostFailures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        hostChecks++;                                                                \
+        if (!(cond)) {                                                               \
+            hostFailures++;                                                          \
+            printf("%s:%d: FALLO: %s\n", __FILE__, __LINE__, #cond);                 \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                   \
+    do {                                                                             \
+        hostChecks++;                                                                \
+        long long a_ = (long long)(actual);                                          \
+        long long e_ = (long long)(expected);                                        \
+        if (a_ != e_) {                                                              \
+            hostFailures++;                                                          \
+            printf("%s:%d: FALLO: %s == %lld (esperado %lld)\n", __FILE__, __LINE__, \
+                   #actual, a_, e_);                                                 \
+        }                                                                            \
+    } while (0)
+
+inline int hostTestResult(const char *name) {
+    printf("%s: %d comprobaciones, %d fallos\n", name, hostChecks, hostFailures);
+    return hostFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*==============================================================================
+  sketch.h
+  ------------------------------------------------------------------------------
+  Incluye el sketch completo en una prueba de host. setup() y loop() pasan a
+  llamarse sketchSetup() y sketchLoop() para no chocar con main().
+==============================================================================*/
+#ifndef HOST_SKETCH_H
+#define HOST_SKETCH_H
+
+#include "Arduino.h"
+#include "esp_system.h"
+
+#define setup sketchSetup
+#define loop sketchLoop
+#include "LoRaMesh.ino"
+#undef setup
+#undef loop
+
+#endif
@@ -0,0 +1,88 @@
+/*==============================================================================
+  Arduino.h (stub de host)
+  ------------------------------------------------------------------------------
+  Lo mínimo del núcleo Arduino-ESP32 que usa el sketch, para compilar los
+  headers en el PC y probarlos con ctest.
+  – millis()/micros() leen un reloj simulado (hostNowMs) que avanza la prueba.
+  – random() es determinista (semilla fija, hostSeed()).
+  – Serial descarta la salida salvo con LORAMESH_TEST_VERBOSE=1.
+==============================================================================*/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <string>
+
+#define OUTPUT 1
+#define INPUT 0
+#define LOW 0
+#define HIGH 1
+#define RISING 1
+#define IRAM_ATTR
+
+/*----------------------------------------------------------------------------*/
+/*  Reloj y aleatoriedad simulados                                            */
+/*----------------------------------------------------------------------------*/
+extern unsigned long hostNowMs;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+long random(long upper);
+long random(long lower, long upper);
+void randomSeed(unsigned long seed);
+void hostSeed(unsigned long seed);
+
+/*----------------------------------------------------------------------------*/
+/*  GPIO (sin efecto)                                                         */
+/*----------------------------------------------------------------------------*/
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+void attachInterrupt(int pin, void (*handler)(void), int mode);
+
+/*----------------------------------------------------------------------------*/
+/*  String y Serial                                                           */
+/*----------------------------------------------------------------------------*/
+class String : public std::string {
+public:
+    String() {}
+    String(const char *s) : std::string(s) {}
+    String(const std::string &s) : std::string(s) {}
+    String(int v) : std::string(std::to_string(v)) {}
+    String(unsigned v) : std::string(std::to_string(v)) {}
+    String(long v) : std::string(std::to_string(v)) {}
+    String(unsigned long v) : std::string(std::to_string(v)) {}
+    int toInt() const { return atoi(c_str()); }
+};
+inline String operator+(const String &a, const String &b) {
+    return String(static_cast<const std::string &>(a) + static_cast<const std::string &>(b));
+}
+
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    int available();
+    int read();
+    int peek();
+    void flush() {}
+    void onReceive(void (*callback)(void)) { (void)callback; }
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void print(const char *text);
+    void print(const String &text) { print(text.c_str()); }
+    void print(int value);
+    void println(const char *text = "");
+    void println(const String &text) { println(text.c_str()); }
+    void println(int value);
+};
+extern HardwareSerial Serial;
+
+/* Entrada de consola simulada (la consume Serial.read) */
+void hostSerialInput(const char *text);
+
+#endif
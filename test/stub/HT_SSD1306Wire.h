@@ -0,0 +1,27 @@
+/*==============================================================================
+  HT_SSD1306Wire.h (stub de host): pantalla sin efecto.
+==============================================================================*/
+#ifndef HOST_HT_SSD1306WIRE_H
+#define HOST_HT_SSD1306WIRE_H
+
+#include "Arduino.h"
+
+#define GEOMETRY_64_32 0
+#define TEXT_ALIGN_LEFT 0
+
+extern const uint8_t ArialMT_Plain_10[];
+
+class SSD1306Wire {
+public:
+    SSD1306Wire(int address, int frequency, int sda, int scl, int geometry, int reset) {
+        (void)address; (void)frequency; (void)sda; (void)scl; (void)geometry; (void)reset;
+    }
+    void init() {}
+    void clear() {}
+    void display() {}
+    void setFont(const uint8_t *font) { (void)font; }
+    void setTextAlignment(int alignment) { (void)alignment; }
+    void drawString(int x, int y, const String &text) { (void)x; (void)y; (void)text; }
+};
+
+#endif
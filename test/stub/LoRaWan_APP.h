@@ -0,0 +1,73 @@
+/*==============================================================================
+  LoRaWan_APP.h (stub de host)
+  ------------------------------------------------------------------------------
+  Interfaz Radio del driver Heltec SX1262. El radio simulado no emite nada:
+  anota cada operación en hostRadio para que la prueba la compruebe.
+==============================================================================*/
+#ifndef HOST_LORAWAN_APP_H
+#define HOST_LORAWAN_APP_H
+
+#include <stdint.h>
+#include <vector>
+
+typedef enum { MODEM_FSK = 0, MODEM_LORA } RadioModems_t;
+
+typedef struct {
+    void (*TxDone)(void);
+    void (*TxTimeout)(void);
+    void (*RxDone)(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr);
+    void (*RxTimeout)(void);
+    void (*RxError)(void);
+    void (*FhssChangeChannel)(uint8_t currentChannel);
+    void (*CadDone)(bool channelActivityDetected);
+} RadioEvents_t;
+
+struct Radio_s {
+    void (*Init)(RadioEvents_t *events);
+    void (*SetChannel)(uint32_t frequency);
+    void (*SetRxConfig)(RadioModems_t modem, uint32_t bandwidth, uint32_t datarate, uint8_t coderate,
+                        uint32_t bandwidthAfc, uint16_t preambleLen, uint16_t symbTimeout, bool fixLen,
+                        uint8_t payloadLen, bool crcOn, bool freqHopOn, uint8_t hopPeriod, bool iqInverted,
+                        bool rxContinuous);
+    void (*SetTxConfig)(RadioModems_t modem, int8_t power, uint32_t fdev, uint32_t bandwidth, uint32_t datarate,
+                        uint8_t coderate, uint16_t preambleLen, bool fixLen, bool crcOn, bool freqHopOn,
+                        uint8_t hopPeriod, bool iqInverted, uint32_t timeout);
+    void (*IrqProcess)(void);
+    void (*Rx)(uint32_t timeout);
+    void (*Send)(uint8_t *buffer, uint8_t size);
+    void (*Sleep)(void);
+    void (*Standby)(void);
+    void (*StartCad)(void);
+};
+extern const struct Radio_s Radio;
+
+struct McuClass {
+    void begin(int board, int clock) { (void)board; (void)clock; }
+};
+extern McuClass Mcu;
+
+#define HELTEC_BOARD 0
+#define SLOW_CLK_TPYE 0
+#define Vext 36
+#define SDA_OLED 17
+#define SCL_OLED 18
+#define RST_OLED 21
+
+/*----------------------------------------------------------------------------*/
+/*  Registro del radio simulado                                               */
+/*----------------------------------------------------------------------------*/
+struct HostRadio {
+    RadioEvents_t *events;
+    std::vector<std::vector<uint8_t>> sent; // tramas de Radio.Send
+    std::vector<unsigned long> sentAt;      // millis() de cada envío
+    uint32_t frequency;
+    uint8_t spreadingFactor;                // último SF programado en TX
+    int8_t txPower;
+    uint16_t txPreamble;
+    int rxArms;                             // llamadas a Radio.Rx
+    int cads;
+    int sleeps;
+};
+extern HostRadio hostRadio;
+
+#endif
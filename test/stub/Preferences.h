@@ -0,0 +1,40 @@
+/*==============================================================================
+  Preferences.h (stub de host)
+  ------------------------------------------------------------------------------
+  NVS simulada en memoria (hostNvs, clave = "espacio/clave"): sobrevive a un
+  sketchSetup() repetido como la flash a un reinicio; cada prueba la vacía
+  para simular la flash borrada.
+==============================================================================*/
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+
+extern std::map<std::string, uint16_t> hostNvs;
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        space = name;
+        return true;
+    }
+    void end() {}
+    bool isKey(const char *key) {
+        return hostNvs.count(space + "/" + key) > 0;
+    }
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0) {
+        std::map<std::string, uint16_t>::const_iterator it = hostNvs.find(space + "/" + key);
+        return it != hostNvs.end() ? it->second : defaultValue;
+    }
+    size_t putUShort(const char *key, uint16_t value) {
+        hostNvs[space + "/" + key] = value;
+        return sizeof(value);
+    }
+private:
+    std::string space;
+};
+
+#endif
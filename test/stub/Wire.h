@@ -0,0 +1,6 @@
+/*==============================================================================
+  Wire.h (stub de host): el OLED simulado no usa I2C.
+==============================================================================*/
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+#endif
@@ -0,0 +1,120 @@
+/*==============================================================================
+  arduino_stub.cpp
+  ------------------------------------------------------------------------------
+  Implementación de los stubs de host (Arduino.h, esp_system.h,
+  Preferences.h).
+==============================================================================*/
+#include "Arduino.h"
+#include "esp_system.h"
+#include "Preferences.h"
+
+unsigned long hostNowMs = 0;
+uint64_t hostMac = 0x0001;
+std::map<std::string, uint16_t> hostNvs;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static std::string hostConsole;
+static bool hostVerbose() {
+    static int verbose = -1;
+    if (verbose < 0) {
+        const char *env = getenv("LORAMESH_TEST_VERBOSE");
+        verbose = (env != nullptr && env[0] == '1') ? 1 : 0;
+    }
+    return verbose == 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Reloj y aleatoriedad                                                      */
+/*----------------------------------------------------------------------------*/
+unsigned long millis() {
+    return hostNowMs;
+}
+unsigned long micros() {
+    return hostNowMs * 1000UL;
+}
+void delay(unsigned long ms) {
+    hostNowMs += ms;
+}
+/* LCG propio: misma secuencia en cualquier libc */
+static uint32_t hostRandomState = 1;
+static uint32_t hostNextRandom() {
+    hostRandomState = hostRandomState * 1103515245u + 12345u;
+    return hostRandomState >> 1;
+}
+long random(long upper) {
+    return upper > 0 ? (long)(hostNextRandom() % (uint32_t)upper) : 0;
+}
+long random(long lower, long upper) {
+    return upper > lower ? lower + random(upper - lower) : lower;
+}
+void randomSeed(unsigned long seed) {
+    hostRandomState = (uint32_t)seed;
+}
+void hostSeed(unsigned long seed) {
+    hostRandomState = (uint32_t)seed;
+}
+uint32_t esp_random(void) {
+    return hostNextRandom();
+}
+
+/*----------------------------------------------------------------------------*/
+/*  GPIO                                                                      */
+/*----------------------------------------------------------------------------*/
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+int digitalRead(int) {
+    return 0;
+}
+int analogRead(int) {
+    return 0;
+}
+void attachInterrupt(int, void (*)(void), int) {}
+
+/*----------------------------------------------------------------------------*/
+/*  Serial                                                                    */
+/*----------------------------------------------------------------------------*/
+void hostSerialInput(const char *text) {
+    hostConsole += text;
+}
+int HardwareSerial::available() {
+    return (int)hostConsole.size();
+}
+int HardwareSerial::read() {
+    if (hostConsole.empty()) {
+        return -1;
+    }
+    int c = (unsigned char)hostConsole[0];
+    hostConsole.erase(0, 1);
+    return c;
+}
+int HardwareSerial::peek() {
+    return hostConsole.empty() ? -1 : (unsigned char)hostConsole[0];
+}
+int HardwareSerial::printf(const char *format, ...) {
+    if (!hostVerbose()) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written;
+}
+void HardwareSerial::print(const char *text) {
+    if (hostVerbose()) {
+        fputs(text, stdout);
+    }
+}
+void HardwareSerial::print(int value) {
+    printf("%d", value);
+}
+void HardwareSerial::println(const char *text) {
+    if (hostVerbose()) {
+        puts(text);
+    }
+}
+void HardwareSerial::println(int value) {
+    printf("%d\n", value);
+}
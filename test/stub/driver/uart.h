@@ -0,0 +1,15 @@
+/*==============================================================================
+  driver/uart.h (stub de host)
+==============================================================================*/
+#ifndef HOST_DRIVER_UART_H
+#define HOST_DRIVER_UART_H
+
+#define UART_NUM_0 0
+
+inline int uart_set_wakeup_threshold(int uartNum, int threshold) {
+    (void)uartNum;
+    (void)threshold;
+    return 0;
+}
+
+#endif
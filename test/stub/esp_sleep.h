@@ -0,0 +1,18 @@
+/*==============================================================================
+  esp_sleep.h (stub de host)
+  ------------------------------------------------------------------------------
+  El sueño ligero adelanta el reloj simulado lo programado con
+  esp_sleep_enable_timer_wakeup() y lo acumula en hostSleptMs.
+==============================================================================*/
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <stdint.h>
+
+extern unsigned long hostSleptMs;
+
+int esp_sleep_enable_timer_wakeup(uint64_t timeUs);
+int esp_sleep_enable_uart_wakeup(int uartNum);
+int esp_light_sleep_start();
+
+#endif
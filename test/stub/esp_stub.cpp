@@ -0,0 +1,107 @@
+/*==============================================================================
+  esp_stub.cpp
+  ------------------------------------------------------------------------------
+  Implementación de los stubs que sólo necesita el sketch completo: radio
+  (LoRaWan_APP.h), OLED, sueño ligero y notificaciones de FreeRTOS.
+==============================================================================*/
+#include "Arduino.h"
+#include "LoRaWan_APP.h"
+#include "HT_SSD1306Wire.h"
+#include "esp_sleep.h"
+#include "freertos/task.h"
+
+HostRadio hostRadio = {};
+McuClass Mcu;
+const uint8_t ArialMT_Plain_10[1] = { 0 };
+
+/*----------------------------------------------------------------------------*/
+/*  Radio                                                                     */
+/*----------------------------------------------------------------------------*/
+static void radioInit(RadioEvents_t *events) {
+    hostRadio.events = events;
+}
+static void radioSetChannel(uint32_t frequency) {
+    hostRadio.frequency = frequency;
+}
+static void radioSetRxConfig(RadioModems_t, uint32_t, uint32_t, uint8_t, uint32_t, uint16_t, uint16_t, bool,
+                             uint8_t, bool, bool, uint8_t, bool, bool) {}
+static void radioSetTxConfig(RadioModems_t, int8_t power, uint32_t, uint32_t, uint32_t datarate, uint8_t,
+                             uint16_t preambleLen, bool, bool, bool, uint8_t, bool, uint32_t) {
+    hostRadio.txPower = power;
+    hostRadio.spreadingFactor = (uint8_t)datarate;
+    hostRadio.txPreamble = preambleLen;
+}
+static void radioIrqProcess() {}
+static void radioRx(uint32_t) {
+    hostRadio.rxArms++;
+}
+static void radioSend(uint8_t *buffer, uint8_t size) {
+    hostRadio.sent.push_back(std::vector<uint8_t>(buffer, buffer + size));
+    hostRadio.sentAt.push_back(millis());
+    hostNotifications++; // TxDone llega por DIO1
+}
+static void radioSleep() {
+    hostRadio.sleeps++;
+}
+static void radioStandby() {}
+static void radioStartCad() {
+    hostRadio.cads++;
+    hostNotifications++; // CadDone llega por DIO1
+}
+
+const struct Radio_s Radio = {
+    radioInit, radioSetChannel, radioSetRxConfig, radioSetTxConfig, radioIrqProcess,
+    radioRx, radioSend, radioSleep, radioStandby, radioStartCad
+};
+
+/* Manejador de DIO1 del driver (lo encadena event_manager.h) */
+extern "C" void RadioOnDioIrq(void) {}
+
+/*----------------------------------------------------------------------------*/
+/*  Sueño ligero                                                              */
+/*----------------------------------------------------------------------------*/
+unsigned long hostSleptMs = 0;
+static uint64_t hostWakeupUs = 0;
+
+int esp_sleep_enable_timer_wakeup(uint64_t timeUs) {
+    hostWakeupUs = timeUs;
+    return 0;
+}
+int esp_sleep_enable_uart_wakeup(int) {
+    return 0;
+}
+int esp_light_sleep_start() {
+    hostNowMs += (unsigned long)(hostWakeupUs / 1000);
+    hostSleptMs += (unsigned long)(hostWakeupUs / 1000);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Notificaciones de tarea                                                   */
+/*----------------------------------------------------------------------------*/
+uint32_t hostNotifications = 0;
+unsigned long hostLastWaitMs = 0;
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return (TaskHandle_t)&hostNotifications;
+}
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t ticksToWait) {
+    hostLastWaitMs = ticksToWait;
+    if (hostNotifications > 0) {
+        uint32_t taken = hostNotifications;
+        hostNotifications = 0;
+        return taken;
+    }
+    hostNowMs += ticksToWait;
+    return 0;
+}
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *higherPriorityTaskWoken) {
+    hostNotifications++;
+    if (higherPriorityTaskWoken != nullptr) {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+BaseType_t xTaskNotifyGive(TaskHandle_t) {
+    hostNotifications++;
+    return pdTRUE;
+}
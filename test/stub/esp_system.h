@@ -0,0 +1,21 @@
+/*==============================================================================
+  esp_system.h (stub de host)
+  ------------------------------------------------------------------------------
+  ESP.getEfuseMac() devuelve hostMac: cada prueba elige la identidad del nodo
+  (getNodeID() = bits 0-15 XOR bits 32-47).
+==============================================================================*/
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+extern uint64_t hostMac;
+
+struct EspClass {
+    uint64_t getEfuseMac() { return hostMac; }
+};
+extern EspClass ESP;
+
+uint32_t esp_random(void);
+
+#endif
@@ -0,0 +1,20 @@
+/*==============================================================================
+  freertos/task.h (stub de host)
+  ------------------------------------------------------------------------------
+  Una sola tarea. ulTaskNotifyTake() devuelve las notificaciones pendientes
+  o, si no hay, adelanta el reloj simulado el tiempo de espera completo.
+==============================================================================*/
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+extern uint32_t hostNotifications;   // notificaciones sin consumir
+extern unsigned long hostLastWaitMs; // último plazo pedido a ulTaskNotifyTake
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif
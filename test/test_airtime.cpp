@@ -0,0 +1,127 @@
+/*==============================================================================
+  test_airtime.cpp
+  ------------------------------------------------------------------------------
+  Tiempo en el aire y presupuesto de airtime_manager.h:
+  – computeTimeOnAirUs frente a la fórmula de Semtech (AN1200.13) en coma
+    flotante para SF7–12, 125/250/500 kHz, CR 4/5–4/8 y PL 0–255.
+  – Valores de referencia de la calculadora de Semtech.
+  – Ventana deslizante: límite normal, reserva de control, liberación de
+    cubetas y airtimeNextAvailable.
+==============================================================================*/
+#include "Arduino.h"
+#include "host_test.h"
+#include "airtime_manager.h"
+#include <math.h>
+
+/* Semtech AN1200.13: cabecera explícita, CRC activo, DE si Tsym ≥ 16 ms */
+static double semtechToaUs(int sf, int bandwidth, int codingRate, int preamble, int payloadBytes) {
+    double bw = bandwidth == 0 ? 125e3 : bandwidth == 1 ? 250e3 : 500e3;
+    double tsym = pow(2.0, sf) / bw;
+    int de = tsym >= 0.016 ? 1 : 0;
+    double num = 8.0 * payloadBytes - 4.0 * sf + 28 + 16;
+    double nPayload = 8 + fmax(ceil(num / (4.0 * (sf - 2 * de))) * (codingRate + 4), 0.0);
+    return ((preamble + 4.25) * tsym + nPayload * tsym) * 1e6;
+}
+
+static void testFormula() {
+    int worst = 0;
+    for (int sf = 7; sf <= 12; sf++) {
+        for (int bw = 0; bw < 3; bw++) {
+            for (int cr = 1; cr <= 4; cr++) {
+                for (int pre = 8; pre <= 64; pre += 56) {
+                    for (int pl = 0; pl <= 255; pl++) {
+                        double ref = semtechToaUs(sf, bw, cr, pre, pl);
+                        uint32_t toa = computeTimeOnAirUs(sf, bw, cr, pre, pl);
+                        /* Tsym se trunca a µs enteros */
+                        int err = (int)fabs(ref - (double)toa);
+                        if (err > worst) {
+                            worst = err;
+                        }
+                        CHECK(err <= 2);
+                    }
+                }
+            }
+        }
+    }
+    printf("  error máximo frente a Semtech: %d µs\n", worst);
+}
+
+static void testKnownValues() {
+    /* calculadora de Semtech: BW 125 kHz, CR 4/5, preámbulo 8, CRC, cabecera explícita */
+    CHECK_EQ(computeTimeOnAirUs(7, 0, 1, 8, 10), 41216);
+    CHECK_EQ(computeTimeOnAirUs(7, 0, 1, 8, 20), 56576);
+    CHECK_EQ(computeTimeOnAirUs(12, 0, 1, 8, 10), 991232);   // con DE
+    CHECK_EQ(computeTimeOnAirUs(9, 2, 1, 8, 10), 36096);     // 500 kHz
+    /* los parámetros de config.h */
+    CHECK_EQ(getTimeOnAirUs(20), computeTimeOnAirUs(LORA_SPREADING_FACTOR, LORA_BANDWIDTH,
+                                                    LORA_CODINGRATE, LORA_PREAMBLE_LENGTH, 20));
+    CHECK_EQ(getTimeOnAirUsAt(10, 20), computeTimeOnAirUs(10, LORA_BANDWIDTH, LORA_CODINGRATE,
+                                                          LORA_PREAMBLE_LENGTH, 20));
+    /* monótono en la carga útil y en el SF */
+    for (int pl = 1; pl <= 255; pl++) {
+        CHECK(getTimeOnAirUs(pl) >= getTimeOnAirUs(pl - 1));
+    }
+    for (int sf = 8; sf <= 12; sf++) {
+        CHECK(getTimeOnAirUsAt(sf, 20) > getTimeOnAirUsAt(sf - 1, 20));
+    }
+}
+
+static void testBudget() {
+    const uint32_t toa = getTimeOnAirUs(20);
+    hostNowMs = 1000;
+    initAirtimeManager();
+
+    /* tráfico normal hasta AIRTIME_NORMAL_US */
+    uint32_t frames = 0;
+    while (airtimeAvailable(toa, false)) {
+        airtimeConsume(MESSAGE_TYPE_DATA, toa);
+        frames++;
+    }
+    CHECK_EQ(frames, AIRTIME_NORMAL_US / toa);
+    CHECK(airtimeWindowUs <= AIRTIME_NORMAL_US);
+    CHECK_EQ(framesByType[MESSAGE_TYPE_DATA], frames);
+
+    /* ACK / ALT aún caben en la reserva, hasta AIRTIME_BUDGET_US */
+    CHECK(airtimeAvailable(toa, true));
+    uint32_t control = 0;
+    while (airtimeAvailable(toa, true)) {
+        airtimeConsume(MESSAGE_TYPE_ACK, toa);
+        control++;
+    }
+    CHECK_EQ(frames + control, AIRTIME_BUDGET_US / toa);
+    CHECK(airtimeWindowUs <= AIRTIME_BUDGET_US);
+
+    /* todo se consumió en la primera cubeta: se libera al cerrar la ventana */
+    unsigned long next = airtimeNextAvailable(toa, false);
+    CHECK_EQ(next, 1000 + DUTY_CYCLE_WINDOW_MS);
+    hostNowMs = next - 1;
+    CHECK(!airtimeAvailable(toa, false));
+    hostNowMs = next;
+    CHECK(airtimeAvailable(toa, false));
+    CHECK_EQ(airtimeWindowUs, 0);
+
+    /* consumo repartido: sólo sale la cubeta más antigua */
+    initAirtimeManager();
+    for (int b = 0; b < DUTY_CYCLE_BUCKETS; b++) {
+        airtimeConsume(MESSAGE_TYPE_HELLO, (uint32_t)(AIRTIME_NORMAL_US / DUTY_CYCLE_BUCKETS));
+        hostNowMs += AIRTIME_BUCKET_MS;
+    }
+    hostNowMs -= AIRTIME_BUCKET_MS;   // dentro de la última cubeta
+    CHECK(!airtimeAvailable(toa, false));
+    next = airtimeNextAvailable(toa, false);
+    CHECK(next > hostNowMs && next <= hostNowMs + AIRTIME_BUCKET_MS);
+    hostNowMs = next;
+    CHECK(airtimeAvailable(toa, false));
+
+    /* inactividad mayor que la ventana: se vacía del todo */
+    hostNowMs += 3 * DUTY_CYCLE_WINDOW_MS;
+    CHECK(airtimeAvailable(toa, false));
+    CHECK_EQ(airtimeWindowUs, 0);
+}
+
+int main() {
+    testFormula();
+    testKnownValues();
+    testBudget();
+    return hostTestResult("test_airtime");
+}
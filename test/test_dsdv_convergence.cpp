@@ -0,0 +1,394 @@
+/*==============================================================================
+  test_dsdv_convergence.cpp
+  ------------------------------------------------------------------------------
+  Vector de distancias de routing_manager.h (routeUpdate / fillHelloRoutes)
+  simulado en varios nodos sobre cadena, estrella y rejilla:
+  – Cada ronda todos los nodos emiten un HELLO (serializado y decodificado
+    con packet_manager.h) que reciben sus vecinos del grafo.
+  – Converge en tantas rondas como el diámetro a coste mínimo por saltos y
+    con un nextHop que acerca al destino.
+  – Tras romper un enlace las rutas afectadas se marcan rotas o reconvergen
+    por otro camino, sin bucles en ninguna ronda.
+  – Con más rutas de las que caben en un HELLO, los enviados por la cola
+    (updateMessageScheduler) las anuncian todas por turno.
+  El estado de routing_manager.h es global: se guarda y recupera por nodo.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+#include <string.h>
+
+/*----------------------------------------------------------------------------*/
+/*  Estado por nodo                                                           */
+/*----------------------------------------------------------------------------*/
+#define ROUTING_STATE(X)                                                              \
+    X(routeCacheEpoch) X(routeCacheInvalidations) X(neighborTable) X(neighborCount)   \
+    X(helloTrickle) X(lastOwnHello) X(hellosSuppressed) X(neighborHash)               \
+    X(neighborRank) X(neighborRankPos) X(neighborRankCount) X(neighborSweepPos)       \
+    X(routeTable) X(routeCount) X(routeSweepPos) X(routeAdvertCursor)                 \
+    X(routeAdvertNext) X(routeOwnSeq) X(routeCache) X(routeCacheHits)                 \
+    X(routeCacheMisses)
+
+#define STATE_FIELD(v) decltype(v) v##_;
+#define STATE_SAVE(v) memcpy(&s.v##_, &v, sizeof(v));
+#define STATE_LOAD(v) memcpy(&v, &s.v##_, sizeof(v));
+
+struct NodeState {
+    ROUTING_STATE(STATE_FIELD)
+};
+
+#define MAX_NODES 16
+#define NODE_ID_BASE 100
+#define ROUND_MS 5000
+
+static NodeState nodes[MAX_NODES];
+static NodeState pristine;
+static bool links[MAX_NODES][MAX_NODES];
+static int nodeCount = 0;
+
+static uint16_t nodeId(int n) {
+    return (uint16_t)(NODE_ID_BASE + n);
+}
+static void save(int n) {
+    NodeState &s = nodes[n];
+    ROUTING_STATE(STATE_SAVE)
+}
+static void load(int n) {
+    NodeState &s = nodes[n];
+    ROUTING_STATE(STATE_LOAD)
+    hostMac = nodeId(n);
+}
+static void connect(int a, int b, bool up) {
+    links[a][b] = up;
+    links[b][a] = up;
+}
+
+static void resetNetwork(int count) {
+    nodeCount = count;
+    memset(links, 0, sizeof(links));
+    for (int n = 0; n < count; n++) {
+        nodes[n] = pristine;
+        load(n);
+        initTrickle();
+        initRouteTable();
+        save(n);
+    }
+}
+
+/* Una ronda: HELLO de cada nodo a sus vecinos y barrido de expirados */
+static void runRound() {
+    for (int n = 0; n < nodeCount; n++) {
+        load(n);
+        HelloPacket hello;
+        fillHelloPacket(hello, 0);
+        fillHelloRoutes(hello);
+        routeNoteHelloSent();
+        save(n);
+        uint8_t buffer[MAX_PACKET_SIZE];
+        uint16_t size = serializePacket(hello, buffer, sizeof(buffer));
+        HelloPacket received;
+        bool decoded = size > 0 && deserializePacket(received, buffer, size);
+        CHECK(decoded);
+        if (!decoded) {
+            continue;
+        }
+        for (int m = 0; m < nodeCount; m++) {
+            if (!links[n][m]) {
+                continue;
+            }
+            load(m);
+            addOrUpdateNeighbor(received.originNode, -60, 10);
+            if (findNeighbor(received.originNode) >= 0) {
+                routeProcessHello(received, getLinkCost(received.originNode));
+            }
+            save(m);
+        }
+    }
+    hostNowMs += ROUND_MS;
+    for (int n = 0; n < nodeCount; n++) {
+        load(n);
+        for (int s = 0; s < MAX_NEIGHBORS / NEIGHBOR_SWEEP_STEP; s++) {
+            cleanupNeighbors();
+        }
+        save(n);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Distancias de referencia (BFS sobre el grafo actual)                      */
+/*----------------------------------------------------------------------------*/
+static int hops[MAX_NODES][MAX_NODES];
+
+static void computeHops() {
+    for (int s = 0; s < nodeCount; s++) {
+        for (int d = 0; d < nodeCount; d++) {
+            hops[s][d] = -1;
+        }
+        int queue[MAX_NODES];
+        int head = 0, tail = 0;
+        hops[s][s] = 0;
+        queue[tail++] = s;
+        while (head < tail) {
+            int u = queue[head++];
+            for (int v = 0; v < nodeCount; v++) {
+                if (links[u][v] && hops[s][v] < 0) {
+                    hops[s][v] = hops[s][u] + 1;
+                    queue[tail++] = v;
+                }
+            }
+        }
+    }
+}
+
+/* Siguiente salto de n hacia d según su estado (índice de nodo o -1) */
+static int nextNode(int n, int d) {
+    load(n);
+    uint16_t hop = findNeighbor(nodeId(d)) >= 0 ? nodeId(d) : getRouteNextHop(nodeId(d), 0);
+    if (hop == INVALID_NEXT_HOP) {
+        return -1;
+    }
+    return hop - NODE_ID_BASE;
+}
+
+/* Todas las rutas con coste hops·ROUTE_HOP_COST y nextHop que acerca */
+static bool converged() {
+    for (int n = 0; n < nodeCount; n++) {
+        for (int d = 0; d < nodeCount; d++) {
+            if (n == d || hops[n][d] < 0) {
+                continue;
+            }
+            int next = nextNode(n, d);
+            if (next < 0 || !links[n][next] || hops[next][d] != hops[n][d] - 1) {
+                return false;
+            }
+            if (hops[n][d] > 1) {
+                const RouteEntry *e = routeFind(nodeId(d));
+                if (e == nullptr || e->cost != hops[n][d] * ROUTE_HOP_COST) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/* Seguir los nextHop nunca vuelve a pasar por un nodo (sin bucles) */
+static bool loopFree() {
+    for (int s = 0; s < nodeCount; s++) {
+        for (int d = 0; d < nodeCount; d++) {
+            int cur = s;
+            for (int steps = 0; cur >= 0 && cur != d; steps++) {
+                if (steps > nodeCount) {
+                    printf("  bucle de %d hacia %d\n", s, d);
+                    return false;
+                }
+                cur = nextNode(cur, d);
+            }
+        }
+    }
+    return true;
+}
+
+/* Rondas hasta converger (-1 si no lo hace en maxRounds) */
+static int roundsToConverge(int maxRounds) {
+    computeHops();
+    for (int r = 1; r <= maxRounds; r++) {
+        runRound();
+        CHECK(loopFree());
+        if (converged()) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+static int diameter() {
+    computeHops();
+    int diam = 0;
+    for (int s = 0; s < nodeCount; s++) {
+        for (int d = 0; d < nodeCount; d++) {
+            if (hops[s][d] > diam) {
+                diam = hops[s][d];
+            }
+        }
+    }
+    return diam;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Topologías                                                                */
+/*----------------------------------------------------------------------------*/
+static void testChain() {
+    const int count = 8;
+    resetNetwork(count);
+    for (int n = 0; n + 1 < count; n++) {
+        connect(n, n + 1, true);
+    }
+    int rounds = roundsToConverge(3 * count);
+    printf("  cadena de %d: converge en %d rondas (diámetro %d)\n", count, rounds, diameter());
+    CHECK(rounds > 0 && rounds <= diameter());
+    load(0);
+    CHECK_EQ(getLinkCost(nodeId(1)), ROUTE_HOP_COST);
+
+    /* se rompe el enlace 3–4: las rutas que lo cruzaban quedan rotas */
+    connect(3, 4, false);
+    int broken = -1;
+    for (int r = 1; r <= NEIGHBOR_EXPIRATION_TIME / ROUND_MS + count && broken < 0; r++) {
+        runRound();
+        CHECK(loopFree());
+        bool allBroken = true;
+        for (int n = 0; n < count; n++) {
+            for (int d = 0; d < count; d++) {
+                if ((n <= 3) != (d <= 3) && nextNode(n, d) >= 0) {
+                    allBroken = false;
+                }
+            }
+        }
+        if (allBroken) {
+            broken = r;
+        }
+    }
+    printf("  cadena rota: rutas invalidadas en %d rondas\n", broken);
+    CHECK(broken > 0);
+
+    /* se cierra el anillo 7–0: reconverge por el otro lado */
+    connect(count - 1, 0, true);
+    rounds = roundsToConverge(3 * count);
+    printf("  anillo abierto: reconverge en %d rondas\n", rounds);
+    CHECK(rounds > 0 && rounds <= diameter() + 1);
+}
+
+static void testStar() {
+    const int count = 9;
+    resetNetwork(count);
+    for (int n = 1; n < count; n++) {
+        connect(0, n, true);
+    }
+    int rounds = roundsToConverge(3 * count);
+    printf("  estrella de %d: converge en %d rondas\n", count, rounds);
+    CHECK(rounds > 0 && rounds <= diameter());
+    for (int n = 1; n < count; n++) {
+        for (int d = 1; d < count; d++) {
+            if (n != d) {
+                CHECK_EQ(nextNode(n, d), 0);
+            }
+        }
+    }
+}
+
+static void testGrid() {
+    const int side = 4;
+    resetNetwork(side * side);
+    for (int r = 0; r < side; r++) {
+        for (int c = 0; c < side; c++) {
+            if (c + 1 < side) {
+                connect(r * side + c, r * side + c + 1, true);
+            }
+            if (r + 1 < side) {
+                connect(r * side + c, (r + 1) * side + c, true);
+            }
+        }
+    }
+    int rounds = roundsToConverge(3 * side * side);
+    printf("  rejilla %dx%d: converge en %d rondas (diámetro %d)\n", side, side, rounds, diameter());
+    CHECK(rounds > 0 && rounds <= diameter());
+
+    /* cae un nodo central: todo lo demás sigue alcanzable por otros caminos */
+    const int down = side + 1;
+    for (int m = 0; m < nodeCount; m++) {
+        connect(down, m, false);
+    }
+    int reroute = -1;
+    for (int r = 1; r <= NEIGHBOR_EXPIRATION_TIME / ROUND_MS + 2 * side * side && reroute < 0; r++) {
+        runRound();
+        CHECK(loopFree());
+        computeHops();
+        bool ok = true;
+        for (int n = 0; n < nodeCount && ok; n++) {
+            for (int d = 0; d < nodeCount && ok; d++) {
+                if (n != d && n != down && d != down) {
+                    int next = nextNode(n, d);
+                    ok = next >= 0 && next != down && links[n][next];
+                }
+            }
+        }
+        if (ok && converged()) {
+            reroute = r;
+        }
+    }
+    printf("  rejilla sin nodo %d: reconverge en %d rondas\n", down, reroute);
+    CHECK(reroute > 0);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Rotación del vector en los HELLO que salen por la cola                    */
+/*----------------------------------------------------------------------------*/
+/* Lleva el HELLO en cola hasta el radio: presupuesto de aire, CAD y envío */
+static bool sendQueuedHello(std::vector<uint8_t> &frame) {
+    size_t sent = hostRadio.sent.size();
+    for (int pass = 0; pass < 2000; pass++) {
+        hostNowMs += 10;
+        updateMessageScheduler();
+        if (lbtInProgress() && !cadDone) {
+            hostRadio.events->CadDone(false);
+        }
+        if (hostRadio.sent.size() > sent) {
+            frame = hostRadio.sent.back();
+            hostRadio.events->TxDone();
+            return true;
+        }
+    }
+    return false;
+}
+
+static void testAdvertRotation() {
+    const int routes = 2 * ROUTE_ADVERT_MAX + 4;
+    const int hellos = 3;
+    sketchSetup(); // cola vacía salvo el primer HELLO
+    for (int d = 0; d < routes; d++) {
+        CHECK(routeUpdate((uint16_t)(2000 + d), 2289, ROUTE_HOP_COST, 2, 0));
+    }
+    bool advertised[routes] = {};
+    uint16_t lastSeq = 0;
+    for (int h = 0; h < hellos; h++) {
+        if (h > 0) {
+            CHECK_EQ(scheduleHelloMessage(), ENQUEUE_OK);
+        }
+        std::vector<uint8_t> frame;
+        CHECK(sendQueuedHello(frame));
+        HelloPacket hello;
+        CHECK(deserializePacket(hello, frame.data(), (uint16_t)frame.size()));
+        CHECK_EQ(hello.routeCount, ROUTE_ADVERT_MAX);
+        if (h > 0) {
+            CHECK_EQ((uint16_t)(hello.seq - lastSeq), 2);
+        }
+        lastSeq = hello.seq;
+        for (uint8_t i = 0; i < hello.routeCount; i++) {
+            int d = hello.routes[i].destination - 2000;
+            CHECK(d >= 0 && d < routes);
+            if (d >= 0 && d < routes) {
+                advertised[d] = true;
+            }
+        }
+    }
+    int count = 0;
+    for (int d = 0; d < routes; d++) {
+        count += advertised[d];
+    }
+    printf("  %d rutas en %d HELLO por la cola: %d anunciadas\n", routes, hellos, count);
+    CHECK_EQ(count, routes);
+}
+
+int main() {
+    hostSeed(15);
+    hostNowMs = 10000;
+    pristine = NodeState();
+    {
+        NodeState &s = pristine;
+        ROUTING_STATE(STATE_SAVE)
+    }
+    testChain();
+    testStar();
+    testGrid();
+    testAdvertRotation();
+    return hostTestResult("test_dsdv_convergence");
+}
@@ -0,0 +1,139 @@
+/*==============================================================================
+  test_etx_estimator.cpp
+  ------------------------------------------------------------------------------
+  Estimador de enlace (ETX) de routing_manager.h frente a la puntuación
+  anterior (RSSI − segundos desde la última trama):
+  – Enlace fuerte con pérdidas frente a uno más débil sin pérdidas: ETX
+    pasa al bueno en pocos ACK; la puntuación anterior no lo hace nunca.
+  – El enlace elegido empieza a perder: ETX cambia de vecino en pocos ACK.
+  – Dos enlaces equivalentes con RSSI ruidoso: ETX apenas cambia de
+    elección; la puntuación anterior oscila con cada trama.
+  La elección ETX es la cabeza de neighborRank (ranking incremental).
+==============================================================================*/
+#include "Arduino.h"
+#include "esp_system.h"
+#include "host_test.h"
+#include "routing_manager.h"
+
+/* Dependencias de routing_manager.h ajenas al estimador */
+bool collectHandlesDestination(uint16_t) { return false; }
+uint16_t collectNextHop(uint16_t) { return INVALID_NEXT_HOP; }
+void collectNeighborLost(uint16_t) {}
+void rateNoteAck(int, bool) {}
+void tpcNoteAck(int, bool) {}
+
+/* Vecinos de ALLOWED_NEIGHBORS: sólo estos entran al ranking */
+#define NODE_A 2289
+#define NODE_B 61039
+
+/* Puntuación del selector anterior (mayor es mejor) */
+static float oldScore(uint16_t neighborId) {
+    const NeighborInfo &n = neighborTable[findNeighbor(neighborId)];
+    return (float)n.rssi - (float)(millis() - n.lastHeard) / 1000.0f;
+}
+static uint16_t oldPick() {
+    return oldScore(NODE_A) >= oldScore(NODE_B) ? NODE_A : NODE_B;
+}
+static uint16_t etxPick() {
+    return neighborTable[neighborRank[0]].neighborId;
+}
+
+static void resetNeighbors() {
+    while (neighborCount > 0) {
+        for (int i = 0; i < MAX_NEIGHBORS; i++) {
+            if (neighborTable[i].neighborId != 0) {
+                removeNeighbor(neighborTable[i].neighborId);
+            }
+        }
+    }
+    CHECK_EQ(neighborRankCount, 0);
+}
+static int16_t noisy(int16_t value, int spread) {
+    return (int16_t)(value + random(-spread, spread + 1));
+}
+/* Un envío DATA al vecino: trama suya oída y resultado del ACK */
+static void exchange(uint16_t neighborId, int16_t rssi, int8_t snr, bool delivered) {
+    noteNeighborFrame(neighborId, rssi, snr);
+    if (delivered) {
+        linkNoteAck(neighborId, true);
+    } else {
+        noteNeighborAckTimeout(neighborId);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  1) Fuerte con pérdidas frente a débil sin pérdidas, y luego al revés      */
+/*----------------------------------------------------------------------------*/
+static void testLossyStrongLink() {
+    resetNeighbors();
+    addOrUpdateNeighbor(NODE_A, -70, 8);   // fuerte, 50 % de ACK perdidos
+    addOrUpdateNeighbor(NODE_B, -95, 2);   // débil, pero con margen de SNR
+    int etxSwitch = -1, oldSwitch = -1, etxFlips = 0;
+    uint16_t prevEtx = etxPick();
+    for (int t = 0; t < 60; t++) {
+        hostNowMs += 2000;
+        exchange(NODE_A, noisy(-70, 6), (int8_t)noisy(8, 2), random(0, 2) == 0);
+        exchange(NODE_B, noisy(-95, 6), (int8_t)noisy(2, 2), true);
+        if (etxPick() == NODE_B && etxSwitch < 0) {
+            etxSwitch = t + 1;
+        }
+        if (oldPick() == NODE_B && oldSwitch < 0) {
+            oldSwitch = t + 1;
+        }
+        etxFlips += (etxPick() != prevEtx);
+        prevEtx = etxPick();
+    }
+    printf("  A con pérdidas: ETX cambia a B en %d ACK (anterior: %d), cambios ETX %d\n",
+           etxSwitch, oldSwitch, etxFlips);
+    CHECK(etxSwitch > 0 && etxSwitch <= 8);
+    CHECK_EQ(oldSwitch, -1);
+    CHECK(etxFlips <= 3);
+    CHECK_EQ(etxPick(), NODE_B);
+    CHECK(getLinkCost(NODE_B) < getLinkCost(NODE_A));
+
+    /* B empieza a perderlo todo y A se recupera */
+    int etxBack = -1;
+    for (int t = 0; t < 30; t++) {
+        hostNowMs += 2000;
+        exchange(NODE_A, noisy(-70, 6), (int8_t)noisy(8, 2), true);
+        exchange(NODE_B, noisy(-95, 6), (int8_t)noisy(2, 2), false);
+        if (etxPick() == NODE_A && etxBack < 0) {
+            etxBack = t + 1;
+        }
+    }
+    printf("  B empieza a perder: ETX vuelve a A en %d ACK\n", etxBack);
+    CHECK(etxBack > 0 && etxBack <= 4);
+    CHECK_EQ(etxPick(), NODE_A);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  2) Enlaces equivalentes con RSSI ruidoso                                  */
+/*----------------------------------------------------------------------------*/
+static void testNoisyEquivalentLinks() {
+    resetNeighbors();
+    addOrUpdateNeighbor(NODE_A, -80, 5);
+    addOrUpdateNeighbor(NODE_B, -82, 5);
+    int oldFlips = 0, etxFlips = 0;
+    uint16_t prevOld = oldPick(), prevEtx = etxPick();
+    for (int t = 0; t < 200; t++) {
+        hostNowMs += 1000;
+        noteNeighborFrame(NODE_A, noisy(-80, 8), (int8_t)noisy(5, 2));
+        noteNeighborFrame(NODE_B, noisy(-82, 8), (int8_t)noisy(5, 2));
+        oldFlips += (oldPick() != prevOld);
+        etxFlips += (etxPick() != prevEtx);
+        prevOld = oldPick();
+        prevEtx = etxPick();
+    }
+    printf("  enlaces equivalentes: cambios de elección anterior %d, ETX %d\n", oldFlips, etxFlips);
+    CHECK(oldFlips >= 20);
+    CHECK(etxFlips * 4 <= oldFlips);
+}
+
+int main() {
+    hostSeed(16);
+    hostMac = 1;
+    hostNowMs = 10000;
+    testLossyStrongLink();
+    testNoisyEquivalentLinks();
+    return hostTestResult("test_etx_estimator");
+}
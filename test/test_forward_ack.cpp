@@ -0,0 +1,89 @@
+/*==============================================================================
+  test_forward_ack.cpp
+  ------------------------------------------------------------------------------
+  ACK hop-by-hop de un DATA recibido (processPayload):
+  – Para reenviar, el ACK sólo se programa si la trama quedó en cola.
+  – Sin siguiente salto no se encola nada hacia INVALID_NEXT_HOP: ALT al
+    emisor y ningún ACK.
+  – Destino final: ACK sin reenvío.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+
+#define PREVIOUS_HOP 2289
+#define NEIGHBOR 61039
+#define UNKNOWN_DEST 999
+
+static int queued(uint8_t kind) {
+    int count = 0;
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        count += (scheduledQueue[s].inUse && scheduledQueue[s].kind == kind);
+    }
+    return count;
+}
+static void clearQueue() {
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        if (scheduledQueue[s].inUse) {
+            releaseQueueSlot(s);
+        }
+    }
+}
+
+/* DATA de PREVIOUS_HOP con este nodo como siguiente salto */
+static void receiveData(uint16_t destination, uint16_t seq) {
+    uint8_t payload[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    DataPacket p;
+    fillDataPacket(p, destination, getNodeID(), 1, 6, payload, sizeof(payload));
+    p.originNode = PREVIOUS_HOP;
+    p.messageID = ((uint32_t)PREVIOUS_HOP << 16) | seq;
+    receivedSize = serializePacket(p, receivedBuffer, MAX_PACKET_SIZE);
+    receivedRssi = -70;
+    receivedSnr = 8;
+    processPayload();
+}
+
+static void testNoRoute() {
+    clearQueue();
+    receiveData(UNKNOWN_DEST, 1);
+    CHECK_EQ(queued(ITEM_DATA), 0);
+    CHECK_EQ(queued(ITEM_ACK), 0);
+    CHECK_EQ(queued(ITEM_ALT), 1);
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        if (scheduledQueue[s].inUse && scheduledQueue[s].kind == ITEM_ALT) {
+            CHECK_EQ(scheduledQueue[s].node, PREVIOUS_HOP);
+        }
+    }
+}
+
+static void testForwarded() {
+    clearQueue();
+    addOrUpdateNeighbor(NEIGHBOR, -70, 8);
+    receiveData(NEIGHBOR, 2);
+    CHECK_EQ(queued(ITEM_DATA), 1);
+    CHECK_EQ(queued(ITEM_ACK), 1);
+    CHECK_EQ(queued(ITEM_ALT), 0);
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        if (scheduledQueue[s].inUse && scheduledQueue[s].kind == ITEM_DATA) {
+            CHECK_EQ(itemData(s).nextHop, NEIGHBOR);
+            CHECK_EQ(itemData(s).originNode, getNodeID());
+        }
+    }
+}
+
+static void testLocalDestination() {
+    clearQueue();
+    receiveData(getNodeID(), 3);
+    CHECK_EQ(queued(ITEM_DATA), 0);
+    CHECK_EQ(queued(ITEM_ACK), 1);
+    CHECK_EQ(queued(ITEM_ALT), 0);
+}
+
+int main() {
+    hostSeed(11);
+    hostNowMs = 10000;
+    sketchSetup();
+    testNoRoute();
+    testForwarded();
+    testLocalDestination();
+    return hostTestResult("test_forward_ack");
+}
@@ -0,0 +1,109 @@
+/*==============================================================================
+  test_next_hop.cpp
+  ------------------------------------------------------------------------------
+  Selección de nextHop de routing_manager.h (computeNextHop / getNextHop):
+  – Destino directo y ruta de la tabla se sirven desde la caché.
+  – Sin ruta, el sorteo entre los mejores candidatos por ETX se repite en
+    cada consulta: la carga se reparte aunque la caché esté caliente.
+  – Candidatos peores que LINK_ETX_SPREAD_PCT del mejor no se eligen.
+  – Un vecino de bajo consumo (LPL) no se elige como tránsito.
+==============================================================================*/
+#include "Arduino.h"
+#include "esp_system.h"
+#include "host_test.h"
+#include "routing_manager.h"
+
+/* Dependencias de routing_manager.h ajenas a la selección */
+bool collectHandlesDestination(uint16_t) { return false; }
+uint16_t collectNextHop(uint16_t) { return INVALID_NEXT_HOP; }
+void collectNeighborLost(uint16_t) {}
+void rateNoteAck(int, bool) {}
+void tpcNoteAck(int, bool) {}
+
+/* Vecinos de ALLOWED_NEIGHBORS: sólo estos entran al ranking */
+#define NODE_A 33364
+#define NODE_B 2289
+#define NODE_C 61039
+#define DEST_ROUTED 500
+#define DEST_UNKNOWN 999
+
+static void testCachedDeterministic() {
+    RouteEntry *e = routeInsert(DEST_ROUTED);
+    e->nextHop = NODE_B;
+    e->cost = 2 * ROUTE_HOP_COST;
+    e->seq = 2;
+    e->updatedAt = millis();
+    e->altHop = 0;
+    routeCacheInvalidate();
+
+    CHECK_EQ(getNextHop(1, NODE_C, 0), NODE_C);
+    CHECK_EQ(getNextHop(1, DEST_ROUTED, 0), NODE_B);
+    uint32_t hits = routeCacheHits;
+    for (int n = 0; n < 10; n++) {
+        CHECK_EQ(getNextHop(1, NODE_C, 0), NODE_C);
+        CHECK_EQ(getNextHop(1, DEST_ROUTED, 0), NODE_B);
+    }
+    CHECK_EQ(routeCacheHits, hits + 20);
+    /* excluido el nextHop cacheado se calcula aparte */
+    uint16_t other = getNextHop(1, DEST_ROUTED, NODE_B);
+    CHECK(other != NODE_B && other != INVALID_NEXT_HOP);
+}
+
+static void testFallbackSpreads() {
+    int picks[3] = { 0, 0, 0 };
+    const int lookups = 600;
+    for (int n = 0; n < lookups; n++) {
+        uint16_t hop = getNextHop(1, DEST_UNKNOWN, 0);
+        picks[0] += (hop == NODE_A);
+        picks[1] += (hop == NODE_B);
+        picks[2] += (hop == NODE_C);
+    }
+    printf("  sin ruta: A=%d B=%d C=%d de %d consultas\n", picks[0], picks[1], picks[2], lookups);
+    CHECK_EQ(picks[0] + picks[1] + picks[2], lookups);
+    for (int c = 0; c < 3; c++) {
+        CHECK(picks[c] > lookups / 6);
+    }
+    /* con exclusión nunca sale el excluido */
+    for (int n = 0; n < 50; n++) {
+        CHECK(getNextHop(1, DEST_UNKNOWN, NODE_A) != NODE_A);
+    }
+}
+
+static void testFallbackSkipsLpl() {
+    /* B duerme (LPL): no hace de tránsito, pero sí recibe lo suyo */
+    neighborTable[findNeighbor(NODE_B)].lplIntervalMs = 1000;
+    routeCacheInvalidate();
+    for (int n = 0; n < 200; n++) {
+        CHECK(getNextHop(1, DEST_UNKNOWN, 0) != NODE_B);
+    }
+    CHECK_EQ(getNextHop(1, NODE_B, 0), NODE_B);
+    neighborTable[findNeighbor(NODE_B)].lplIntervalMs = 0;
+    routeCacheInvalidate();
+}
+
+static void testFallbackSpreadLimit() {
+    /* C pierde ACK hasta quedar por encima de LINK_ETX_SPREAD_PCT del mejor */
+    for (int n = 0; n < 12; n++) {
+        linkNoteAck(NODE_C, false);
+    }
+    int i = findNeighbor(NODE_C);
+    CHECK((uint32_t)neighborTable[i].etxQ8 * 100 > (uint32_t)256 * LINK_ETX_SPREAD_PCT);
+    for (int n = 0; n < 200; n++) {
+        CHECK(getNextHop(1, DEST_UNKNOWN, 0) != NODE_C);
+    }
+}
+
+int main() {
+    hostSeed(18);
+    hostMac = 1;
+    hostNowMs = 10000;
+    initRouteTable();
+    addOrUpdateNeighbor(NODE_A, -70, 9);
+    addOrUpdateNeighbor(NODE_B, -72, 9);
+    addOrUpdateNeighbor(NODE_C, -71, 9);
+    testCachedDeterministic();
+    testFallbackSpreads();
+    testFallbackSkipsLpl();
+    testFallbackSpreadLimit();
+    return hostTestResult("test_next_hop");
+}
@@ -0,0 +1,132 @@
+/*==============================================================================
+  test_opportunistic.cpp
+  ------------------------------------------------------------------------------
+  Reenvío oportunista de opportunistic_manager.h:
+  – La copia retenida por un candidato de reserva (oppHoldForward) se
+    cancela al oír el mismo messageID reenviado por otro nodo o confirmado
+    al salto previo; la retransmisión del propio emisor o un ACK a otro
+    nodo no la cancelan.
+  – Si la copia sale, se confirma al salto previo.
+  – El emisor libera su pendingAcks al oír reenviar la trama a uno de sus
+    candidatos (ACK implícito); un nodo no listado no cuenta.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+
+#define PREVIOUS_HOP 2289
+#define CANDIDATE_0 33364
+#define CANDIDATE_1 61039
+#define OUTSIDER 777
+#define DESTINATION 999
+
+static int queuedData(uint32_t messageID) {
+    int count = 0;
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        const ScheduledItem &item = scheduledQueue[s];
+        count += (item.inUse && item.kind == ITEM_DATA && item.heapPos != SCHED_NOT_IN_HEAP &&
+                  itemData(s).messageID == messageID);
+    }
+    return count;
+}
+static bool queuedAck(uint32_t messageID, uint16_t destination) {
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        const ScheduledItem &item = scheduledQueue[s];
+        if (item.inUse && item.kind == ITEM_ACK && item.messageID == messageID && item.node == destination) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* DATA de PREVIOUS_HOP que lista este nodo como candidato de reserva */
+static uint32_t holdCopy(uint16_t seq) {
+    uint8_t payload[4] = { 1, 2, 3, 4 };
+    DataPacket p;
+    fillDataPacket(p, DESTINATION, CANDIDATE_0, 1, 6, payload, sizeof(payload));
+    p.originNode = PREVIOUS_HOP;
+    p.messageID = ((uint32_t)PREVIOUS_HOP << 16) | seq;
+    p.candidateCount = 2;
+    p.candidates[0] = CANDIDATE_0;
+    p.candidates[1] = getNodeID();
+    uint8_t frame[MAX_PACKET_SIZE];
+    DataView view{};
+    CHECK(deserializePacket(view, frame, serializePacket(p, frame, sizeof(frame))));
+    CHECK_EQ(dataCandidateRank(view, getNodeID()), 1);
+    CHECK_EQ(oppHoldForward(view, PREVIOUS_HOP, 1), ENQUEUE_OK);
+    CHECK(oppIsHeld(p.messageID));
+    CHECK_EQ(queuedData(p.messageID), 1);
+    return p.messageID;
+}
+
+static void testSuppressedByForward() {
+    uint32_t id = holdCopy(1);
+    uint32_t suppressed = oppSuppressed;
+    /* retransmisión del salto previo: la copia sigue */
+    oppOverheard(MESSAGE_TYPE_DATA, id, PREVIOUS_HOP, 0);
+    CHECK(oppIsHeld(id));
+    CHECK_EQ(queuedData(id), 1);
+    /* el candidato 0 la reenvía: se cancela */
+    oppOverheard(MESSAGE_TYPE_DATA, id, CANDIDATE_0, 0);
+    CHECK(!oppIsHeld(id));
+    CHECK_EQ(queuedData(id), 0);
+    CHECK_EQ(oppSuppressed, suppressed + 1);
+}
+
+static void testSuppressedByAck() {
+    uint32_t id = holdCopy(2);
+    uint32_t suppressed = oppSuppressed;
+    /* ACK del mismo messageID hacia otro nodo: no es el nuestro */
+    oppOverheard(MESSAGE_TYPE_ACK, id, CANDIDATE_0, OUTSIDER);
+    CHECK(oppIsHeld(id));
+    /* el candidato 0 confirma al salto previo: se cancela */
+    oppOverheard(MESSAGE_TYPE_ACK, id, CANDIDATE_0, PREVIOUS_HOP);
+    CHECK(!oppIsHeld(id));
+    CHECK_EQ(queuedData(id), 0);
+    CHECK_EQ(oppSuppressed, suppressed + 1);
+}
+
+static void testReleasedCopyAcks() {
+    uint32_t id = holdCopy(3);
+    uint32_t released = oppReleased;
+    oppNoteSent(id);
+    CHECK(!oppIsHeld(id));
+    CHECK_EQ(oppReleased, released + 1);
+    CHECK(queuedAck(id, PREVIOUS_HOP));
+}
+
+static void testImplicitAck() {
+    /* trama propia enviada, con dos candidatos, a la espera de su ACK */
+    int slot = allocDataSlot();
+    CHECK(slot >= 0);
+    uint8_t payload[4] = { 5, 6, 7, 8 };
+    DataPacket &p = itemData(slot);
+    fillDataPacket(p, DESTINATION, CANDIDATE_0, 1, 6, payload, sizeof(payload));
+    p.candidateCount = 2;
+    p.candidates[0] = CANDIDATE_0;
+    p.candidates[1] = CANDIDATE_1;
+    uint32_t id = p.messageID;
+    CHECK(addPendingAck(slot));
+    CHECK(findPendingAck(id) >= 0);
+
+    uint32_t implicitAcks = oppImplicitAcks;
+    oppOverheard(MESSAGE_TYPE_DATA, id, OUTSIDER, 0);
+    CHECK(findPendingAck(id) >= 0);
+    CHECK_EQ(oppImplicitAcks, implicitAcks);
+    /* el candidato de reserva la reenvía: entregada */
+    oppOverheard(MESSAGE_TYPE_DATA, id, CANDIDATE_1, 0);
+    CHECK(findPendingAck(id) < 0);
+    CHECK(!scheduledQueue[slot].inUse);
+    CHECK_EQ(oppImplicitAcks, implicitAcks + 1);
+}
+
+int main() {
+    hostSeed(20);
+    hostNowMs = 10000;
+    sketchSetup();
+    oppEnabled = true;
+    testSuppressedByForward();
+    testSuppressedByAck();
+    testReleasedCopyAcks();
+    testImplicitAck();
+    return hostTestResult("test_opportunistic");
+}
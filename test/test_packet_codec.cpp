@@ -0,0 +1,371 @@
+/*==============================================================================
+  test_packet_codec.cpp
+  ------------------------------------------------------------------------------
+  Formato en el aire de packet_manager.h:
+  – Ida y vuelta de DATA, ACK, HELLO, ALT y RDV con todos sus campos opcionales.
+  – Orden de bytes explícito (little-endian) y meshID opcional.
+  – Tramas truncadas, de otro tipo o con payload excesivo se rechazan.
+  – Comparación de bytes con el formato anterior (memcpy de la estructura).
+==============================================================================*/
+#include "Arduino.h"
+#include "host_test.h"
+#include "packet_manager.h"
+
+/*----------------------------------------------------------------------------*/
+/*  Formato anterior: las estructuras tal cual en memoria (con relleno)       */
+/*----------------------------------------------------------------------------*/
+struct LegacyDataPacket {
+    uint8_t messageType;
+    uint16_t meshID;
+    uint32_t messageID;
+    uint16_t originNode;
+    uint16_t destinationNode;
+    uint16_t nextHop;
+    uint8_t extra;
+    uint8_t ttl;
+    uint32_t payload;
+};
+struct LegacyAckPacket {
+    uint8_t messageType;
+    uint16_t meshID;
+    uint32_t messageID;
+    uint16_t originNode;
+    uint16_t destinationNode;
+};
+struct LegacyHelloPacket {
+    uint8_t messageType;
+    uint16_t meshID;
+    uint32_t messageID;
+    uint16_t originNode;
+};
+struct LegacyAltPacket {
+    uint8_t messageType;
+    uint16_t meshID;
+    uint32_t messageID;
+    uint16_t originNode;
+    uint16_t destinationNode;
+};
+
+static uint8_t frame[MAX_PACKET_SIZE];
+
+/*----------------------------------------------------------------------------*/
+/*  DATA                                                                      */
+/*----------------------------------------------------------------------------*/
+static void checkDataEquals(const DataView &v, const DataPacket &p) {
+    CHECK_EQ(v.messageType, MESSAGE_TYPE_DATA);
+    CHECK_EQ(v.meshID, p.meshID);
+    CHECK_EQ(v.messageID, p.messageID);
+    CHECK_EQ(v.originNode, p.originNode);
+    CHECK_EQ(v.destinationNode, p.destinationNode);
+    CHECK_EQ(v.nextHop, p.nextHop);
+    CHECK_EQ(v.extra, p.extra);
+    CHECK_EQ(v.ttl, p.ttl);
+    CHECK_EQ(v.candidateCount, p.candidateCount > 1 ? p.candidateCount : 0);
+    for (uint8_t i = 1; i < v.candidateCount; i++) {
+        CHECK_EQ(v.candidates[i], p.candidates[i]);
+    }
+    CHECK_EQ(v.payload.length, p.payloadLength);
+    CHECK(memcmp(v.payload.data, p.payload, p.payloadLength) == 0);
+}
+
+static void testDataRoundTrip() {
+    const uint8_t lengths[] = { 0, 1, 4, 150, MAX_PAYLOAD_SIZE };
+    const uint8_t varints[] = { 0, 6, 127, 128, 255 };
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+    for (int i = 0; i < MAX_PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t)(i * 7 + 3);
+    }
+    for (uint8_t length : lengths) {
+        for (uint8_t v : varints) {
+            DataPacket p;
+            fillDataPacket(p, 0xBEEF, 0x0102, v, (uint8_t)(255 - v), payload, length);
+            uint16_t n = serializePacket(p, frame, sizeof(frame));
+            uint16_t varintBytes = (v >= 128 ? 2 : 1) + ((255 - v) >= 128 ? 2 : 1);
+            CHECK_EQ(n, 1 + 2 + 4 + 2 + 2 + 2 + varintBytes + length);
+            DataView view{};
+            CHECK(deserializePacket(view, frame, n));
+            checkDataEquals(view, p);
+            CHECK(view.payload.data == frame + n - length); // sin copia
+
+            DataPacket copy;
+            copyDataView(copy, view);
+            CHECK_EQ(copy.payloadLength, length);
+            CHECK(memcmp(copy.payload, payload, length) == 0);
+        }
+    }
+}
+
+static void testDataCandidates() {
+    uint8_t payload[3] = { 9, 8, 7 };
+    for (uint8_t count = 2; count <= OPP_MAX_CANDIDATES; count++) {
+        DataPacket p;
+        fillDataPacket(p, 500, 11, 1, 6, payload, sizeof(payload));
+        p.candidateCount = count;
+        p.candidates[0] = p.nextHop;
+        for (uint8_t i = 1; i < count; i++) {
+            p.candidates[i] = (uint16_t)(0x2000 + i);
+        }
+        uint16_t n = serializePacket(p, frame, sizeof(frame));
+        CHECK_EQ(n, 15 + 1 + 2 * (count - 1) + sizeof(payload));
+        CHECK(frame[0] & WIRE_FLAG_CANDIDATES);
+        DataView view{};
+        CHECK(deserializePacket(view, frame, n));
+        checkDataEquals(view, p);
+        CHECK_EQ(view.candidates[0], p.nextHop);
+        CHECK_EQ(dataCandidateRank(view, 0x2001), 1);
+        CHECK_EQ(dataCandidateRank(view, 11), 0);
+        CHECK_EQ(dataCandidateRank(view, 0x3000), -1);
+    }
+    /* un solo candidato (== nextHop) viaja como unicast */
+    DataPacket p;
+    fillDataPacket(p, 500, 11, 1, 6, payload, sizeof(payload));
+    p.candidateCount = 1;
+    p.candidates[0] = 11;
+    uint16_t n = serializePacket(p, frame, sizeof(frame));
+    CHECK((frame[0] & WIRE_FLAG_CANDIDATES) == 0);
+    DataView view{};
+    CHECK(deserializePacket(view, frame, n));
+    CHECK_EQ(view.candidateCount, 0);
+    /* número de candidatos fuera de rango ⇒ trama inválida */
+    p.candidateCount = 2;
+    p.candidates[1] = 12;
+    n = serializePacket(p, frame, sizeof(frame));
+    frame[15] = OPP_MAX_CANDIDATES + 1;
+    CHECK(!deserializePacket(view, frame, n));
+    frame[15] = 1;
+    CHECK(!deserializePacket(view, frame, n));
+}
+
+static void testDataRejects() {
+    uint8_t payload[MAX_PAYLOAD_SIZE] = { 0 };
+    DataPacket p;
+    fillDataPacket(p, 7, 8, 1, 6, payload, 10);
+    uint16_t n = serializePacket(p, frame, sizeof(frame));
+    DataView view{};
+    /* cabecera incompleta */
+    for (uint16_t cut = 0; cut < n - 10; cut++) {
+        CHECK(!deserializePacket(view, frame, cut));
+    }
+    CHECK(!deserializePacket(view, nullptr, n));
+    /* tipo distinto */
+    AckPacket ack;
+    CHECK(!deserializePacket(ack, frame, n));
+    /* payload por encima de MAX_PAYLOAD_SIZE */
+    uint8_t big[MAX_PACKET_SIZE];
+    memcpy(big, frame, n - 10);
+    uint16_t oversize = (uint16_t)(n - 10 + MAX_PAYLOAD_SIZE + 1);
+    CHECK(!deserializePacket(view, big, oversize));
+    CHECK(deserializePacket(view, big, (uint16_t)(oversize - 1)));
+    /* sin espacio en el buffer de destino */
+    fillDataPacket(p, 7, 8, 1, 6, payload, MAX_PAYLOAD_SIZE);
+    CHECK_EQ(serializePacket(p, frame, 20), 0);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Orden de bytes y meshID                                                   */
+/*----------------------------------------------------------------------------*/
+static void testByteOrder() {
+    AltPacket alt;
+    fillAltPacket(alt, 0x11223344, 0xA1B2);
+    alt.originNode = 0xC3D4;
+    uint16_t n = serializePacket(alt, frame, sizeof(frame));
+    const uint8_t expected[] = { MESSAGE_TYPE_ALT | WIRE_FLAG_MESH_ID, 0x34, 0x12, 0x44, 0x33,
+                                 0x22, 0x11, 0xD4, 0xC3, 0xB2, 0xA1 };
+    CHECK_EQ(n, sizeof(expected));
+    CHECK(memcmp(frame, expected, sizeof(expected)) == 0);
+
+    /* sin WIRE_FLAG_MESH_ID el receptor asume el MESH_ID local */
+    const uint8_t omitted[] = { MESSAGE_TYPE_ALT, 0x44, 0x33, 0x22, 0x11, 0xD4, 0xC3, 0xB2, 0xA1 };
+    AltPacket decoded;
+    CHECK(deserializePacket(decoded, omitted, sizeof(omitted)));
+    CHECK_EQ(decoded.meshID, MESH_ID);
+    CHECK_EQ(decoded.messageID, 0x11223344);
+    CHECK_EQ(decoded.destinationNode, 0xA1B2);
+
+    /* otra malla: meshID explícito */
+    alt.meshID = 0x7777;
+    n = serializePacket(alt, frame, sizeof(frame));
+    CHECK(deserializePacket(decoded, frame, n));
+    CHECK_EQ(decoded.meshID, 0x7777);
+    uint16_t meshID, sender;
+    CHECK(peekPacketSender(frame, n, meshID, sender));
+    CHECK_EQ(meshID, 0x7777);
+    CHECK_EQ(sender, 0xC3D4);
+    CHECK(!peekPacketSender(frame, 4, meshID, sender));
+
+    /* varint: 7 bits por byte */
+    uint8_t buffer[8];
+    WireWriter w = { buffer, sizeof(buffer), 0, true };
+    wirePutVarint(w, 300);
+    CHECK_EQ(w.pos, 2);
+    CHECK_EQ(buffer[0], 0xAC);
+    CHECK_EQ(buffer[1], 0x02);
+    const uint8_t endless[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x01 };
+    WireReader r = { endless, sizeof(endless), 0, true };
+    wireGetVarint(r);
+    CHECK(!r.ok);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  ACK, ALT y RDV                                                            */
+/*----------------------------------------------------------------------------*/
+static void testControlFrames() {
+    AckPacket ack;
+    fillAckPacket(ack, 0xCAFEF00D, 0x4455);
+    uint16_t n = serializePacket(ack, frame, sizeof(frame));
+    CHECK_EQ(n, 11);
+    AckPacket ackOut;
+    CHECK(deserializePacket(ackOut, frame, n));
+    CHECK_EQ(ackOut.messageID, 0xCAFEF00D);
+    CHECK_EQ(ackOut.destinationNode, 0x4455);
+    CHECK_EQ(ackOut.originNode, ack.originNode);
+    CHECK(!ackOut.hasReport);
+    for (uint16_t cut = 0; cut < n; cut++) {
+        CHECK(!deserializePacket(ackOut, frame, cut));
+    }
+    ack.hasReport = true;
+    ack.reportMarginDb = -5;
+    n = serializePacket(ack, frame, sizeof(frame));
+    CHECK_EQ(n, 12);
+    CHECK(deserializePacket(ackOut, frame, n));
+    CHECK(ackOut.hasReport);
+    CHECK_EQ(ackOut.reportMarginDb, -5);
+    CHECK(!deserializePacket(ackOut, frame, n - 1));
+
+    AltPacket alt;
+    fillAltPacket(alt, 77, 88);
+    n = serializePacket(alt, frame, sizeof(frame));
+    CHECK_EQ(n, 11);
+    AltPacket altOut;
+    CHECK(deserializePacket(altOut, frame, n));
+    CHECK_EQ(altOut.messageID, 77);
+    CHECK_EQ(altOut.destinationNode, 88);
+    CHECK(!deserializePacket(altOut, frame, n - 1));
+
+    RdvPacket rdv;
+    fillRdvPacket(rdv, 1234567, 99, 10, 3);
+    n = serializePacket(rdv, frame, sizeof(frame));
+    CHECK_EQ(n, 13);
+    RdvPacket rdvOut;
+    CHECK(deserializePacket(rdvOut, frame, n));
+    CHECK_EQ(rdvOut.messageID, 1234567);
+    CHECK_EQ(rdvOut.destinationNode, 99);
+    CHECK_EQ(rdvOut.spreadingFactor, 10);
+    CHECK_EQ(rdvOut.channel, 3);
+    for (uint16_t cut = 0; cut < n; cut++) {
+        CHECK(!deserializePacket(rdvOut, frame, cut));
+    }
+    CHECK(!deserializePacket(altOut, frame, n)); // tipo distinto
+}
+
+/*----------------------------------------------------------------------------*/
+/*  HELLO                                                                     */
+/*----------------------------------------------------------------------------*/
+static void testHello() {
+    HelloPacket hello;
+    fillHelloPacket(hello, 0x01020304);
+    hello.seq = 42;
+    hello.routeCount = ROUTE_ADVERT_MAX;
+    for (uint8_t i = 0; i < hello.routeCount; i++) {
+        hello.routes[i].destination = (uint16_t)(1000 + i);
+        hello.routes[i].cost = (uint8_t)(10 * i);
+        hello.routes[i].seq = (uint16_t)(2 * i);
+    }
+    hello.hasGradient = true;
+    hello.gradientSink = 900;
+    hello.gradientRank = 35;
+    hello.gradientParent = 901;
+    hello.lplIntervalMs = LPL_CHECK_INTERVAL_MS;
+    uint16_t n = serializePacket(hello, frame, sizeof(frame));
+    CHECK_EQ(n, 12 + WIRE_ROUTE_ADVERT_SIZE * ROUTE_ADVERT_MAX + WIRE_GRADIENT_SIZE + 2);
+    CHECK(n <= WIRE_HELLO_MAX_SIZE + 2);
+
+    HelloPacket out;
+    CHECK(deserializePacket(out, frame, n));
+    CHECK_EQ(out.messageID, 0x01020304);
+    CHECK_EQ(out.seq, 42);
+    CHECK_EQ(out.lplIntervalMs, LPL_CHECK_INTERVAL_MS);
+    CHECK_EQ(out.routeCount, ROUTE_ADVERT_MAX);
+    for (uint8_t i = 0; i < out.routeCount; i++) {
+        CHECK_EQ(out.routes[i].destination, 1000 + i);
+        CHECK_EQ(out.routes[i].cost, 10 * i);
+        CHECK_EQ(out.routes[i].seq, 2 * i);
+    }
+    CHECK(out.hasGradient);
+    CHECK_EQ(out.gradientSink, 900);
+    CHECK_EQ(out.gradientRank, 35);
+    CHECK_EQ(out.gradientParent, 901);
+
+    /* cortes válidos: sólo cabecera (+ muestreo) y vector sin gradiente */
+    uint16_t headerOnly = 9 + 2;
+    uint16_t withoutGradient = (uint16_t)(n - WIRE_GRADIENT_SIZE);
+    for (uint16_t cut = 0; cut < n; cut++) {
+        bool ok = deserializePacket(out, frame, cut);
+        CHECK_EQ(ok, cut == headerOnly || cut == withoutGradient);
+    }
+    CHECK(deserializePacket(out, frame, withoutGradient));
+    CHECK(!out.hasGradient);
+    CHECK_EQ(out.routeCount, ROUTE_ADVERT_MAX);
+    CHECK(deserializePacket(out, frame, headerOnly));
+    CHECK_EQ(out.routeCount, 0);
+    CHECK_EQ(out.lplIntervalMs, LPL_CHECK_INTERVAL_MS);
+
+    /* nodo siempre a la escucha, sin rutas ni gradiente */
+    fillHelloPacket(hello, 5);
+    hello.seq = 2;
+    n = serializePacket(hello, frame, sizeof(frame));
+    CHECK_EQ(n, 12);
+    CHECK((frame[0] & WIRE_FLAG_LPL) == 0);
+    CHECK(deserializePacket(out, frame, n));
+    CHECK_EQ(out.lplIntervalMs, 0);
+    CHECK_EQ(out.seq, 2);
+    CHECK(!out.hasGradient);
+
+    /* más rutas de las que admite el receptor */
+    frame[11] = ROUTE_ADVERT_MAX + 1;
+    CHECK(!deserializePacket(out, frame, n));
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Bytes por trama frente al formato anterior                                */
+/*----------------------------------------------------------------------------*/
+static void compareWithLegacy() {
+    uint8_t payload[4] = { 1, 2, 3, 4 };
+    DataPacket data;
+    fillDataPacket(data, 2, 3, 1, 6, payload, sizeof(payload));
+    AckPacket ack;
+    fillAckPacket(ack, 1, 2);
+    HelloPacket hello;
+    fillHelloPacket(hello, 1);
+    AltPacket alt;
+    fillAltPacket(alt, 1, 2);
+
+    /* HELLO anterior = sólo cabecera: se compara con el HELLO sin vector */
+    uint16_t dataBytes = serializePacket(data, frame, sizeof(frame));
+    uint16_t ackBytes = serializePacket(ack, frame, sizeof(frame));
+    uint16_t helloBytes = (uint16_t)(serializePacket(hello, frame, sizeof(frame)) - 3);
+    uint16_t altBytes = serializePacket(alt, frame, sizeof(frame));
+
+    printf("  Trama              anterior  compacto  sin meshID\n");
+    printf("  DATA (payload 4 B)  %6zu  %8u  %10u\n", sizeof(LegacyDataPacket), dataBytes, dataBytes - 2);
+    printf("  ACK                 %6zu  %8u  %10u\n", sizeof(LegacyAckPacket), ackBytes, ackBytes - 2);
+    printf("  HELLO               %6zu  %8u  %10u\n", sizeof(LegacyHelloPacket), helloBytes, helloBytes - 2);
+    printf("  ALT                 %6zu  %8u  %10u\n", sizeof(LegacyAltPacket), altBytes, altBytes - 2);
+
+    CHECK(dataBytes < sizeof(LegacyDataPacket));
+    CHECK(ackBytes < sizeof(LegacyAckPacket));
+    CHECK(helloBytes < sizeof(LegacyHelloPacket));
+    CHECK(altBytes < sizeof(LegacyAltPacket));
+}
+
+int main() {
+    hostSeed(1);
+    testDataRoundTrip();
+    testDataCandidates();
+    testDataRejects();
+    testByteOrder();
+    testControlFrames();
+    testHello();
+    compareWithLegacy();
+    return hostTestResult("test_packet_codec");
+}
@@ -0,0 +1,57 @@
+/*==============================================================================
+  test_rate_sf.cpp
+  ------------------------------------------------------------------------------
+  SF por enlace de rate_manager.h:
+  – rateDataToaUs() (estimación del presupuesto de aire) no cambia el SF del
+    vecino, su racha de pérdidas ni rateSfChanges, por muchas veces que se
+    llame.
+  – rateSendData() registra el cambio de SF una sola vez y el DATA sale a
+    ese SF tras su RDV.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+
+#define NEIGHBOR 2289
+
+int main() {
+    hostSeed(21);
+    hostNowMs = 10000;
+    sketchSetup();
+    rateEnabled = true;
+    channelHopping = false;
+    /* enlace con SNR por debajo del límite de SF7: conviene un SF mayor */
+    addOrUpdateNeighbor(NEIGHBOR, -118, -9);
+    int idx = findNeighbor(NEIGHBOR);
+    CHECK(idx >= 0);
+    NeighborInfo &n = neighborTable[idx];
+    n.sfFailStreak = 1;
+
+    DataPacket data;
+    uint8_t payload[20] = { 0 };
+    fillDataPacket(data, NEIGHBOR, NEIGHBOR, 1, 6, payload, sizeof(payload));
+    uint16_t frameSize = serializePacket(data, txFrame, sizeof(txFrame));
+    CHECK(frameSize > 0);
+
+    uint8_t expected = rateBestSf(n, frameSize);
+    CHECK(expected > LORA_SPREADING_FACTOR);
+    uint32_t changes = rateSfChanges;
+    for (int k = 0; k < 10; k++) {
+        uint32_t toaUs = rateDataToaUs(data, frameSize);
+        CHECK_EQ(toaUs, getTimeOnAirUsAt(expected, frameSize) + getTimeOnAirUs(WIRE_RDV_MAX_SIZE));
+    }
+    CHECK_EQ(n.dataSf, LORA_SPREADING_FACTOR);
+    CHECK_EQ(n.sfFailStreak, 1);
+    CHECK_EQ(rateSfChanges, changes);
+
+    /* el envío fija el SF una vez; los siguientes ya lo encuentran fijado */
+    rateSendData(data, frameSize);
+    CHECK_EQ(n.dataSf, expected);
+    CHECK_EQ(n.sfFailStreak, 0);
+    CHECK_EQ(rateSfChanges, changes + 1);
+    CHECK_EQ(rateDeferred.spreadingFactor, expected);
+    CHECK_EQ(rateSfFor(data, frameSize), expected);
+    rateDeferred.size = 0;
+    rateSendData(data, frameSize);
+    CHECK_EQ(rateSfChanges, changes + 1);
+    return hostTestResult("test_rate_sf");
+}
@@ -0,0 +1,142 @@
+/*==============================================================================
+  test_scheduler_heap.cpp
+  ------------------------------------------------------------------------------
+  Cola de transmisión de message_scheduler.h (min-heaps indexados + DRR):
+  secuencia aleatoria de altas, bajas, reprogramaciones y extracciones.
+  Tras cada operación se comprueba:
+  – propiedad de heap y heapPos coherente en el temporizador y cada clase;
+  – toda ranura ocupada está en exactamente un heap y ninguna libre en él;
+  – lo extraído ya venció y es la cabeza de su clase.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+
+static void checkHeap(const SchedulerHeap &h, bool ready, int &members) {
+    for (int p = 0; p < h.size; p++) {
+        uint16_t slot = h.slots[p];
+        const ScheduledItem &item = scheduledQueue[slot];
+        CHECK(item.inUse);
+        CHECK_EQ(item.heapPos, p);
+        CHECK_EQ(item.ready, ready);
+        if (p > 0) {
+            CHECK(!heapLess(h, slot, h.slots[(p - 1) / 2]));
+        }
+    }
+    members += h.size;
+}
+static void checkQueue() {
+    int members = 0;
+    checkHeap(timerHeap, false, members);
+    for (int c = 0; c < SCHED_NUM_CLASSES; c++) {
+        checkHeap(schedulerHeaps[c], true, members);
+        for (int p = 0; p < schedulerHeaps[c].size; p++) {
+            CHECK_EQ(scheduledQueue[schedulerHeaps[c].slots[p]].priorityClass, c);
+        }
+    }
+    int used = 0;
+    for (int s = 0; s < MAX_QUEUE_SIZE; s++) {
+        if (scheduledQueue[s].inUse) {
+            used++;
+            CHECK(scheduledQueue[s].heapPos != SCHED_NOT_IN_HEAP);
+        } else {
+            CHECK_EQ(scheduledQueue[s].heapPos, SCHED_NOT_IN_HEAP);
+        }
+    }
+    CHECK_EQ(members, used);
+    CHECK_EQ(used + freeSlotCount, MAX_QUEUE_SIZE);
+}
+
+static int randomUsedSlot() {
+    if (queueOccupancy() == 0) {
+        return -1;
+    }
+    while (true) {
+        int slot = (int)random(0, MAX_QUEUE_SIZE);
+        if (scheduledQueue[slot].inUse) {
+            return slot;
+        }
+    }
+}
+
+static void pushRandomItem() {
+    int kind = (int)random(0, 4);
+    int slot;
+    if (kind == ITEM_DATA) {
+        slot = allocDataSlot();
+        if (slot < 0) {
+            return;
+        }
+        uint8_t payload[MAX_PAYLOAD_SIZE] = { 0 };
+        fillDataPacket(itemData(slot), 9, 8, 1, 6, payload, (uint8_t)random(0, MAX_PAYLOAD_SIZE));
+        /* mitad propios, mitad reenviados de varios orígenes */
+        if (random(0, 2)) {
+            itemData(slot).messageID = ((uint32_t)random(1, 6) << 16) | (uint32_t)random(0, 65536);
+        }
+    } else {
+        slot = allocQueueSlot((uint8_t)kind);
+        if (slot < 0) {
+            return;
+        }
+        scheduledQueue[slot].messageID = (uint32_t)random(1, 1000000);
+        scheduledQueue[slot].node = (uint16_t)random(1, 100);
+    }
+    pushScheduledItem(slot, millis() + random(0, 2000));
+}
+
+int main() {
+    hostSeed(5);
+    hostNowMs = 100000;
+    initMessageScheduler();
+    checkQueue();
+    int pops = 0;
+    for (int step = 0; step < 50000; step++) {
+        int op = (int)random(0, 10);
+        if (op < 4) {
+            pushRandomItem();
+        } else if (op < 5) {
+            int slot = randomUsedSlot();
+            if (slot >= 0) {
+                releaseQueueSlot(slot);
+            }
+        } else if (op < 7) {
+            int slot = randomUsedSlot();
+            if (slot >= 0) {
+                rescheduleItem(slot, millis() + random(0, 2000));
+            }
+        } else {
+            hostNowMs += (unsigned long)random(0, 100);
+            int slot = peekReadyItem(millis());
+            if (slot >= 0) {
+                const ScheduledItem &item = scheduledQueue[slot];
+                CHECK(item.ready);
+                CHECK(!timeBefore(millis(), item.scheduleTime));
+                CHECK_EQ(schedulerHeaps[item.priorityClass].slots[0], slot);
+                drrCharge(slot);
+                releaseQueueSlot(slot);
+                pops++;
+            }
+        }
+        checkQueue();
+        if (hostFailures > 20) {
+            break;
+        }
+    }
+    CHECK(pops > 1000);
+    /* el reloj da la vuelta: el orden por scheduleTime sigue siendo correcto */
+    hostNowMs = (unsigned long)-1500;
+    initMessageScheduler();
+    for (int i = 0; i < 40; i++) {
+        pushRandomItem();
+    }
+    hostNowMs += 3000;
+    int drained = 0;
+    while (peekReadyItem(millis()) >= 0) {
+        int slot = peekReadyItem(millis());
+        drrCharge(slot);
+        releaseQueueSlot(slot);
+        drained++;
+    }
+    CHECK_EQ(queueOccupancy(), 0);
+    CHECK(drained > 0);
+    return hostTestResult("test_scheduler_heap");
+}
@@ -0,0 +1,67 @@
+/*==============================================================================
+  test_trickle_hello.cpp
+  ------------------------------------------------------------------------------
+  HELLO automático con la cola llena:
+  – vencido el mínimo de vigencia (NEIGHBOR_EXPIRATION_TIME/2), un HELLO
+    que no cabe no deja trickleNextDueMs() en 0 (el bucle por eventos no
+    gira en vacío) y se reintenta cada TRICKLE_IMIN_MS;
+  – al liberarse una ranura el HELLO sale y el mínimo vuelve a contar
+    desde el envío.
+==============================================================================*/
+#include "sketch.h"
+#include "host_test.h"
+
+int main() {
+    hostSeed(13);
+    hostNowMs = 50000;
+    initMessageScheduler();   // ya programa el primer HELLO
+    CHECK_EQ(queueOccupancy(), 1);
+
+    /* cola llena */
+    int lastSlot = -1;
+    while (true) {
+        int slot = allocQueueSlot(ITEM_ACK);
+        if (slot < 0) {
+            break;
+        }
+        scheduledQueue[slot].messageID = (uint32_t)slot + 1;
+        scheduledQueue[slot].node = 7;
+        pushScheduledItem(slot, millis() + 3600000UL);
+        lastSlot = slot;
+    }
+    CHECK_EQ(queueOccupancy(), MAX_QUEUE_SIZE);
+
+    /* más allá del mínimo de vigencia */
+    hostNowMs += NEIGHBOR_EXPIRATION_TIME / 2 + 1000;
+    uint32_t rejectsBefore = enqueueRejects[ENQUEUE_FULL];
+    checkAutoHello();
+    CHECK_EQ(enqueueRejects[ENQUEUE_FULL], rejectsBefore + 1);
+    unsigned long due = trickleNextDueMs(millis());
+    CHECK(due > 0);
+    CHECK(due <= TRICKLE_IMIN_MS);
+
+    /* sin reintentos (ni "COLA LLENA") hasta que vence el aplazamiento */
+    for (int pass = 0; pass < 1000; pass++) {
+        hostNowMs += 1;
+        checkAutoHello();
+        if (trickleNextDueMs(millis()) == 0) {
+            break;
+        }
+    }
+    CHECK(enqueueRejects[ENQUEUE_FULL] <= rejectsBefore + 2);
+    hostNowMs += TRICKLE_IMIN_MS;
+    rejectsBefore = enqueueRejects[ENQUEUE_FULL];
+    checkAutoHello();
+    CHECK_EQ(enqueueRejects[ENQUEUE_FULL], rejectsBefore + 1);
+    CHECK(trickleNextDueMs(millis()) > 0);
+
+    /* hay sitio: el HELLO se encola y el mínimo se rearma entero */
+    releaseQueueSlot(lastSlot);
+    hostNowMs += TRICKLE_IMIN_MS;
+    checkAutoHello();
+    CHECK_EQ(enqueueRejects[ENQUEUE_FULL], rejectsBefore + 1);
+    CHECK_EQ(queueOccupancy(), MAX_QUEUE_SIZE);
+    CHECK_EQ(lastOwnHello, millis());
+    CHECK(trickleNextDueMs(millis()) > 0);
+    return hostTestResult("test_trickle_hello");
+}